@@ -0,0 +1,94 @@
+//==================================================================================================
+//
+//  drives: Page Cache Residency
+//
+//  See drives-cached.h.
+//
+//==================================================================================================
+
+#include "drives-cached.h"
+
+atomic<bool> cachestatMissing {false};  // True once cachestat(2) is found not to be available
+
+int RunCached (const CommandOptions& options) {
+    // Report the page cache residency of the given volume and its directories. Returns the program
+    // exit code.
+
+    DrivesVolume volume;
+    if (DRIVES_OK != drives_query(options.cachedVolume.c_str(), DRIVES_FIELD_ALL, &volume)) {
+        wcout << options.programName << L": No volume present at " << options.cachedVolume << L"." << endl;
+        return 1;
+    }
+
+    CacheScan scan {options.cachedDepth};
+    if (!scan.Run(ToUTF8(volume.root))) {
+        wcerr << options.programName << L": ERROR: Unable to read " << volume.root << L".\n";
+        return 1;
+    }
+
+    const auto& directories = scan.Directories();
+
+    DriveInfo drive {volume};
+    drive.SetCacheResidency(static_cast<int64_t>(directories[0].cached), static_cast<int64_t>(directories[0].inFiles));
+
+    if (options.format == OutputFormat::JSON) {
+        wcout << L"[\n  {\n";
+        drive.PrintJSONVolumeFields();
+        wcout << L",\n    \"unreadableEntries\": " << scan.Unreadable();
+        wcout << L",\n    \"unmeasuredFiles\": " << scan.Unmeasured();
+        wcout << L",\n    \"unmeasuredBytes\": " << directories[0].unmeasured;
+        wcout << L",\n    \"directories\": [";
+
+        for (size_t i = 1;  i < directories.size();  ++i) {
+            const auto& directory = directories[i];
+            wcout << ((i > 1) ? L",\n" : L"\n")
+                  << L"      { \"path\": \"" << Escape(FromUTF8(directory.path).c_str())
+                  << L"\", \"cachedBytes\": " << directory.cached << L", \"fileBytes\": " << directory.inFiles
+                  << L", \"unmeasuredBytes\": " << directory.unmeasured
+                  << L", \"percentCached\": "
+                  << DriveInfo::Percent(static_cast<int64_t>(directory.cached), static_cast<int64_t>(directory.inFiles))
+                  << L" }";
+        }
+
+        wcout << ((directories.size() > 1) ? L"\n    ]\n  }\n]" : L"]\n  }\n]") << endl;
+        return 0;
+    }
+
+    drive.PrintVolumeInformation(options, drive.WidthDriveName(0), drive.WidthVolumeLabel(0),
+                                 drive.WidthDriveType(0), drive.WidthFileSysName(0));
+
+    // Directories, in path order, each with its cached bytes, total bytes, and cached percentage.
+
+    vector<size_t> order;
+    for (size_t i = 1;  i < directories.size();  ++i)
+        order.push_back(i);
+
+    sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return directories[a].path < directories[b].path; });
+
+    for (const auto i : order) {
+        const auto& directory = directories[i];
+        const auto  cached    = numberPretty(static_cast<int64_t>(directory.cached));
+        const auto  inFiles   = numberPretty(static_cast<int64_t>(directory.inFiles));
+
+        const auto  percent   = DriveInfo::Percent(
+            static_cast<int64_t>(directory.cached), static_cast<int64_t>(directory.inFiles));
+
+        const auto priorPrecision = wcout.precision();
+        wcout << Padding{(cached.length() < 10) ? 10 - cached.length() : 0} << cached << L" / "
+              << inFiles << Padding{(inFiles.length() < 10) ? 10 - inFiles.length() : 0}
+              << fixed << setprecision(1) << setw(6) << setfill(L' ') << percent << L"%  "
+              << defaultfloat << setprecision(priorPrecision) << FromUTF8(directory.path) << L'\n';
+    }
+
+    if (scan.Unreadable())
+        wcerr << options.programName << L": " << scan.Unreadable() << L" entries could not be read.\n";
+
+    if (scan.Unmeasured()) {
+        wcerr << options.programName << L": " << scan.Unmeasured() << L" files ("
+              << numberPretty(static_cast<int64_t>(directories[0].unmeasured))
+              << L") are not counted: without cachestat(2), only files you own or can write can be measured.\n";
+    }
+
+    return 0;
+}
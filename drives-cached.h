@@ -0,0 +1,363 @@
+//==================================================================================================
+//
+//  drives: Page Cache Residency
+//
+//  With `--cached`, drives walks a volume's directory tree and reports how much of its file data is
+//  in the page cache, for the volume and for each directory down to `--depth` levels. Residency is
+//  read with cachestat(2) where the kernel has it (Linux 6.5), and otherwise by mapping each file
+//  and calling mincore(2). Neither reads file data, so the scan itself brings no file pages into
+//  the cache; the number of scanning threads is also capped, to limit the directory and inode data
+//  it pulls in.
+//
+//  Since Linux 5.2, mincore() reports a file's pages as resident only if the caller owns the file,
+//  may write to it, or is privileged; for other files it reports none at all. Where mincore() must
+//  be used, such files are counted as unmeasured rather than as not cached.
+//
+//==================================================================================================
+
+#ifndef DRIVES_CACHED_H
+#define DRIVES_CACHED_H
+
+#include "drives-info.h"
+
+const size_t cachedMaxWorkers = 4;                  // Most threads to scan with
+const size_t cachedMapWindow  = size_t{1} << 30;    // Bytes of a file mapped at once for mincore()
+
+#if defined(SYS_cachestat)
+const long cachestatSyscall = SYS_cachestat;
+#else
+const long cachestatSyscall = 451;  // The same on all architectures, but missing from older headers
+#endif
+
+struct CachestatRange {
+    // The kernel's struct cachestat_range.
+    uint64_t offset;
+    uint64_t length;    // Zero for the whole file
+};
+
+struct Cachestat {
+    // The kernel's struct cachestat, counted in pages.
+    uint64_t cached;
+    uint64_t dirty;
+    uint64_t writeback;
+    uint64_t evicted;
+    uint64_t recentlyEvicted;
+};
+
+extern atomic<bool> cachestatMissing;  // True once cachestat(2) is found not to be available
+
+class PageResidency {
+    // Counts the bytes of a file in the page cache. For mincore(), each file is mapped in turn into
+    // the same reserved address range, and the residency vector is reused, so scanning a file adds
+    // no mappings or allocations. The range is reserved again after each file, so that no mapping
+    // keeps a scanned file's inode (and its cached pages) pinned.
+
+    const size_t          pageSize;
+    void*                 window {MAP_FAILED};  // Reserved address range for file mappings
+    vector<unsigned char> residency;            // mincore() result for one window
+
+  public:
+
+    PageResidency () : pageSize{static_cast<size_t>(sysconf(_SC_PAGESIZE))} {
+        // Find out up front whether cachestat() can be used (it fails with EBADF if so), since that
+        // decides which files can be measured. Other errors include ENOSYS from older kernels, and
+        // EPERM or others from seccomp filters (as in some containers).
+
+        if (!cachestatMissing && 0 != syscall(cachestatSyscall, -1, nullptr, nullptr, 0) && errno != EBADF)
+            cachestatMissing = true;
+    }
+
+    ~PageResidency() {
+        if (window != MAP_FAILED)
+            munmap(window, cachedMapWindow);
+    }
+
+    static bool CanMeasure (int directory, const char* name, const struct stat& info) {
+        // Returns true if the residency of the file can be measured: always with cachestat(), and
+        // with mincore() only if the file is the caller's, or writable by it, or the caller is root.
+
+        const auto user = geteuid();
+        return !cachestatMissing || user == 0 || info.st_uid == user
+            || 0 == faccessat(directory, name, W_OK, AT_EACCESS);
+    }
+
+    bool CachedBytes (int file, uint64_t size, uint64_t& cached) {
+        // Sets the number of bytes of the open file (of the given size) in the page cache. Returns
+        // false on failure.
+
+        cached = 0;
+
+        if (!cachestatMissing) {
+            CachestatRange range {0, 0};
+            Cachestat      stats;
+
+            if (0 == syscall(cachestatSyscall, file, &range, &stats, 0)) {
+                cached = min<uint64_t>(stats.cached * pageSize, size);
+                return true;
+            }
+
+            // Fall back to mincore() for good if cachestat() is unavailable, and for this file alone
+            // if its file system doesn't support cachestat() (for example, hugetlbfs).
+
+            if (errno == ENOSYS || errno == EPERM)
+                cachestatMissing = true;
+            else if (errno != EOPNOTSUPP)
+                return false;
+        }
+
+        if (window == MAP_FAILED) {
+            window = mmap(nullptr, cachedMapWindow, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (window == MAP_FAILED)
+                return false;
+            residency.resize(cachedMapWindow / pageSize);
+        }
+
+        bool measured = true;
+
+        for (uint64_t offset = 0;  measured && offset < size;  offset += cachedMapWindow) {
+            const auto length     = static_cast<size_t>(min<uint64_t>(size - offset, cachedMapWindow));
+            const auto fileOffset = static_cast<off_t>(offset);
+
+            measured = MAP_FAILED != mmap(window, length, PROT_READ, MAP_SHARED | MAP_FIXED, file, fileOffset)
+                    && 0 == mincore(window, length, residency.data());
+
+            const auto pages = (length + pageSize - 1) / pageSize;
+            for (size_t page = 0;  measured && page < pages;  ++page) {
+                if (residency[page] & 1)
+                    cached += min<uint64_t>(pageSize, size - offset - page * pageSize);
+            }
+        }
+
+        if (size > 0)
+            Reserve();
+
+        return measured;
+    }
+
+  private:
+
+    void Reserve () {
+        // Map inaccessible anonymous memory over the window, replacing any file mapping (or filling
+        // the hole a failed fixed mapping may leave), so that no other mapping can be placed there.
+        // If that fails, give up the window, and reserve a new one for the next file.
+
+        const auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED;
+        if (MAP_FAILED == mmap(window, cachedMapWindow, PROT_NONE, flags, -1, 0)) {
+            munmap(window, cachedMapWindow);
+            window = MAP_FAILED;
+        }
+    }
+};
+
+struct CachedDirectory {
+    // A reported directory, and the residency of the files in and (down to the depth limit) below it.
+
+    string   path;
+    size_t   parent;          // Index of the parent directory, or SIZE_MAX for the root
+    uint64_t cached {0};      // Bytes in the page cache
+    uint64_t inFiles {0};     // Total size of the measured files
+    uint64_t unmeasured {0};  // Total size of the files whose residency can't be measured
+};
+
+class CacheScan {
+    // Walks a directory tree in parallel, without crossing into other file systems, and totals the
+    // page cache residency of its regular files by reported directory. Directories below the depth
+    // limit are counted with their ancestor at the limit.
+
+    struct Work {
+        string path;
+        size_t directory;    // Index of the reported directory the files count toward
+        int    depth;        // Levels below the root
+    };
+
+    const int               depthLimit;
+    dev_t                   device {0};      // Device of the root's file system
+    mutex                   lock;
+    condition_variable      workReady;
+    vector<Work>            work;            // Directories to scan, most recently found first
+    size_t                  busy {0};        // Workers scanning a directory
+    vector<CachedDirectory> directories;
+    size_t                  unreadable {0};  // Entries that could not be read
+    size_t                  unmeasured {0};  // Files whose residency can't be measured
+
+  public:
+
+    CacheScan (int depth) : depthLimit{depth} {}
+
+    bool Run (const string& root) {
+        // Scan the tree at the given root. Returns false if the root can't be read.
+
+        struct stat info;
+        if (0 != stat(root.c_str(), &info) || !S_ISDIR(info.st_mode))
+            return false;
+
+        device = info.st_dev;
+        directories.push_back(CachedDirectory{root, SIZE_MAX});
+        work.push_back(Work{root, 0, 0});
+
+        vector<thread> workers;
+        for (size_t i = 0;  i < min<size_t>(cachedMaxWorkers, max(1u, thread::hardware_concurrency()));  ++i)
+            workers.emplace_back([this] { Worker(); });
+
+        for (auto& worker : workers)
+            worker.join();
+
+        // Add each reported directory's totals to its ancestors. Children always follow their parents.
+
+        for (auto i = directories.size();  i-- > 1; ) {
+            directories[directories[i].parent].cached     += directories[i].cached;
+            directories[directories[i].parent].inFiles    += directories[i].inFiles;
+            directories[directories[i].parent].unmeasured += directories[i].unmeasured;
+        }
+
+        return true;
+    }
+
+    const vector<CachedDirectory>& Directories() const { return directories; }
+    size_t Unreadable() const { return unreadable; }
+    size_t Unmeasured() const { return unmeasured; }
+
+  private:
+
+    void Worker () {
+        PageResidency residency;
+        alignas(dirent64) char buffer[32 * 1024];   // Directory entries, reused for each directory
+
+        unique_lock<mutex> guard {lock};
+
+        while (true) {
+            workReady.wait(guard, [this] { return !work.empty() || busy == 0; });
+
+            if (work.empty())
+                break;
+
+            auto item = move(work.back());
+            work.pop_back();
+            ++busy;
+
+            guard.unlock();
+            Scan(item, residency, buffer, sizeof buffer);
+            guard.lock();
+
+            if (--busy == 0 && work.empty())
+                workReady.notify_all();
+        }
+    }
+
+    void Scan (const Work& item, PageResidency& residency, char* buffer, size_t bufferSize) {
+        // Total the files of one directory, and queue its subdirectories.
+
+        const int directory = open(item.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directory < 0) {
+            lock_guard<mutex> guard {lock};
+            ++unreadable;
+            return;
+        }
+
+        uint64_t cached = 0, inFiles = 0, unmeasuredBytes = 0;
+        size_t   failures = 0, unmeasuredFiles = 0;
+        long     length;
+
+        while (0 < (length = syscall(SYS_getdents64, directory, buffer, bufferSize))) {
+            for (long offset = 0;  offset < length; ) {
+                const auto entry = reinterpret_cast<const dirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+
+                const char* name = entry->d_name;
+                if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                    continue;
+
+                auto type = entry->d_type;
+                struct stat info;
+
+                if (type == DT_UNKNOWN) {
+                    if (0 != fstatat(directory, name, &info, AT_SYMLINK_NOFOLLOW)) {
+                        ++failures;
+                        continue;
+                    }
+                    type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+                }
+
+                if (type == DT_DIR) {
+                    if (0 != fstatat(directory, name, &info, AT_SYMLINK_NOFOLLOW)) {
+                        ++failures;
+                    } else if (info.st_dev == device) {
+                        QueueDirectory(item, name);
+                    }
+                } else if (type == DT_REG) {
+                    uint64_t fileCached, fileSize;
+                    bool     measured;
+                    if (!FileResidency(directory, name, residency, fileCached, fileSize, measured)) {
+                        ++failures;
+                    } else if (measured) {
+                        cached  += fileCached;
+                        inFiles += fileSize;
+                    } else {
+                        unmeasuredBytes += fileSize;
+                        ++unmeasuredFiles;
+                    }
+                }
+            }
+        }
+
+        close(directory);
+
+        lock_guard<mutex> guard {lock};
+        directories[item.directory].cached     += cached;
+        directories[item.directory].inFiles    += inFiles;
+        directories[item.directory].unmeasured += unmeasuredBytes;
+        unreadable += failures + (length < 0);
+        unmeasured += unmeasuredFiles;
+    }
+
+    void QueueDirectory (const Work& parent, const char* name) {
+        // Queue a subdirectory for scanning, as a reported directory if it is within the depth limit.
+
+        auto path = parent.path;
+        if (path.back() != '/')
+            path += '/';
+        path += name;
+
+        lock_guard<mutex> guard {lock};
+
+        auto directory = parent.directory;
+        if (parent.depth < depthLimit) {
+            directory = directories.size();
+            directories.push_back(CachedDirectory{path, parent.directory});
+        }
+
+        work.push_back(Work{move(path), directory, parent.depth + 1});
+        workReady.notify_one();
+    }
+
+    static bool FileResidency (
+        int directory, const char* name, PageResidency& residency, uint64_t& cached, uint64_t& size, bool& measured
+    ) {
+        // Read the size and page cache residency of a regular file, and whether the residency could be
+        // measured. Files are opened without updating their access times where permitted. Returns
+        // false on failure.
+
+        auto file = openat(directory, name, O_RDONLY | O_NOATIME | O_NOFOLLOW | O_CLOEXEC);
+        if (file < 0 && errno == EPERM)
+            file = openat(directory, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (file < 0)
+            return false;
+
+        struct stat info;
+        bool ok = 0 == fstat(file, &info);
+
+        if (ok) {
+            size     = static_cast<uint64_t>(info.st_size);
+            measured = PageResidency::CanMeasure(directory, name, info);
+            cached   = 0;
+            ok       = !measured || residency.CachedBytes(file, size, cached);
+        }
+
+        close(file);
+        return ok;
+    }
+};
+
+int RunCached (const CommandOptions& options);
+
+#endif
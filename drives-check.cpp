@@ -0,0 +1,82 @@
+//==================================================================================================
+//
+//  drives: Threshold Checks
+//
+//  See drives-check.h.
+//
+//==================================================================================================
+
+#include "drives-check.h"
+
+const wchar_t* checkStatusNames[] = { L"OK", L"WARNING", L"CRITICAL", L"UNKNOWN" };
+
+int RunCheck (const CommandOptions& options, const vector<DriveInfo>& drives) {
+    // Check the volumes against the rules file, print the status and the failing volumes, and return
+    // the status as the exit code.
+
+    CheckRules rules;
+    if (!rules.Load(options))
+        return static_cast<int>(CheckStatus::Unknown);
+
+    vector<pair<const DriveInfo*, const CheckRule*>> failures;
+    size_t counts [3] {};  // Volumes of each status: OK, WARNING and CRITICAL
+    auto   worst = CheckStatus::OK;
+
+    for (const auto& drive : drives) {
+        const CheckRule* failed;
+        const auto status = rules.Check(drive, failed);
+
+        ++counts[static_cast<int>(status)];
+        worst = max(worst, status);
+        if (failed)
+            failures.emplace_back(&drive, failed);
+    }
+
+    // Print the worst status first, as monitoring plugins do.
+
+    stable_sort(failures.begin(), failures.end(),
+        [](const pair<const DriveInfo*, const CheckRule*>& a, const pair<const DriveInfo*, const CheckRule*>& b) {
+            return a.second->status > b.second->status;
+        });
+
+    if (options.format == OutputFormat::JSON) {
+        wcout << L"[\n";
+
+        for (size_t i = 0;  i < failures.size();  ++i) {
+            const auto& rule = *failures[i].second;
+            wcout << (i ? L",\n" : L"") << L"  {\n"
+                  << L"    \"status\": \"" << checkStatusNames[static_cast<int>(rule.status)] << L"\",\n"
+                  << L"    \"rule\": \"" << Escape(rule.source.c_str()) << L"\",\n"
+                  << L"    \"ruleLine\": " << rule.line << L",\n";
+            failures[i].first->PrintJSONVolumeFields();
+            wcout << L"\n  }";
+        }
+
+        wcout << (failures.empty() ? L"]" : L"\n]") << endl;
+        return static_cast<int>(worst);
+    }
+
+    wcout << checkStatusNames[static_cast<int>(worst)] << L": " << counts[2] << L" critical, " << counts[1]
+          << L" warning, " << counts[0] << L" OK\n";
+
+    size_t widthDriveName{0};
+    size_t widthVolumeLabel{0};
+    size_t widthDriveType{0};
+    size_t widthFileSysName{0};
+
+    for (const auto& failure : failures) {
+        widthDriveName   = failure.first->WidthDriveName(widthDriveName);
+        widthVolumeLabel = failure.first->WidthVolumeLabel(widthVolumeLabel);
+        widthDriveType   = failure.first->WidthDriveType(widthDriveType);
+        widthFileSysName = failure.first->WidthFileSysName(widthFileSysName);
+    }
+
+    for (const auto& failure : failures) {
+        const auto& rule = *failure.second;
+        failure.first->PrintVolumeColumns(widthDriveName, widthVolumeLabel, widthDriveType, widthFileSysName);
+        wcout << L"  " << checkStatusNames[static_cast<int>(rule.status)] << L"  line " << rule.line << L": "
+              << rule.source << L'\n';
+    }
+
+    return static_cast<int>(worst);
+}
@@ -0,0 +1,586 @@
+//==================================================================================================
+//
+//  drives: Threshold Checks
+//
+//  With `--check <rules file>`, drives checks every volume against a set of threshold rules, prints
+//  the volumes that fail them, and exits with a monitoring plugin status (Nagios conventions: 0 OK,
+//  1 WARNING, 2 CRITICAL, 3 UNKNOWN). Each line of the rules file holds one rule:
+//
+//      percentFree < 10 and driveType == Fixed => critical
+//      fileSystem != NTFS => warning
+//
+//  Rules are compiled once into an index, so that each volume is checked in one pass that evaluates
+//  only the rules that could apply to it:
+//
+//    - Text values are interned, so that comparing them is an integer compare. Rules that require
+//      text fields to have given values are indexed by those values, and are checked only against
+//      volumes with those values.
+//    - Among the rules checked against a volume, those whose other conditions are up to two numeric
+//      thresholds are grouped by their fields, comparisons and status, and sorted by the first
+//      threshold. The rules whose first threshold a volume crosses are then a prefix of the group,
+//      found by binary search. The prefix is covered by a few blocks (as in a Fenwick tree), each
+//      sorted by the second threshold, with the earliest rule of each sorted prefix, so that the
+//      first rule in the file that fails the volume is found in logarithmic time.
+//    - A numeric != condition is the same as two alternative thresholds, < and >, and a rule with
+//      one is grouped as both. One text != condition per rule is kept with its group entry, which
+//      holds for every value but the excluded one. Each block keeps the earliest rule for two
+//      different excluded values, so that one of them always applies.
+//    - Remaining rules are evaluated in full.
+//
+//==================================================================================================
+
+#ifndef DRIVES_CHECK_H
+#define DRIVES_CHECK_H
+
+#include "drives-info.h"
+
+enum class CheckStatus { OK = 0, Warning = 1, Critical = 2, Unknown = 3 };   // Values are the exit codes
+
+enum class CheckOp { Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual };
+
+const size_t checkThresholdOps = 4;  // The ordering operators, which thresholds can fold
+
+struct CheckCondition {
+    CheckField field;
+    CheckOp    op;
+    double     number {0};   // Numeric fields: the value compared with
+    int        text {-1};    // Text fields: the interned value compared with
+};
+
+struct CheckRule {
+    vector<CheckCondition> conditions;  // All must hold for the rule to fail a volume
+    CheckStatus            status;      // Status of volumes that fail the rule
+    int                    line;        // Line of the rules file
+    wstring                source;      // Rule text, for output
+};
+
+class CheckRules {
+    // A compiled set of threshold rules.
+
+    struct ThresholdGroup {
+        // Rules of up to two numeric thresholds with the same fields, comparisons, excluded text field
+        // and status.
+
+        struct Entry {
+            double first;       // Limit of the first threshold, if any
+            double second;      // Limit of the second threshold, if any
+            int    excluded;    // Text value the excluded field must not have, if any
+            int    rule;
+        };
+
+        struct Earliest {
+            int entry {-1};     // Entry with the earliest rule
+            int other {-1};     // Entry with the earliest rule of those with another excluded value
+        };
+
+        CheckCondition   first;           // The first threshold (limit aside), if any
+        CheckCondition   second;          // The second threshold (limit aside), if any
+        size_t           thresholds;      // 0, 1 or 2
+        size_t           excludedField;   // Text field with a != condition, or checkTextFieldCount
+        CheckStatus      status;
+        vector<Entry>    entries;         // Sorted so that the entries whose first threshold a volume
+                                          // crosses are a prefix
+        vector<size_t>   blockStart;      // Start in blocks of the block ending at each entry (1-based)
+        vector<int>      blocks;          // Entries of each block, sorted by the second threshold
+        vector<Earliest> earliest;        // For each sorted prefix of a block, its earliest entries
+    };
+
+    struct RuleSet {
+        // Rules checked together: in threshold groups, or else one by one.
+
+        vector<ThresholdGroup> groups;
+        vector<int>            rules;
+    };
+
+    // The text values required of the fields of an index, or -1 for the fields it doesn't require.
+    using TextKey = array<int, checkTextFieldCount>;
+
+    struct TextKeyHash {
+        size_t operator() (const TextKey& key) const {
+            size_t hash = 0;
+            for (const auto value : key)
+                hash = (hash * 1000003) ^ static_cast<size_t>(value + 1);
+            return hash;
+        }
+    };
+
+    using TextIndex = unordered_map<TextKey, RuleSet, TextKeyHash>;  // Rule sets by required text values
+
+    vector<CheckRule>                   rules;
+    deque<wstring>                      texts;      // Interned text values
+    unordered_map<wstring_view, int>    textIds [checkTextFieldCount];  // IDs of texts, by field
+    RuleSet                             unindexed;  // Rules that require no text values
+    vector<pair<unsigned, TextIndex>>   indexed;    // Rules that do, by mask of the fields they require
+
+  public:
+
+    bool Load (const CommandOptions& options) {
+        // Read and compile the rules file. Prints any errors, and returns false on failure.
+
+        ifstream file {ToNativePath(options.checkRulesPath).c_str()};
+        if (!file) {
+            wcerr << options.programName << L": ERROR: Unable to read rules file " << options.checkRulesPath << L".\n";
+            return false;
+        }
+
+        string line;
+        for (int lineNumber = 1;  getline(file, line);  ++lineNumber) {
+            wstring error;
+            if (!Compile(FromUTF8(line), lineNumber, error)) {
+                wcerr << options.checkRulesPath << L':' << lineNumber << L": ERROR: " << error << L'\n';
+                return false;
+            }
+        }
+
+        Index();
+        return true;
+    }
+
+    CheckStatus Check (const DriveInfo& drive, const CheckRule*& failed) const {
+        // Check a volume against all rules. Returns its status, and (unless OK) sets failed to a rule
+        // it fails with that status.
+
+        int    textValues [checkTextFieldCount];
+        double numbers [checkFieldCount];
+
+        for (size_t field = 0;  field < checkFieldCount;  ++field) {
+            const auto checkField = static_cast<CheckField>(field);
+            if (field < checkTextFieldCount) {
+                const auto found = textIds[field].find(drive.CheckText(checkField));
+                textValues[field] = (found == textIds[field].end()) ? -1 : found->second;
+            } else {
+                numbers[field] = drive.CheckNumber(checkField);
+            }
+        }
+
+        int  match  = -1;
+        auto status = CheckStatus::OK;
+
+        auto consider = [&](int rule) {
+            // Take the rule if it fails the volume with a worse status (or the same status, earlier
+            // in the file).
+            const auto& candidate = rules[rule];
+            if (candidate.status < status || (candidate.status == status && rule > match))
+                return;
+            if (Holds(candidate, textValues, numbers)) {
+                status = candidate.status;
+                match  = rule;
+            }
+        };
+
+        auto checkSet = [&](const RuleSet& set) {
+            for (const auto& group : set.groups) {
+                if (group.status >= status) {
+                    const auto entry = FirstFailed(group, textValues, numbers);
+                    if (entry >= 0)
+                        consider(group.entries[entry].rule);
+                }
+            }
+
+            for (auto rule : set.rules)
+                consider(rule);
+        };
+
+        checkSet(unindexed);
+
+        for (const auto& byMask : indexed) {
+            TextKey key;
+            if (!MakeTextKey(byMask.first, textValues, key))
+                continue;
+
+            const auto found = byMask.second.find(key);
+            if (found != byMask.second.end())
+                checkSet(found->second);
+        }
+
+        failed = (match >= 0) ? &rules[match] : nullptr;
+        return status;
+    }
+
+  private:
+
+    static bool IsThreshold (const CheckCondition& condition) {
+        // Returns true if the condition orders a numeric field.
+        return static_cast<size_t>(condition.field) >= checkTextFieldCount
+            && static_cast<size_t>(condition.op) < static_cast<size_t>(CheckOp::Equal);
+    }
+
+    static bool IsUpperLimit (CheckOp op) {
+        return op == CheckOp::Less || op == CheckOp::LessEqual;
+    }
+
+    static bool Compare (double value, CheckOp op, double limit) {
+        switch (op) {
+            case CheckOp::Less:         return value <  limit;
+            case CheckOp::LessEqual:    return value <= limit;
+            case CheckOp::Greater:      return value >  limit;
+            case CheckOp::GreaterEqual: return value >= limit;
+            case CheckOp::Equal:        return value == limit;
+            default:                    return !isnan(value) && value != limit;  // As the others, false if unknown
+        }
+    }
+
+    static int FirstFailed (const ThresholdGroup& group, const int* textValues, const double* numbers) {
+        // Returns the entry of the group with the earliest rule that fails a volume with the given field
+        // values, or -1 if none does.
+
+        auto count = group.entries.size();
+        if (group.thresholds > 0) {
+            const auto value = numbers[static_cast<size_t>(group.first.field)];
+            count = partition_point(group.entries.begin(), group.entries.end(),
+                [&](const ThresholdGroup::Entry& entry) { return Compare(value, group.first.op, entry.first); })
+                - group.entries.begin();
+        }
+
+        const auto excluded = (group.excludedField < checkTextFieldCount) ? textValues[group.excludedField] : -1;
+        const auto second   = numbers[static_cast<size_t>(group.second.field)];
+        int first = -1;
+
+        // Visit the blocks that make up the prefix of crossed entries, as in a Fenwick tree: the block
+        // ending at entry k holds the entries from k, less its lowest set bit.
+
+        for (auto k = count;  k > 0;  k -= k & (~k + 1)) {
+            const auto start = group.blocks.begin() + static_cast<ptrdiff_t>(group.blockStart[k]);
+            const auto end   = group.blocks.begin() + static_cast<ptrdiff_t>(group.blockStart[k + 1]);
+
+            const auto crossed = (group.thresholds < 2) ? end : partition_point(start, end,
+                [&](int entry) { return Compare(second, group.second.op, group.entries[entry].second); });
+            if (crossed == start)
+                continue;
+
+            const auto& earliest   = group.earliest[static_cast<size_t>(crossed - group.blocks.begin()) - 1];
+            const bool  isExcluded = group.excludedField < checkTextFieldCount
+                                  && group.entries[earliest.entry].excluded == excluded;
+            const auto  entry      = isExcluded ? earliest.other : earliest.entry;
+
+            if (entry >= 0 && (first < 0 || group.entries[entry].rule < group.entries[first].rule))
+                first = entry;
+        }
+
+        return first;
+    }
+
+    static bool Holds (const CheckRule& rule, const int* textValues, const double* numbers) {
+        // Returns true if all of the rule's conditions hold for a volume with the given field values.
+
+        for (const auto& condition : rule.conditions) {
+            const auto field = static_cast<size_t>(condition.field);
+            if (field < checkTextFieldCount) {
+                if ((textValues[field] == condition.text) != (condition.op == CheckOp::Equal))
+                    return false;
+            } else if (!Compare(numbers[field], condition.op, condition.number)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool MakeTextKey (unsigned mask, const int* textValues, TextKey& key) {
+        // Collect the text values of the fields in the mask into an index key. Returns false if a value
+        // is mentioned by no rule, so that no rule requiring these fields can match.
+
+        key.fill(-1);
+        for (size_t field = 0;  field < checkTextFieldCount;  ++field) {
+            if (!(mask & (1u << field)))
+                continue;
+            if (textValues[field] < 0)
+                return false;
+            key[field] = textValues[field];
+        }
+        return true;
+    }
+
+    int InternText (CheckField field, const wstring& value) {
+        // Returns the ID of a text value of the given field, assigning one if it is new.
+
+        auto& ids = textIds[static_cast<size_t>(field)];
+        const auto found = ids.find(value);
+        if (found != ids.end())
+            return found->second;
+
+        texts.push_back(value);
+        return ids.emplace(texts.back(), static_cast<int>(texts.size() - 1)).first->second;
+    }
+
+    static vector<wstring> Tokens (const wstring& line) {
+        // Split a rule line into whitespace-separated tokens. Double quotes enclose values with spaces.
+
+        vector<wstring> tokens;
+        for (size_t i = 0;  i < line.length(); ) {
+            if (iswspace(line[i])) {
+                ++i;
+            } else if (line[i] == L'"') {
+                const auto end = line.find(L'"', i + 1);
+                tokens.push_back(line.substr(i + 1, end - i - 1));
+                i = (end == wstring::npos) ? line.length() : end + 1;
+            } else {
+                auto end = i;
+                while (end < line.length() && !iswspace(line[end]))
+                    ++end;
+                tokens.push_back(line.substr(i, end - i));
+                i = end;
+            }
+        }
+        return tokens;
+    }
+
+    static bool ParseNumber (const wstring& text, double& number) {
+        // Parse a number, with an optional size suffix (KB, MB, GB, TB or PB in powers of 1000, or KiB,
+        // MiB, GiB, TiB or PiB in powers of 1024) or percent sign.
+
+        wchar_t* end;
+        number = wcstod(text.c_str(), &end);
+        if (end == text.c_str())
+            return false;
+
+        const wstring suffix {end};
+        if (suffix.empty() || suffix == L"%" || suffix == L"B")
+            return true;
+
+        const wchar_t* const prefixes = L"KMGTP";
+        const auto prefix = wcschr(prefixes, towupper(suffix[0]));
+        if (!prefix)
+            return false;
+
+        const auto scale = (suffix.substr(1) == L"B") ? 1000.0 : (suffix.substr(1) == L"iB") ? 1024.0 : 0.0;
+        if (scale == 0.0)
+            return false;
+
+        number *= pow(scale, static_cast<double>(prefix - prefixes + 1));
+        return true;
+    }
+
+    bool Compile (const wstring& line, int lineNumber, wstring& error) {
+        // Compile one line of the rules file. Returns false (with an error message) if it is invalid.
+
+        const auto tokens = Tokens(line);
+        if (tokens.empty() || tokens[0][0] == L'#')
+            return true;
+
+        CheckRule rule;
+        rule.line = lineNumber;
+
+        size_t i = 0;
+        while (true) {
+            if (i + 3 > tokens.size()) {
+                error = L"Expected <field> <operator> <value>.";
+                return false;
+            }
+
+            CheckCondition condition;
+
+            const auto name = find_if(begin(checkFieldNames), end(checkFieldNames),
+                [&](const auto& entry) { return tokens[i] == entry.name; });
+            if (name == end(checkFieldNames)) {
+                error = L"Unknown field (" + tokens[i] + L").";
+                return false;
+            }
+            condition.field = name->field;
+
+            const wchar_t* const ops[] = { L"<", L"<=", L">", L">=", L"==", L"!=" };
+            const auto op = find(begin(ops), end(ops), tokens[i + 1]);
+            if (op == end(ops)) {
+                error = L"Unknown operator (" + tokens[i + 1] + L").";
+                return false;
+            }
+            condition.op = static_cast<CheckOp>(op - begin(ops));
+
+            if (static_cast<size_t>(condition.field) < checkTextFieldCount) {
+                if (condition.op != CheckOp::Equal && condition.op != CheckOp::NotEqual) {
+                    error = L"Text fields may only be compared with == or !=.";
+                    return false;
+                }
+                condition.text = InternText(condition.field, tokens[i + 2]);
+            } else if (!ParseNumber(tokens[i + 2], condition.number)) {
+                error = L"Invalid number (" + tokens[i + 2] + L").";
+                return false;
+            }
+
+            rule.conditions.push_back(condition);
+            i += 3;
+
+            if (i < tokens.size() && tokens[i] == L"and") {
+                ++i;
+                continue;
+            }
+            break;
+        }
+
+        if (i + 2 != tokens.size() || tokens[i] != L"=>") {
+            error = L"Expected => warning or => critical after the conditions.";
+            return false;
+        }
+
+        if (tokens[i + 1] == L"warning" || tokens[i + 1] == L"warn")
+            rule.status = CheckStatus::Warning;
+        else if (tokens[i + 1] == L"critical" || tokens[i + 1] == L"crit")
+            rule.status = CheckStatus::Critical;
+        else {
+            error = L"Unknown status (" + tokens[i + 1] + L"). Use warning or critical.";
+            return false;
+        }
+
+        const auto first = line.find_first_not_of(L" \t");
+        const auto last  = line.find_last_not_of(L" \t\r");
+        rule.source = line.substr(first, last - first + 1);
+
+        rules.push_back(move(rule));
+        return true;
+    }
+
+    void Index () {
+        // Sort each rule into the rule set for the text values it requires, and there into a threshold
+        // group if its other conditions allow.
+
+        for (size_t i = 0;  i < rules.size();  ++i) {
+            const auto& rule = rules[i];
+
+            unsigned               mask = 0;
+            int                    textValues [checkTextFieldCount];
+            const CheckCondition*  excluded = nullptr;
+            vector<CheckCondition> others;
+
+            for (const auto& condition : rule.conditions) {
+                const auto field = static_cast<size_t>(condition.field);
+                if (field < checkTextFieldCount && condition.op == CheckOp::Equal) {
+                    mask |= 1u << field;
+                    textValues[field] = condition.text;
+                } else if (field < checkTextFieldCount && !excluded) {
+                    excluded = &condition;
+                } else {
+                    others.push_back(condition);
+                }
+            }
+
+            auto set = &unindexed;
+
+            if (mask) {
+                auto byMask = find_if(indexed.begin(), indexed.end(),
+                    [&](const pair<unsigned, TextIndex>& entry) { return entry.first == mask; });
+                if (byMask == indexed.end())
+                    byMask = indexed.insert(indexed.end(), {mask, {}});
+
+                TextKey key;
+                MakeTextKey(mask, textValues, key);
+                set = &byMask->second[key];
+            }
+
+            // Replace a numeric != condition with its alternatives, < and >.
+
+            const auto notEqual = find_if(others.begin(), others.end(), [](const CheckCondition& condition) {
+                return static_cast<size_t>(condition.field) >= checkTextFieldCount && condition.op == CheckOp::NotEqual;
+            });
+
+            auto alternative = others;
+            if (notEqual != others.end())
+                alternative[static_cast<size_t>(notEqual - others.begin())].op = CheckOp::Greater;
+
+            if (others.size() <= 2 && all_of(alternative.begin(), alternative.end(), IsThreshold)) {
+                AddToGroup(*set, alternative, excluded, rule.status, static_cast<int>(i));
+                if (notEqual != others.end()) {
+                    notEqual->op = CheckOp::Less;
+                    AddToGroup(*set, others, excluded, rule.status, static_cast<int>(i));
+                }
+            } else {
+                set->rules.push_back(static_cast<int>(i));
+            }
+        }
+
+        for (auto& group : unindexed.groups)
+            SortGroup(group);
+
+        for (auto& byMask : indexed) {
+            for (auto& set : byMask.second) {
+                for (auto& group : set.second.groups)
+                    SortGroup(group);
+            }
+        }
+    }
+
+    static void AddToGroup (RuleSet& set, const vector<CheckCondition>& thresholds, const CheckCondition* excluded,
+                            CheckStatus status, int rule) {
+        // Add a rule to the set's group for the fields and comparisons of its thresholds, its excluded
+        // text field, and its status.
+
+        const CheckCondition none {CheckField::PercentFree, CheckOp::Less};
+        const auto& first         = thresholds.empty() ? none : thresholds[0];
+        const auto& second        = (thresholds.size() < 2) ? none : thresholds[1];
+        const auto  excludedField = excluded ? static_cast<size_t>(excluded->field) : checkTextFieldCount;
+
+        auto group = find_if(set.groups.begin(), set.groups.end(), [&](const ThresholdGroup& g) {
+            return g.status == status && g.thresholds == thresholds.size() && g.excludedField == excludedField
+                && g.first.field == first.field && g.first.op == first.op
+                && g.second.field == second.field && g.second.op == second.op;
+        });
+
+        if (group == set.groups.end()) {
+            group = set.groups.insert(set.groups.end(), ThresholdGroup{});
+            group->first         = first;
+            group->second        = second;
+            group->thresholds    = thresholds.size();
+            group->excludedField = excludedField;
+            group->status        = status;
+        }
+
+        const auto excludedText = excluded ? excluded->text : -1;
+        group->entries.push_back(ThresholdGroup::Entry{first.number, second.number, excludedText, rule});
+    }
+
+    static void SortGroup (ThresholdGroup& group) {
+        // Order the entries by how readily their first threshold is crossed, most readily first. Then
+        // sort the entries of each block the same way by their second threshold, and find the earliest
+        // entries of each sorted prefix.
+
+        stable_sort(group.entries.begin(), group.entries.end(),
+            [&](const ThresholdGroup::Entry& a, const ThresholdGroup::Entry& b) {
+                return IsUpperLimit(group.first.op) ? a.first > b.first : a.first < b.first;
+            });
+
+        const auto count = group.entries.size();
+        group.blockStart.assign(count + 2, 0);
+        for (size_t k = 1;  k <= count;  ++k)
+            group.blockStart[k + 1] = group.blockStart[k] + (k & (~k + 1));
+
+        group.blocks.resize(group.blockStart[count + 1]);
+        group.earliest.resize(group.blocks.size());
+
+        for (size_t k = 1;  k <= count;  ++k) {
+            const auto start = group.blocks.begin() + static_cast<ptrdiff_t>(group.blockStart[k]);
+            const auto end   = group.blocks.begin() + static_cast<ptrdiff_t>(group.blockStart[k + 1]);
+            iota(start, end, static_cast<int>(k - static_cast<size_t>(end - start)));
+
+            if (group.thresholds == 2) {
+                stable_sort(start, end, [&](int a, int b) {
+                    const auto& entries = group.entries;
+                    return IsUpperLimit(group.second.op) ? entries[a].second > entries[b].second
+                                                         : entries[a].second < entries[b].second;
+                });
+            }
+
+            ThresholdGroup::Earliest earliest;
+            for (auto entry = start;  entry != end;  ++entry) {
+                AddEarliest(group, earliest, *entry);
+                group.earliest[static_cast<size_t>(entry - group.blocks.begin())] = earliest;
+            }
+        }
+    }
+
+    static void AddEarliest (const ThresholdGroup& group, ThresholdGroup::Earliest& earliest, int entry) {
+        // Update the earliest entries of a sequence of entries with the next one.
+
+        const auto& entries = group.entries;
+
+        if (earliest.entry < 0 || entries[entry].rule < entries[earliest.entry].rule) {
+            if (earliest.entry >= 0 && entries[earliest.entry].excluded != entries[entry].excluded)
+                earliest.other = earliest.entry;
+            earliest.entry = entry;
+        } else if (entries[entry].excluded != entries[earliest.entry].excluded
+                   && (earliest.other < 0 || entries[entry].rule < entries[earliest.other].rule)) {
+            earliest.other = entry;
+        }
+    }
+};
+
+int RunCheck (const CommandOptions& options, const vector<DriveInfo>& drives);
+
+#endif
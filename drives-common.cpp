@@ -0,0 +1,236 @@
+//==================================================================================================
+//
+//  drives: Common Definitions
+//
+//  See drives-common.h.
+//
+//==================================================================================================
+
+#include "drives-common.h"
+
+int64_t DaysFromCivil (int64_t year, int64_t month, int64_t day) {
+    // Returns the number of days from 1970-01-01 to the given date of the proleptic Gregorian
+    // calendar. (See Howard Hinnant, "chrono-Compatible Low-Level Date Algorithms".)
+
+    year -= (month <= 2);
+    const auto era       = (year >= 0 ? year : year - 399) / 400;
+    const auto yearOfEra = year - era * 400;
+    const auto dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const auto dayOfEra  = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+void CivilFromDays (int64_t days, int& year, int& month, int& day) {
+    // Sets the date of the proleptic Gregorian calendar that is the given number of days from
+    // 1970-01-01. This reverses DaysFromCivil().
+
+    days += 719468;
+    const auto era       = (days >= 0 ? days : days - 146096) / 146097;
+    const auto dayOfEra  = days - era * 146097;
+    const auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const auto monthIndex = (5 * dayOfYear + 2) / 153;
+
+    day   = static_cast<int>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+    month = static_cast<int>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+    year  = static_cast<int>(yearOfEra + era * 400 + (month <= 2));
+}
+
+//======================================================================================================================
+
+wostream& operator<< (wostream& out, Padding padding) {
+    for (auto i = padding.count;  i > 0;  --i)
+        out.put(L' ');
+    return out;
+}
+
+wostream& operator<< (wostream& out, Escaped escaped) {
+    static const wchar_t hexDigits[] = L"0123456789abcdef";
+
+    for (auto p = escaped.source;  *p;  ++p) {
+        const auto c = static_cast<uint32_t>(*p);
+
+        if (c == L'"' || c == L'\\') {
+            out.put(L'\\');
+            out.put(*p);
+            continue;
+        }
+
+        if (c >= 0x20) {
+            out.put(*p);
+            continue;
+        }
+
+        // Control characters take their short escape if they have one, else the \u form.
+
+        out.put(L'\\');
+        switch (c) {
+            case L'\b': out.put(L'b');  break;
+            case L'\f': out.put(L'f');  break;
+            case L'\n': out.put(L'n');  break;
+            case L'\r': out.put(L'r');  break;
+            case L'\t': out.put(L't');  break;
+            default:
+                out << L"u00";
+                out.put(hexDigits[c >> 4]);
+                out.put(hexDigits[c & 0xf]);
+                break;
+        }
+    }
+    return out;
+}
+
+Escaped Escape (const wchar_t* source) {
+    // Return the source string escaped as RFC 8259 requires within a JSON string: double quotes,
+    // backslashes and control characters. The result is written to a stream.
+    return Escaped{source};
+}
+
+//======================================================================================================================
+
+void AppendUTF8 (string& out, const wchar_t*& source) {
+    // Append the UTF-8 encoding of the next character of the source string, and advance past it.
+    // UTF-16 surrogate pairs (where wchar_t is 16 bits) are combined into a single character.
+
+    uint32_t c = static_cast<uint32_t>(*source++);
+
+    if (0xd800 <= c && c < 0xdc00 && 0xdc00 <= *source && *source < 0xe000)
+        c = 0x10000 + ((c - 0xd800) << 10) + (*source++ - 0xdc00);
+
+    if (c < 0x80) {
+        out += static_cast<char>(c);
+    } else if (c < 0x800) {
+        out += static_cast<char>(0xc0 | (c >> 6));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+    } else if (c < 0x10000) {
+        out += static_cast<char>(0xe0 | (c >> 12));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (c >> 18));
+        out += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (c & 0x3f));
+    }
+}
+
+string ToUTF8 (const wstring& source) {
+    // Return the UTF-8 encoding of the given wide string.
+
+    string result;
+    for (auto p = source.c_str();  *p; )
+        AppendUTF8(result, p);
+    return result;
+}
+
+wstring FromUTF8 (const string& source) {
+    // Return the wide string for the given UTF-8 encoded string. Invalid bytes are passed through as
+    // single characters.
+
+    wstring result;
+
+    for (size_t i = 0;  i < source.length(); ) {
+        const auto c = static_cast<unsigned char>(source[i]);
+        uint32_t codePoint = c;
+        int extra = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : 0;
+
+        if (i + extra >= source.length())
+            extra = 0;
+
+        if (extra) {
+            codePoint = c & (0x3f >> extra);
+            for (int j = 1;  j <= extra;  ++j)
+                codePoint = (codePoint << 6) | (source[i + j] & 0x3f);
+        }
+
+        if (sizeof(wchar_t) == 2 && codePoint >= 0x10000) {
+            result += static_cast<wchar_t>(0xd800 + ((codePoint - 0x10000) >> 10));
+            result += static_cast<wchar_t>(0xdc00 + ((codePoint - 0x10000) & 0x3ff));
+        } else {
+            result += static_cast<wchar_t>(codePoint);
+        }
+
+        i += 1 + extra;
+    }
+
+    return result;
+}
+
+//======================================================================================================================
+
+wstring RecordEscape (const wchar_t* source) {
+    // Return the source string escaped for use as an agent record field: backslashes, tabs and
+    // newlines become "\\", "\t" and "\n".
+
+    wstring result;
+    for (;  auto c = *source;  ++source) {
+        switch (c) {
+            case L'\\': result += L"\\\\"; break;
+            case L'\t': result += L"\\t";  break;
+            case L'\n': result += L"\\n";  break;
+            default:    result += c;      break;
+        }
+    }
+    return result;
+}
+
+vector<wstring> RecordFields (const wstring& record) {
+    // Split an agent record into its tab-separated fields, reversing RecordEscape() on each.
+
+    vector<wstring> fields(1);
+
+    for (size_t i = 0;  i < record.length();  ++i) {
+        auto c = record[i];
+
+        if (c == L'\t') {
+            fields.emplace_back();
+        } else if (c == L'\\' && i + 1 < record.length()) {
+            c = record[++i];
+            fields.back() += (c == L't') ? L'\t' : (c == L'n') ? L'\n' : c;
+        } else {
+            fields.back() += c;
+        }
+    }
+
+    return fields;
+}
+
+//======================================================================================================================
+
+struct Thousands {
+    int64_t        base;
+    const wchar_t* suffix;
+} thousands[] {
+    { 1'000'000'000'000'000'000, L" EB" },
+    { 1'000'000'000'000'000, L" PB" },
+    { 1'000'000'000'000, L" TB" },
+    { 1'000'000'000, L" GB" },
+    { 1'000'000, L" MB" },
+    { 1'000, L" KB" },
+};
+
+InlineString<32> numberPretty (int64_t value) {
+    // Return a pretty-printed string (with thousands suffix) of the input value.
+
+    wchar_t result[32];
+
+    // Handle the case of numbers less than 1,000 (including negative values).
+    if (value < 1'000) {
+        swprintf(result, size(result), L"%lld B", static_cast<long long>(value));
+        return result;
+    }
+
+    // Identify the proper thousands group of the value.
+    const Thousands *group = thousands;
+    while (value < group->base)
+        ++group;
+
+    // Get the significant digits of the value as a multiplier of the base (KB, MB, GB, ...).
+    auto sigDigits = static_cast<double>(value) / group->base;
+
+    wchar_t buffer[] = L"1.234";
+    swprintf(buffer, size(buffer), L"%5f", sigDigits);
+
+    swprintf(result, size(result), L"%ls%ls", buffer, group->suffix);
+    return result;
+}
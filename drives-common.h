@@ -0,0 +1,179 @@
+//==================================================================================================
+//
+//  drives: Common Definitions
+//
+//  The platform headers, and the text, encoding and date helpers shared by the parts of the drives
+//  command-line tool.
+//
+//==================================================================================================
+
+#ifndef DRIVES_COMMON_H
+#define DRIVES_COMMON_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define _WIN32_WINNT 0x501   // Windows XP or Greater
+    #define FD_SETSIZE   1024    // Maximum sockets per select() call, for fleet queries
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <windows.h>
+    #include <winioctl.h>
+    #include <fcntl.h>
+    #include <io.h>
+    #include <share.h>
+    #include <sys/stat.h>
+#else
+    #include <dirent.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <langinfo.h>
+    #include <limits.h>
+    #include <linux/fiemap.h>
+    #include <linux/fs.h>
+    #include <locale.h>
+    #include <netdb.h>
+    #include <sys/file.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <sys/select.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+#include "drives.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Program Version (using the semantic versioning scheme)
+const auto programVersion = L"drives v3.1.0 | 2026-10-18 | https://github.com/hollasch/drives";
+
+// Fleet query defaults
+const auto defaultAgentPort = L"7250";  // TCP port of remote drives agents
+const int  defaultTimeoutMs = 5000;     // Per-host fleet query timeout
+
+
+//======================================================================================================================
+
+int64_t DaysFromCivil (int64_t year, int64_t month, int64_t day);
+void    CivilFromDays (int64_t days, int& year, int& month, int& day);
+
+inline int64_t NowMs () {
+    // Returns the current time in milliseconds since the epoch.
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+//======================================================================================================================
+
+template <size_t Capacity>
+class InlineString {
+    // A wide string held in a fixed-capacity inline buffer, so that assigning or copying it never
+    // allocates. Values longer than the capacity (less the terminating null) are truncated.
+
+    wchar_t text[Capacity] {};
+    size_t  count {0};
+
+  public:
+
+    InlineString () {}
+    InlineString (const wchar_t* source) { *this = source; }
+
+    InlineString& operator= (const wchar_t* source) {
+        for (count = 0;  count < Capacity - 1 && source[count];  ++count)
+            text[count] = source[count];
+        text[count] = 0;
+        return *this;
+    }
+
+    InlineString& operator= (const wstring& source) { return *this = source.c_str(); }
+
+    const wchar_t* c_str() const { return text; }
+    size_t length() const { return count; }
+    bool empty() const { return count == 0; }
+    wchar_t operator[] (size_t index) const { return text[index]; }
+
+    bool operator== (const wchar_t* other) const { return 0 == wcscmp(text, other); }
+};
+
+template <size_t Capacity>
+wostream& operator<< (wostream& out, const InlineString<Capacity>& string) {
+    return out << string.c_str();
+}
+
+using VolumeString = InlineString<DRIVES_MAX_STRING>;  // Holds any libdrives string field
+
+//======================================================================================================================
+
+struct Padding {
+    // Writes the given number of spaces to a stream, without building a string.
+    size_t count;
+};
+
+wostream& operator<< (wostream& out, Padding padding);
+
+struct Escaped {
+    // Writes a string to a stream as the contents of a JSON string. See Escape().
+    const wchar_t* source;
+};
+
+wostream& operator<< (wostream& out, Escaped escaped);
+
+Escaped Escape (const wchar_t* source);
+
+//======================================================================================================================
+
+void    AppendUTF8 (string& out, const wchar_t*& source);
+string  ToUTF8 (const wstring& source);
+wstring FromUTF8 (const string& source);
+
+// File paths in the form taken by the platform's file functions.
+#if defined(_WIN32)
+using NativePath = wstring;
+inline NativePath ToNativePath (const wstring& path) { return path; }
+inline wstring FromNativePath (const NativePath& path) { return path; }
+#else
+using NativePath = string;
+inline NativePath ToNativePath (const wstring& path) { return ToUTF8(path); }
+inline wstring FromNativePath (const NativePath& path) { return FromUTF8(path); }
+#endif
+
+#if defined(_WIN32)
+const wchar_t pathSeparator = L'\\';
+inline bool IsPathSeparator (wchar_t c) { return c == L'\\' || c == L'/'; }
+#else
+const wchar_t pathSeparator = L'/';
+inline bool IsPathSeparator (wchar_t c) { return c == L'/'; }
+#endif
+
+//======================================================================================================================
+
+wstring         RecordEscape (const wchar_t* source);
+vector<wstring> RecordFields (const wstring& record);
+
+InlineString<32> numberPretty (int64_t value);
+
+#endif
@@ -0,0 +1,954 @@
+//==================================================================================================
+//
+//  drives: Fleet Query
+//
+//  See drives-fleet.h.
+//
+//==================================================================================================
+
+#include "drives-fleet.h"
+#include "drives-refresh.h"
+
+const char protocolHeader[] = "drives/1\n";
+const char protocolEnd[]    = "end\n";
+
+const int agentIdleTimeoutMs = 10'000;  // Agent drops connections that make no progress for this long
+const int agentReplyCacheMs  = 1'000;   // Agent reuses a probe result for this long
+const int agentProbePollMs   = 10;      // Longest wait in the agent loop while drives are probed
+
+const size_t fleetResolverThreads = 16;  // Most host names looked up at once
+const int    fleetResolverPollMs  = 10;  // Longest wait in the query loop while lookups are running
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool SplitAddress (const wstring& address, const wstring& defaultPort, string& node, string& service) {
+    // Split an address of the form "host", "host:port", "[IPv6]" or "[IPv6]:port" into its node and
+    // service parts. Returns false if the address is malformed.
+
+    wstring host = address;
+    wstring port = defaultPort;
+
+    if (!address.empty() && address[0] == L'[') {
+        const auto close = address.find(L']');
+        if (close == wstring::npos)
+            return false;
+        host = address.substr(1, close - 1);
+        if (close + 1 < address.length()) {
+            if (address[close + 1] != L':')
+                return false;
+            port = address.substr(close + 2);
+        }
+    } else if (count(address.begin(), address.end(), L':') == 1) {
+        const auto colon = address.find(L':');
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+
+    if (host.empty() || port.empty())
+        return false;
+
+    node    = ToUTF8(host);
+    service = ToUTF8(port);
+    return true;
+}
+
+#if defined(_WIN32)
+const int sendFlags = 0;
+#else
+// POSIX equivalents of the Winsock names used here.
+using SOCKET = int;
+const SOCKET INVALID_SOCKET = -1;
+const int    SOCKET_ERROR   = -1;
+const int    SD_SEND        = SHUT_WR;
+const int    sendFlags      = MSG_NOSIGNAL;  // Report closed connections as errors, not SIGPIPE.
+
+int closesocket (SOCKET socket) { return close(socket); }
+#endif
+
+void SetNonBlocking (SOCKET socket) {
+#if defined(_WIN32)
+    u_long nonBlocking = 1;
+    ioctlsocket(socket, FIONBIO, &nonBlocking);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+bool SocketWouldBlock () {
+    // Returns true if the last socket call failed only because it would block (or, for connect(),
+    // because the connection is still in progress).
+#if defined(_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN || errno == EINPROGRESS;
+#endif
+}
+
+int LastSocketError () {
+#if defined(_WIN32)
+    return WSAGetLastError();
+#else
+    return errno;
+#endif
+}
+
+wstring SocketErrorText (int error) {
+    // Returns the system's description of a socket error code, starting in lower case and without a
+    // final period, as in "connection refused".
+
+    wstring text;
+
+#if defined(_WIN32)
+    wchar_t* message = nullptr;
+    const auto length = FormatMessageW(
+        FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        nullptr, error, 0, reinterpret_cast<wchar_t*>(&message), 0, nullptr);
+    if (length)
+        text.assign(message, length);
+    LocalFree(message);
+#else
+    text = FromUTF8(strerror(error));
+#endif
+
+    while (!text.empty() && (iswspace(text.back()) || text.back() == L'.'))
+        text.pop_back();
+    if (text.empty())
+        return L"socket error " + to_wstring(error);
+
+    text[0] = towlower(text[0]);
+    return text;
+}
+
+bool SocketSelectable (SOCKET socket) {
+    // Returns true if the socket can be used with select(). POSIX fd_sets can only hold descriptors
+    // below FD_SETSIZE, while Winsock fd_sets hold up to FD_SETSIZE sockets of any value.
+#if defined(_WIN32)
+    return socket != INVALID_SOCKET;
+#else
+    return socket != INVALID_SOCKET && socket < FD_SETSIZE;
+#endif
+}
+
+int RemainingMs (Clock::time_point deadline, Clock::time_point now) {
+    // Return the milliseconds from now until the deadline, or zero if the deadline has passed.
+    return max(0, static_cast<int>(chrono::duration_cast<chrono::milliseconds>(deadline - now).count()));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+class FleetAgent {
+    // Serves local drive information to fleet queries. All listening ports and connections are
+    // handled by a single select() loop. The agent only returns on a startup error.
+    //
+    // Probing drives can block for a long time (for example, on an unresponsive network share), so
+    // without a volume cache the agent probes on a separate thread. Requests that arrive while a
+    // probe runs get the previous reply; only requests that arrive before the first probe finishes
+    // wait for it.
+
+    struct Connection {
+        SOCKET            socket {INVALID_SOCKET};
+        string            request;          // Request bytes received so far
+        string            reply;            // Reply to send, once the request is complete
+        bool              waiting {false};  // Request complete, but no probe has finished yet
+        size_t            sent {0};         // Bytes of the reply sent so far
+        Clock::time_point replyAt;          // When to start sending the reply (see --agent-delay)
+        Clock::time_point expires;          // When to drop a connection that makes no progress
+    };
+
+    struct Probe {
+        // State shared with a probe thread, which keeps it alive as long as it runs.
+
+        mutex  lock;
+        bool   done {false};
+        string reply;
+    };
+
+    const CommandOptions& options;
+    VolumeCache*          volumeCache;      // Source of drive information, or null to probe directly
+    vector<SOCKET>        listeners;
+    vector<Connection>    connections;
+    shared_ptr<Probe>     probe;            // Probe in progress, or null
+    string                cachedReply;      // Reply from the last probe, or empty before the first
+    Clock::time_point     cachedReplyTime;
+
+  public:
+
+    FleetAgent (const CommandOptions& _options, VolumeCache* _volumeCache = nullptr)
+      : options{_options}, volumeCache{_volumeCache}
+    {}
+
+    ~FleetAgent() {
+        for (auto listener : listeners)
+            closesocket(listener);
+        for (auto& connection : connections)
+            closesocket(connection.socket);
+    }
+
+    bool Listen() {
+        // Open listening sockets for the agent address, which has the form "[address:]port" or
+        // "[address:]firstPort-lastPort". Without an address, the agent listens on all interfaces.
+
+        string node, service;
+        auto address = options.agentAddress;
+        if (address.find(L':') == wstring::npos)
+            address = L"0.0.0.0:" + address;
+
+        if (!SplitAddress(address, defaultAgentPort, node, service)) {
+            wcerr << options.programName << L": ERROR: Invalid agent address (" << options.agentAddress << L").\n";
+            return false;
+        }
+
+        const auto dash      = service.find('-');
+        const auto firstPort = atoi(service.c_str());
+        const auto lastPort  = (dash == string::npos) ? firstPort : atoi(service.c_str() + dash + 1);
+
+        if (firstPort <= 0 || lastPort < firstPort || 65535 < lastPort
+            || FD_SETSIZE / 2 < lastPort - firstPort + 1) {
+            wcerr << options.programName << L": ERROR: Invalid agent port range (" << options.agentAddress << L").\n";
+            return false;
+        }
+
+        for (auto port = firstPort;  port <= lastPort;  ++port) {
+            addrinfo hints {};
+            hints.ai_family   = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags    = AI_PASSIVE;
+
+            addrinfo* addresses;
+            if (0 != getaddrinfo(node.c_str(), to_string(port).c_str(), &hints, &addresses)) {
+                wcerr << options.programName << L": ERROR: Cannot resolve agent address ("
+                      << options.agentAddress << L").\n";
+                return false;
+            }
+
+            auto listener = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+
+#if !defined(_WIN32)
+            // Allow a restarted agent to listen again while old connections linger in TIME_WAIT.
+            int reuse = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+#endif
+
+            const bool listening = SocketSelectable(listener)
+                && 0 == ::bind(listener, addresses->ai_addr, static_cast<int>(addresses->ai_addrlen))
+                && 0 == listen(listener, SOMAXCONN);
+
+            freeaddrinfo(addresses);
+
+            if (!listening) {
+                wcerr << options.programName << L": ERROR: Cannot listen on port " << port << L".\n";
+                if (listener != INVALID_SOCKET)
+                    closesocket(listener);
+                return false;
+            }
+
+            SetNonBlocking(listener);
+            listeners.push_back(listener);
+        }
+
+        return true;
+    }
+
+    void Run() {
+        // Serve requests forever.
+
+        while (true) {
+            fd_set readSet, writeSet;
+            FD_ZERO(&readSet);
+            FD_ZERO(&writeSet);
+
+            auto now = Clock::now();
+            auto wakeMs = agentIdleTimeoutMs;
+
+            TakeProbe(now);
+            if (probe)
+                wakeMs = agentProbePollMs;
+
+            if (connections.size() < FD_SETSIZE - listeners.size()) {
+                for (auto listener : listeners)
+                    FD_SET(listener, &readSet);
+            }
+
+            for (const auto& connection : connections) {
+                if (connection.waiting) {
+                    wakeMs = min(wakeMs, RemainingMs(connection.expires, now));
+                } else if (connection.reply.empty()) {
+                    FD_SET(connection.socket, &readSet);
+                    wakeMs = min(wakeMs, RemainingMs(connection.expires, now));
+                } else if (connection.replyAt <= now) {
+                    FD_SET(connection.socket, &writeSet);
+                    wakeMs = min(wakeMs, RemainingMs(connection.expires, now));
+                } else {
+                    wakeMs = min(wakeMs, RemainingMs(connection.replyAt, now));
+                }
+            }
+
+            timeval wait { wakeMs / 1000, (wakeMs % 1000) * 1000 };
+            if (select(FD_SETSIZE, &readSet, &writeSet, nullptr, &wait) == SOCKET_ERROR)
+                continue;
+
+            now = Clock::now();
+
+            for (auto listener : listeners) {
+                if (!FD_ISSET(listener, &readSet))
+                    continue;
+
+                auto socket = accept(listener, nullptr, nullptr);
+                if (!SocketSelectable(socket)) {
+                    if (socket != INVALID_SOCKET)
+                        closesocket(socket);
+                    continue;
+                }
+
+                SetNonBlocking(socket);
+                connections.emplace_back();
+                connections.back().socket  = socket;
+                connections.back().expires = now + chrono::milliseconds(agentIdleTimeoutMs);
+            }
+
+            // Connections that stop reading their reply are dropped, as are those that send no request.
+
+            for (auto& connection : connections) {
+                if (FD_ISSET(connection.socket, &readSet))
+                    Receive(connection, now);
+                else if (FD_ISSET(connection.socket, &writeSet))
+                    Send(connection, now);
+                else if (connection.expires <= now)
+                    Close(connection);
+            }
+
+            connections.erase(
+                remove_if(connections.begin(), connections.end(),
+                    [](const Connection& connection) { return connection.socket == INVALID_SOCKET; }),
+                connections.end());
+        }
+    }
+
+  private:
+
+    void Close (Connection& connection) {
+        closesocket(connection.socket);
+        connection.socket = INVALID_SOCKET;
+    }
+
+    void Receive (Connection& connection, Clock::time_point now) {
+        char buffer[256];
+        const auto count = recv(connection.socket, buffer, sizeof buffer, 0);
+
+        if (count == SOCKET_ERROR && SocketWouldBlock())
+            return;
+
+        if (count <= 0) {
+            Close(connection);
+            return;
+        }
+
+        connection.request.append(buffer, count);
+
+        const auto newline = connection.request.find('\n');
+        if (newline == string::npos) {
+            if (connection.request.length() > sizeof buffer)
+                Close(connection);
+            return;
+        }
+
+        if (connection.request.compare(0, newline + 1, protocolHeader) != 0) {
+            Close(connection);
+            return;
+        }
+
+        Refresh(now);
+
+        if (cachedReply.empty())
+            connection.waiting = true;
+        else
+            Answer(connection, now);
+    }
+
+    void Answer (Connection& connection, Clock::time_point now) {
+        // Schedule the current reply for a connection whose request is complete.
+
+        connection.waiting = false;
+        connection.reply   = cachedReply;
+        connection.replyAt = now + chrono::milliseconds(options.agentDelayMs);
+        connection.expires = connection.replyAt + chrono::milliseconds(agentIdleTimeoutMs);
+    }
+
+    void Send (Connection& connection, Clock::time_point now) {
+        const auto count = send(connection.socket, connection.reply.data() + connection.sent,
+                                static_cast<int>(connection.reply.length() - connection.sent), sendFlags);
+
+        if (count == SOCKET_ERROR && SocketWouldBlock())
+            return;
+
+        if (count <= 0) {
+            Close(connection);
+            return;
+        }
+
+        connection.sent   += count;
+        connection.expires = now + chrono::milliseconds(agentIdleTimeoutMs);
+        if (connection.sent == connection.reply.length()) {
+            shutdown(connection.socket, SD_SEND);
+            Close(connection);
+        }
+    }
+
+    static string FormatReply (const vector<DriveInfo>& drives) {
+        wstring reply;
+        for (const auto& drive : drives)
+            reply += drive.Record() + L'\n';
+
+        return protocolHeader + ToUTF8(reply) + protocolEnd;
+    }
+
+    void Refresh (Clock::time_point now) {
+        // Bring the reply up to date for a new request. A recent reply is reused when many requests
+        // arrive together (for example, from a fleet of simulated hosts). The volume cache answers at
+        // once; otherwise a probe is started in the background, if one is not already running.
+
+        if (probe || (!cachedReply.empty() && now < cachedReplyTime + chrono::milliseconds(agentReplyCacheMs)))
+            return;
+
+        if (volumeCache) {
+            vector<DriveInfo> drives;
+            volumeCache->Snapshot(drives);
+            cachedReply     = FormatReply(drives);
+            cachedReplyTime = Clock::now();
+            return;
+        }
+
+        probe = make_shared<Probe>();
+        thread(RunProbe, probe).detach();
+    }
+
+    void TakeProbe (Clock::time_point now) {
+        // If the background probe has finished, make its result the current reply, and answer the
+        // connections that were waiting for it.
+
+        if (!probe)
+            return;
+
+        {
+            lock_guard<mutex> guard {probe->lock};
+            if (!probe->done)
+                return;
+            cachedReply = move(probe->reply);
+        }
+
+        probe.reset();
+        cachedReplyTime = now;
+
+        for (auto& connection : connections) {
+            if (connection.waiting)
+                Answer(connection, now);
+        }
+    }
+
+    static void RunProbe (shared_ptr<Probe> probe) {
+        vector<DriveInfo> drives;
+        DriveCollector().Collect(drives);
+        auto reply = FormatReply(drives);
+
+        lock_guard<mutex> guard {probe->lock};
+        probe->reply = move(reply);
+        probe->done  = true;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+class HostResolver {
+    // Looks up host addresses on a pool of threads, since getaddrinfo() blocks and can't be
+    // cancelled. Lookups still waiting on a slow name server when the resolver is destroyed are left
+    // to finish on their own, and their results are freed.
+
+    struct Lookup {
+        size_t id;        // Caller's identifier for the lookup
+        string node;
+        string service;
+    };
+
+    struct Shared {
+        // State shared with the lookup threads, which keep it alive as long as they run.
+
+        mutex                           lock;
+        condition_variable              lookupReady;
+        deque<Lookup>                   lookups;        // Lookups not yet started
+        vector<pair<size_t, addrinfo*>> results;        // Finished lookups, with null addresses on failure
+        size_t                          threads {0};
+        size_t                          idleThreads {0};
+        bool                            closed {false};
+    };
+
+    shared_ptr<Shared> shared;
+
+  public:
+
+    HostResolver () : shared{make_shared<Shared>()} {}
+
+    ~HostResolver() {
+        lock_guard<mutex> guard {shared->lock};
+
+        shared->closed = true;
+        shared->lookups.clear();
+        for (auto& result : shared->results) {
+            if (result.second)
+                freeaddrinfo(result.second);
+        }
+        shared->results.clear();
+        shared->lookupReady.notify_all();
+    }
+
+    void Resolve (size_t id, const string& node, const string& service) {
+        // Start looking up the addresses of the given node and service.
+
+        lock_guard<mutex> guard {shared->lock};
+        shared->lookups.push_back(Lookup{id, node, service});
+
+        if (shared->idleThreads == 0 && shared->threads < fleetResolverThreads) {
+            ++shared->threads;
+            thread(RunLookups, shared).detach();
+        } else {
+            shared->lookupReady.notify_one();
+        }
+    }
+
+    void TakeResults (vector<pair<size_t, addrinfo*>>& results) {
+        // Replace the given results with the lookups finished since the last call. The caller owns the
+        // addresses returned.
+
+        results.clear();
+        lock_guard<mutex> guard {shared->lock};
+        results.swap(shared->results);
+    }
+
+  private:
+
+    static void RunLookups (shared_ptr<Shared> shared) {
+        unique_lock<mutex> guard {shared->lock};
+
+        while (true) {
+            ++shared->idleThreads;
+            shared->lookupReady.wait(guard, [&] { return shared->closed || !shared->lookups.empty(); });
+            --shared->idleThreads;
+
+            if (shared->closed)
+                return;
+
+            auto lookup = move(shared->lookups.front());
+            shared->lookups.pop_front();
+            guard.unlock();
+
+            addrinfo hints {};
+            hints.ai_family   = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo* addresses = nullptr;
+            if (0 != getaddrinfo(lookup.node.c_str(), lookup.service.c_str(), &hints, &addresses))
+                addresses = nullptr;
+
+            guard.lock();
+
+            if (shared->closed) {
+                if (addresses)
+                    freeaddrinfo(addresses);
+                return;
+            }
+
+            shared->results.emplace_back(lookup.id, addresses);
+        }
+    }
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+struct HostQuery {
+    // The state of a fleet query to a single host.
+
+    enum class State { Pending, Resolving, Connecting, Sending, Receiving, Done };
+
+    wstring           host;                     // Host as given on the command line
+    State             state {State::Pending};
+    SOCKET            socket {INVALID_SOCKET};
+    addrinfo*         addresses {nullptr};      // Resolved addresses of the host
+    addrinfo*         address {nullptr};        // Address currently being tried
+    Clock::time_point deadline;                 // Time at which the query fails
+    size_t            sent {0};                 // Bytes of the request sent so far
+    string            response;                 // Response bytes received so far
+    wstring           error;                    // Reason for failure, empty on success
+    vector<DriveInfo> drives;                   // Drives reported by the host
+};
+
+class FleetQuery {
+    // Queries the drive agents of many hosts concurrently from a single select() loop. Host names are
+    // looked up in the background, so a slow name server holds up only its own hosts. Each host has
+    // its own timeout, which starts when its name lookup is started.
+
+    const CommandOptions& options;
+    vector<HostQuery>     queries;
+    HostResolver          resolver;
+
+  public:
+
+    FleetQuery (const CommandOptions& _options) : options{_options} {
+        // Split the comma-separated host list.
+
+        wstringstream hostList {options.hosts};
+        wstring host;
+
+        while (getline(hostList, host, L',')) {
+            if (!host.empty()) {
+                queries.emplace_back();
+                queries.back().host = host;
+            }
+        }
+    }
+
+    ~FleetQuery() {
+        for (auto& query : queries) {
+            if (query.socket != INVALID_SOCKET)
+                closesocket(query.socket);
+            if (query.addresses)
+                freeaddrinfo(query.addresses);
+        }
+    }
+
+    void Run() {
+        // Query all hosts, limiting the number of simultaneous connections to what a single select()
+        // call can handle.
+
+        const size_t maxActive = FD_SETSIZE - 64;  // Leave room for the process's other descriptors
+        size_t nextQuery = 0;
+        size_t active = 0;
+        size_t resolving = 0;
+
+        vector<pair<size_t, addrinfo*>> resolved;
+
+        while (nextQuery < queries.size() || active > 0) {
+            auto now = Clock::now();
+
+            while (nextQuery < queries.size() && active < maxActive) {
+                auto& query = queries[nextQuery];
+                query.deadline = now + chrono::milliseconds(options.timeoutMs);
+                if (Start(query, nextQuery)) {
+                    ++active;
+                    ++resolving;
+                }
+                ++nextQuery;
+            }
+
+            // Connect to the hosts whose names have been looked up.
+
+            resolver.TakeResults(resolved);
+
+            for (const auto& result : resolved) {
+                auto& query = queries[result.first];
+                --resolving;
+
+                if (query.state != HostQuery::State::Resolving) {
+                    // The query has already timed out.
+                    if (result.second)
+                        freeaddrinfo(result.second);
+                    continue;
+                }
+
+                if (!result.second) {
+                    Fail(query, L"cannot resolve host");
+                } else {
+                    query.addresses = result.second;
+                    query.address   = result.second;
+                    Connect(query);
+                }
+
+                if (query.state == HostQuery::State::Done)
+                    --active;
+            }
+
+            fd_set readSet, writeSet, exceptSet;
+            FD_ZERO(&readSet);
+            FD_ZERO(&writeSet);
+            FD_ZERO(&exceptSet);
+
+            auto wakeMs = resolving ? min(options.timeoutMs, fleetResolverPollMs) : options.timeoutMs;
+
+            for (const auto& query : queries) {
+                if (query.state == HostQuery::State::Resolving) {
+                    // No socket yet, but the query can still time out.
+                } else if (query.state == HostQuery::State::Connecting) {
+                    // Windows reports failed connection attempts through the exception set.
+                    FD_SET(query.socket, &writeSet);
+                    FD_SET(query.socket, &exceptSet);
+                } else if (query.state == HostQuery::State::Sending) {
+                    FD_SET(query.socket, &writeSet);
+                } else if (query.state == HostQuery::State::Receiving) {
+                    FD_SET(query.socket, &readSet);
+                } else {
+                    continue;
+                }
+                wakeMs = min(wakeMs, RemainingMs(query.deadline, now));
+            }
+
+            timeval wait { wakeMs / 1000, (wakeMs % 1000) * 1000 };
+            select(FD_SETSIZE, &readSet, &writeSet, &exceptSet, &wait);
+
+            now = Clock::now();
+
+            for (auto& query : queries) {
+                if (query.state == HostQuery::State::Pending || query.state == HostQuery::State::Done)
+                    continue;
+
+                if (query.deadline <= now)
+                    Fail(query, L"timed out");
+                else if (query.state == HostQuery::State::Resolving)
+                    continue;
+                else if (FD_ISSET(query.socket, &readSet))
+                    Receive(query);
+                else if (FD_ISSET(query.socket, &exceptSet) || FD_ISSET(query.socket, &writeSet)) {
+                    if (query.state == HostQuery::State::Connecting)
+                        Connected(query);
+                    else
+                        Send(query);
+                }
+
+                if (query.state == HostQuery::State::Done)
+                    --active;
+            }
+        }
+    }
+
+    bool PrintResults() const {
+        // Print the merged results of all hosts, and report failed hosts to the error stream. Returns
+        // true if all hosts succeeded.
+
+        vector<DriveRow> rows;
+        bool success = true;
+
+        for (const auto& query : queries) {
+            if (!query.error.empty()) {
+                wcerr << options.programName << L": " << query.host << L": " << query.error << L".\n";
+                success = false;
+                continue;
+            }
+
+            for (const auto& drive : query.drives) {
+                if (options.singleVolume.empty() || drive.Matches(options.singleVolume))
+                    rows.emplace_back(&query.host, &drive);
+            }
+        }
+
+        if (options.format == OutputFormat::Prometheus) {
+            PrintResultsPrometheus(rows);
+        } else if (options.format == OutputFormat::JSON) {
+            wcout << L"[\n";
+            bool first = true;
+            for (const auto& row : rows) {
+                row.second->PrintJSONVolumeInformation(first, L"host", row.first->c_str());
+                first = false;
+            }
+            wcout << L"\n]" << endl;
+        } else {
+            size_t widthHost{0};
+            size_t widthDriveName{0};
+            size_t widthVolumeLabel{0};
+            size_t widthDriveType{0};
+            size_t widthFileSysName{0};
+
+            for (const auto& row : rows) {
+                widthHost        = max(row.first->length(), widthHost);
+                widthDriveName   = row.second->WidthDriveName(widthDriveName);
+                widthVolumeLabel = row.second->WidthVolumeLabel(widthVolumeLabel);
+                widthDriveType   = row.second->WidthDriveType(widthDriveType);
+                widthFileSysName = row.second->WidthFileSysName(widthFileSysName);
+            }
+
+            for (const auto& row : rows) {
+                wcout << *row.first << Padding{widthHost - row.first->length() + 2};
+                row.second->PrintVolumeInformation(
+                    options, widthDriveName, widthVolumeLabel, widthDriveType, widthFileSysName);
+            }
+        }
+
+        return success;
+    }
+
+  private:
+
+    void Fail (HostQuery& query, const wchar_t* reason) {
+        query.error = reason;
+        query.state = HostQuery::State::Done;
+        if (query.socket != INVALID_SOCKET) {
+            closesocket(query.socket);
+            query.socket = INVALID_SOCKET;
+        }
+    }
+
+    bool Start (HostQuery& query, size_t index) {
+        // Start looking up the host (the query of the given index). Returns true if the query is now in
+        // progress.
+
+        string node, service;
+        if (!SplitAddress(query.host, defaultAgentPort, node, service)) {
+            Fail(query, L"invalid host address");
+            return false;
+        }
+
+        query.state = HostQuery::State::Resolving;
+        resolver.Resolve(index, node, service);
+        return true;
+    }
+
+    bool Connect (HostQuery& query) {
+        // Begin a non-blocking connection to the current address of the host, moving on to later
+        // addresses if the connection fails immediately. Returns true if the query is in progress.
+        // If every address fails, the query fails with the reason the last one failed.
+
+        for (;  query.address;  query.address = query.address->ai_next) {
+            const auto address = query.address;
+
+            query.socket = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (query.socket == INVALID_SOCKET) {
+                query.error = L"cannot create socket: " + SocketErrorText(LastSocketError());
+                continue;
+            }
+
+            if (!SocketSelectable(query.socket)) {
+                closesocket(query.socket);
+                query.socket = INVALID_SOCKET;
+                query.error  = L"too many open sockets";
+                continue;
+            }
+
+            SetNonBlocking(query.socket);
+
+            if (0 == connect(query.socket, address->ai_addr, static_cast<int>(address->ai_addrlen))
+                || SocketWouldBlock()) {
+                query.state = HostQuery::State::Connecting;
+                query.error.clear();
+                return true;
+            }
+
+            query.error = SocketErrorText(LastSocketError());
+            closesocket(query.socket);
+            query.socket = INVALID_SOCKET;
+        }
+
+        const auto reason = query.error.empty() ? wstring{L"no address to connect to"} : query.error;
+        Fail(query, reason.c_str());
+        return false;
+    }
+
+    void Connected (HostQuery& query) {
+        // Handle completion of a connection attempt, trying the next address on failure.
+
+        int error = 0;
+        socklen_t errorSize = sizeof error;
+        getsockopt(query.socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &errorSize);
+
+        if (error == 0) {
+            query.state = HostQuery::State::Sending;
+            Send(query);
+            return;
+        }
+
+        closesocket(query.socket);
+        query.socket  = INVALID_SOCKET;
+        query.error   = SocketErrorText(error);
+        query.address = query.address->ai_next;
+        Connect(query);
+    }
+
+    void Send (HostQuery& query) {
+        const auto length = static_cast<int>(sizeof protocolHeader - 1 - query.sent);
+        const auto count  = send(query.socket, protocolHeader + query.sent, length, sendFlags);
+
+        if (count == SOCKET_ERROR) {
+            if (!SocketWouldBlock())
+                Fail(query, L"connection lost");
+            return;
+        }
+
+        query.sent += count;
+        if (query.sent == sizeof protocolHeader - 1)
+            query.state = HostQuery::State::Receiving;
+    }
+
+    void Receive (HostQuery& query) {
+        char buffer[4096];
+        const auto count = recv(query.socket, buffer, sizeof buffer, 0);
+
+        if (count == SOCKET_ERROR) {
+            if (!SocketWouldBlock())
+                Fail(query, L"connection lost");
+            return;
+        }
+
+        if (count > 0) {
+            query.response.append(buffer, count);
+            return;
+        }
+
+        // The agent has closed the connection, so the response is complete.
+
+        closesocket(query.socket);
+        query.socket = INVALID_SOCKET;
+        query.state = HostQuery::State::Done;
+
+        Parse(query);
+    }
+
+    void Parse (HostQuery& query) {
+        // Parse a complete agent response into the host's drive list.
+
+        const string header {protocolHeader};
+        const string end {protocolEnd};
+
+        if (query.response.compare(0, header.length(), header) != 0
+            || query.response.length() < header.length() + end.length()
+            || query.response.compare(query.response.length() - end.length(), end.length(), end) != 0) {
+            query.error = L"invalid or truncated response";
+            return;
+        }
+
+        const auto body = query.response.substr(header.length(), query.response.length() - header.length() - end.length());
+        wstringstream lines {FromUTF8(body)};
+        wstring line;
+
+        while (getline(lines, line)) {
+            query.drives.emplace_back();
+            if (!query.drives.back().FromRecord(line)) {
+                query.drives.clear();
+                query.error = L"invalid drive record";
+                return;
+            }
+        }
+    }
+};
+
+int RunFleet (const CommandOptions& options) {
+    // Query the fleet hosts (--hosts), or answer fleet queries as an agent (--agent). Returns the exit
+    // code.
+
+#if defined(_WIN32)
+    WSADATA wsaData;
+    if (0 != WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+        wcerr << options.programName << L": ERROR: Unable to initialize networking.\n";
+        return 1;
+    }
+#endif
+
+    if (options.mode == Mode::Agent) {
+        VolumeCache volumeCache {options.singleVolume};
+        FleetAgent  agent {options, options.refreshLoop ? &volumeCache : nullptr};
+        if (!agent.Listen())
+            return 1;
+        if (options.refreshLoop)
+            volumeCache.Start();
+        agent.Run();
+        return 0;
+    }
+
+    FleetQuery fleet {options};
+    fleet.Run();
+    return fleet.PrintResults() ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+//==================================================================================================
+//
+//  drives: Fleet Query
+//
+//  With `--agent`, drives listens on one or more TCP ports and answers each connection with the
+//  volume information of the local machine. With `--hosts`, drives connects to the agent on every
+//  listed host at once, and merges the results into a single report with a host column.
+//
+//  The protocol is line-oriented UTF-8. The client sends the request line "drives/1". The agent
+//  replies with the line "drives/1", followed by one DriveInfo::Record() line per drive, followed
+//  by the line "end", and then closes the connection.
+//
+//==================================================================================================
+
+#ifndef DRIVES_FLEET_H
+#define DRIVES_FLEET_H
+
+#include "drives-options.h"
+
+int RunFleet (const CommandOptions& options);
+
+#endif
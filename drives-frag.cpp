@@ -0,0 +1,72 @@
+//==================================================================================================
+//
+//  drives: Fragmentation
+//
+//  See drives-frag.h.
+//
+//==================================================================================================
+
+#include "drives-frag.h"
+
+int RunFrag (const CommandOptions& options) {
+    // Report the fragmentation of the given volume's files, and its most fragmented large files.
+    // Returns the program exit code.
+
+    DrivesVolume volume;
+    if (DRIVES_OK != drives_query(options.fragVolume.c_str(), DRIVES_FIELD_ALL, &volume)) {
+        wcout << options.programName << L": No volume present at " << options.fragVolume << L"." << endl;
+        return 1;
+    }
+
+    FragScan scan {static_cast<size_t>(options.fragTop)};
+    if (!scan.Run(ToNativePath(volume.root))) {
+        wcerr << options.programName << L": ERROR: Unable to read " << volume.root << L".\n";
+        return 1;
+    }
+
+    if (scan.Unsupported()) {
+        wcerr << options.programName << L": ERROR: The file system at " << volume.root
+              << L" does not report file extents.\n";
+        return 1;
+    }
+
+    const auto& totals = scan.Totals();
+    const auto  worst  = scan.MostFragmented();
+
+    DriveInfo drive {volume};
+    drive.SetFragmentation(static_cast<int64_t>(totals.files), static_cast<int64_t>(totals.fragmented),
+                           static_cast<int64_t>(totals.extents));
+
+    if (options.format == OutputFormat::JSON) {
+        wcout << L"[\n  {\n";
+        drive.PrintJSONVolumeFields();
+        wcout << L",\n    \"unreadableEntries\": " << totals.unreadable;
+        wcout << L",\n    \"mostFragmented\": [";
+
+        for (size_t i = 0;  i < worst.size();  ++i) {
+            wcout << (i ? L",\n" : L"\n")
+                  << L"      { \"path\": \"" << Escape(FromNativePath(worst[i].path).c_str())
+                  << L"\", \"extents\": " << worst[i].extents << L", \"fileBytes\": " << worst[i].size << L" }";
+        }
+
+        wcout << (worst.empty() ? L"]\n  }\n]" : L"\n    ]\n  }\n]") << endl;
+        return 0;
+    }
+
+    drive.PrintVolumeInformation(options, drive.WidthDriveName(0), drive.WidthVolumeLabel(0),
+                                 drive.WidthDriveType(0), drive.WidthFileSysName(0));
+
+    // Most fragmented large files, each with its extents and size.
+
+    for (const auto& file : worst) {
+        const auto size = numberPretty(static_cast<int64_t>(file.size));
+        wcout << setw(10) << setfill(L' ') << file.extents << L" extents  "
+              << size << Padding{(size.length() < 10) ? 10 - size.length() : 0}
+              << FromNativePath(file.path) << L'\n';
+    }
+
+    if (totals.unreadable)
+        wcerr << options.programName << L": " << totals.unreadable << L" entries could not be read.\n";
+
+    return 0;
+}
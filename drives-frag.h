@@ -0,0 +1,482 @@
+//==================================================================================================
+//
+//  drives: Fragmentation
+//
+//  With `--frag`, drives walks a volume's directory tree in parallel and reads the extent map of
+//  each regular file: with the FS_IOC_FIEMAP ioctl on Linux, and FSCTL_GET_RETRIEVAL_POINTERS on
+//  Windows. Neither reads file data. Extents that continue where the previous one ends on disk are
+//  counted as one, since file systems split long runs (ext4 at 128 MiB, for example) without
+//  fragmenting them.
+//
+//  The volume's fragmentation factor (as reported by xfs_db) is the share of the files' extents
+//  beyond one per file. Each worker reuses one extent buffer for all its files, and keeps only its
+//  most fragmented large files in a bounded heap, so memory use doesn't grow with the volume.
+//
+//==================================================================================================
+
+#ifndef DRIVES_FRAG_H
+#define DRIVES_FRAG_H
+
+#include "drives-info.h"
+
+const size_t   fragMaxWorkers   = 8;                      // Most threads to scan with
+const uint32_t fragExtentBatch  = 256;                    // Extents read per call
+const uint64_t fragLargeFile    = uint64_t{1} << 20;      // Least size of a file to report as most fragmented
+
+struct FragFile {
+    uint64_t   extents;
+    uint64_t   size;
+    NativePath path;
+};
+
+inline bool MoreFragmented (uint64_t extentsA, uint64_t sizeA, uint64_t extentsB, uint64_t sizeB) {
+    // Ranks files by extents, then by size.
+    return extentsA != extentsB ? extentsA > extentsB : sizeA > sizeB;
+}
+
+class WorstFiles {
+    // The most fragmented files seen, up to a limit. The heap's front is the least fragmented of them.
+
+    size_t           limit;
+    vector<FragFile> heap;
+
+    static bool Compare (const FragFile& a, const FragFile& b) {
+        return MoreFragmented(a.extents, a.size, b.extents, b.size);
+    }
+
+  public:
+
+    WorstFiles (size_t count) : limit{count} {}
+
+    bool Qualifies (uint64_t extents, uint64_t size) const {
+        // Returns true if a file would be added (so its path is needed).
+        return heap.size() < limit
+            || (limit > 0 && MoreFragmented(extents, size, heap.front().extents, heap.front().size));
+    }
+
+    void Add (FragFile&& file) {
+        if (!Qualifies(file.extents, file.size))
+            return;
+
+        if (heap.size() == limit) {
+            pop_heap(heap.begin(), heap.end(), Compare);
+            heap.pop_back();
+        }
+
+        heap.push_back(move(file));
+        push_heap(heap.begin(), heap.end(), Compare);
+    }
+
+    void Merge (WorstFiles& other) {
+        for (auto& file : other.heap)
+            Add(move(file));
+        other.heap.clear();
+    }
+
+    vector<FragFile> Sorted () const {
+        // Returns the files, most fragmented first.
+        auto files = heap;
+        sort(files.begin(), files.end(), Compare);
+        return files;
+    }
+};
+
+struct FragTotals {
+    uint64_t files {0};         // Files with at least one extent
+    uint64_t fragmented {0};    // Files with more than one extent
+    uint64_t extents {0};
+    uint64_t bytes {0};         // Size of the files with extents
+    size_t   unreadable {0};    // Entries that could not be read
+
+    void Add (const FragTotals& other) {
+        files      += other.files;
+        fragmented += other.fragmented;
+        extents    += other.extents;
+        bytes      += other.bytes;
+        unreadable += other.unreadable;
+    }
+};
+
+class ExtentMap {
+    // Counts the extents of open files, reading them in batches into one buffer reused for every file.
+
+#if defined(_WIN32)
+    vector<uint64_t> buffer;    // RETRIEVAL_POINTERS_BUFFER with room for a batch of extents
+#else
+    vector<uint64_t> buffer;    // struct fiemap with room for a batch of extents
+#endif
+
+  public:
+
+#if defined(_WIN32)
+
+    ExtentMap ()
+      : buffer((sizeof(RETRIEVAL_POINTERS_BUFFER) + fragExtentBatch * 2 * sizeof(LARGE_INTEGER)) / 8 + 1)
+    {}
+
+    bool Count (HANDLE file, uint64_t& extents, bool& unsupported) {
+        // Sets the number of extents of the file (not counting holes). Returns false on failure, with
+        // unsupported set if the file system has no extent maps.
+
+        auto pointers = reinterpret_cast<RETRIEVAL_POINTERS_BUFFER*>(buffer.data());
+        const auto size = static_cast<DWORD>(buffer.size() * sizeof buffer[0]);
+
+        STARTING_VCN_INPUT_BUFFER input;
+        input.StartingVcn.QuadPart = 0;
+
+        int64_t nextCluster = -1;   // Cluster following the previous extent
+        extents     = 0;
+        unsupported = false;
+
+        while (true) {
+            DWORD returned;
+            const bool done = 0 != DeviceIoControl(file, FSCTL_GET_RETRIEVAL_POINTERS, &input, sizeof input,
+                                                   pointers, size, &returned, nullptr);
+            const auto error = done ? ERROR_SUCCESS : GetLastError();
+
+            if (error == ERROR_HANDLE_EOF)   // No clusters: an empty file, or one resident in the MFT
+                return true;
+
+            if (!done && error != ERROR_MORE_DATA) {
+                unsupported = error == ERROR_INVALID_FUNCTION || error == ERROR_NOT_SUPPORTED;
+                return false;
+            }
+
+            auto vcn = pointers->StartingVcn.QuadPart;
+            for (DWORD i = 0;  i < pointers->ExtentCount;  ++i) {
+                const auto lcn  = pointers->Extents[i].Lcn.QuadPart;
+                const auto next = pointers->Extents[i].NextVcn.QuadPart;
+
+                if (lcn != -1) {    // Not a hole
+                    if (lcn != nextCluster)
+                        ++extents;
+                    nextCluster = lcn + (next - vcn);
+                }
+
+                vcn = next;
+            }
+
+            if (done || pointers->ExtentCount == 0)
+                return true;
+
+            input.StartingVcn.QuadPart = vcn;
+        }
+    }
+
+#else
+
+    ExtentMap () : buffer((sizeof(fiemap) + fragExtentBatch * sizeof(fiemap_extent)) / 8 + 1) {}
+
+    bool Count (int file, uint64_t& extents, bool& unsupported) {
+        // Sets the number of extents of the file (not counting holes). Returns false on failure, with
+        // unsupported set if the file system has no extent maps.
+
+        auto map = reinterpret_cast<fiemap*>(buffer.data());
+
+        const uint32_t unplaced = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_DATA_INLINE;
+        uint64_t start    = 0;
+        uint64_t nextByte = UINT64_MAX;   // Disk byte following the previous extent, if placed
+        extents     = 0;
+        unsupported = false;
+
+        while (true) {
+            memset(map, 0, sizeof *map);
+            map->fm_start        = start;
+            map->fm_length       = FIEMAP_MAX_OFFSET - start;
+            map->fm_extent_count = fragExtentBatch;
+
+            if (0 != ioctl(file, FS_IOC_FIEMAP, map)) {
+                unsupported = errno == EOPNOTSUPP || errno == ENOTTY;
+                return false;
+            }
+
+            if (map->fm_mapped_extents == 0)
+                return true;
+
+            for (uint32_t i = 0;  i < map->fm_mapped_extents;  ++i) {
+                const auto& extent = map->fm_extents[i];
+
+                if (extent.fe_physical != nextByte)
+                    ++extents;
+                nextByte = (extent.fe_flags & unplaced) ? UINT64_MAX : extent.fe_physical + extent.fe_length;
+
+                if (extent.fe_flags & FIEMAP_EXTENT_LAST)
+                    return true;
+            }
+
+            const auto& last = map->fm_extents[map->fm_mapped_extents - 1];
+            start = last.fe_logical + last.fe_length;
+        }
+    }
+
+#endif
+};
+
+class FragScan {
+    // Walks a directory tree in parallel, without crossing into other file systems, and counts the
+    // extents of its regular files.
+
+    const size_t       topCount;
+    mutex              lock;
+    condition_variable workReady;
+    vector<NativePath> work;                 // Directories to scan, most recently found first
+    size_t             busy {0};             // Workers scanning a directory
+    atomic<bool>       unsupported {false};  // True if the file system has no extent maps
+    FragTotals         totals;
+    WorstFiles         worst;
+
+#if !defined(_WIN32)
+    dev_t              device {0};           // Device of the root's file system
+#endif
+
+  public:
+
+    FragScan (size_t top) : topCount{top}, worst{top} {}
+
+    bool Run (const NativePath& root) {
+        // Scan the tree at the given root. Returns false if the root can't be read.
+
+#if defined(_WIN32)
+        const auto attributes = GetFileAttributesW(root.c_str());
+        if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+            return false;
+#else
+        struct stat info;
+        if (0 != stat(root.c_str(), &info) || !S_ISDIR(info.st_mode))
+            return false;
+        device = info.st_dev;
+#endif
+
+        work.push_back(root);
+
+        vector<thread> workers;
+        for (size_t i = 0;  i < min<size_t>(fragMaxWorkers, max(1u, thread::hardware_concurrency()));  ++i)
+            workers.emplace_back([this] { Worker(); });
+
+        for (auto& worker : workers)
+            worker.join();
+
+        return true;
+    }
+
+    const FragTotals& Totals () const { return totals; }
+    bool Unsupported () const { return unsupported; }
+    vector<FragFile> MostFragmented () const { return worst.Sorted(); }
+
+  private:
+
+    void Worker () {
+        ExtentMap    extentMap;
+        FragTotals   found;
+        WorstFiles   worstFound {topCount};
+
+#if !defined(_WIN32)
+        alignas(dirent64) char buffer[32 * 1024];   // Directory entries, reused for each directory
+#endif
+
+        unique_lock<mutex> guard {lock};
+
+        while (true) {
+            workReady.wait(guard, [this] { return !work.empty() || busy == 0; });
+
+            if (work.empty())
+                break;
+
+            auto directory = move(work.back());
+            work.pop_back();
+            ++busy;
+
+            guard.unlock();
+            if (!unsupported) {
+#if defined(_WIN32)
+                Scan(directory, extentMap, found, worstFound);
+#else
+                Scan(directory, extentMap, found, worstFound, buffer, sizeof buffer);
+#endif
+            }
+            guard.lock();
+
+            if (--busy == 0 && work.empty())
+                workReady.notify_all();
+        }
+
+        totals.Add(found);
+        worst.Merge(worstFound);
+    }
+
+    void QueueDirectory (NativePath&& path) {
+        lock_guard<mutex> guard {lock};
+        work.push_back(move(path));
+        workReady.notify_one();
+    }
+
+    void AddFile (
+        const NativePath& directory, const NativePath::value_type* name, uint64_t size, uint64_t extents,
+        FragTotals& found, WorstFiles& worstFound
+    ) {
+        // Count a file's extents, and keep it if it is among the most fragmented large files.
+
+        if (extents == 0)
+            return;
+
+        ++found.files;
+        found.extents += extents;
+        found.bytes   += size;
+
+        if (extents > 1) {
+            ++found.fragmented;
+            if (size >= fragLargeFile && worstFound.Qualifies(extents, size))
+                worstFound.Add(FragFile{extents, size, JoinPath(directory, name)});
+        }
+    }
+
+    static NativePath JoinPath (const NativePath& directory, const NativePath::value_type* name) {
+        auto path = directory;
+#if defined(_WIN32)
+        if (!IsPathSeparator(path.back()))
+            path += L'\\';
+#else
+        if (path.back() != '/')
+            path += '/';
+#endif
+        path += name;
+        return path;
+    }
+
+#if defined(_WIN32)
+
+    void Scan (const NativePath& directory, ExtentMap& extentMap, FragTotals& found, WorstFiles& worstFound) {
+        // Count the extents of the files of one directory, and queue its subdirectories. Reparse
+        // points (links and mounted volumes) are not followed.
+
+        WIN32_FIND_DATAW entry;
+        const auto find = FindFirstFileW(JoinPath(directory, L"*").c_str(), &entry);
+        if (find == INVALID_HANDLE_VALUE) {
+            ++found.unreadable;
+            return;
+        }
+
+        do {
+            const wchar_t* name = entry.cFileName;
+            if (name[0] == L'.' && (!name[1] || (name[1] == L'.' && !name[2])))
+                continue;
+
+            if (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+                continue;
+
+            if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                QueueDirectory(JoinPath(directory, name));
+                continue;
+            }
+
+            const auto size = (static_cast<uint64_t>(entry.nFileSizeHigh) << 32) | entry.nFileSizeLow;
+            if (size == 0)
+                continue;
+
+            const auto file = CreateFileW(JoinPath(directory, name).c_str(), FILE_READ_ATTRIBUTES,
+                                          FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                ++found.unreadable;
+                continue;
+            }
+
+            uint64_t extents;
+            bool     noExtentMaps;
+            const bool ok = extentMap.Count(file, extents, noExtentMaps);
+            CloseHandle(file);
+
+            if (ok) {
+                AddFile(directory, name, size, extents, found, worstFound);
+            } else if (noExtentMaps) {
+                unsupported = true;
+                break;
+            } else {
+                ++found.unreadable;
+            }
+        } while (FindNextFileW(find, &entry));
+
+        FindClose(find);
+    }
+
+#else
+
+    void Scan (
+        const NativePath& directory, ExtentMap& extentMap, FragTotals& found, WorstFiles& worstFound,
+        char* buffer, size_t bufferSize
+    ) {
+        // Count the extents of the files of one directory, and queue its subdirectories.
+
+        const int handle = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (handle < 0) {
+            ++found.unreadable;
+            return;
+        }
+
+        long length;
+
+        while (!unsupported && 0 < (length = syscall(SYS_getdents64, handle, buffer, bufferSize))) {
+            for (long offset = 0;  offset < length; ) {
+                const auto entry = reinterpret_cast<const dirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+
+                const char* name = entry->d_name;
+                if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2])))
+                    continue;
+
+                auto type = entry->d_type;
+                struct stat info;
+
+                if (type == DT_UNKNOWN) {
+                    if (0 != fstatat(handle, name, &info, AT_SYMLINK_NOFOLLOW)) {
+                        ++found.unreadable;
+                        continue;
+                    }
+                    type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+                }
+
+                if (type == DT_DIR) {
+                    if (0 != fstatat(handle, name, &info, AT_SYMLINK_NOFOLLOW))
+                        ++found.unreadable;
+                    else if (info.st_dev == device)
+                        QueueDirectory(JoinPath(directory, name));
+                    continue;
+                }
+
+                if (type != DT_REG)
+                    continue;
+
+                auto file = openat(handle, name, O_RDONLY | O_NOATIME | O_NOFOLLOW | O_CLOEXEC);
+                if (file < 0 && errno == EPERM)
+                    file = openat(handle, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+                if (file < 0) {
+                    ++found.unreadable;
+                    continue;
+                }
+
+                uint64_t extents = 0;
+                bool     noExtentMaps = false;
+                const bool ok = 0 == fstat(file, &info)
+                             && (info.st_size == 0 || extentMap.Count(file, extents, noExtentMaps));
+                close(file);
+
+                if (ok) {
+                    AddFile(directory, name, static_cast<uint64_t>(info.st_size), extents, found, worstFound);
+                } else if (noExtentMaps) {
+                    unsupported = true;
+                    break;
+                } else {
+                    ++found.unreadable;
+                }
+            }
+        }
+
+        close(handle);
+    }
+
+#endif
+};
+
+int RunFrag (const CommandOptions& options);
+
+#endif
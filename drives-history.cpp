@@ -0,0 +1,221 @@
+//==================================================================================================
+//
+//  drives: Capacity History
+//
+//  See drives-history.h.
+//
+//==================================================================================================
+
+#include "drives-history.h"
+
+uint32_t Crc32 (const uint8_t* data, size_t length) {
+    // Returns the CRC-32 (as used by zip and PNG) of the data.
+
+    static const struct Table {
+        uint32_t entries[256];
+        Table() {
+            for (uint32_t i = 0;  i < 256;  ++i) {
+                uint32_t crc = i;
+                for (int bit = 0;  bit < 8;  ++bit)
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0);
+                entries[i] = crc;
+            }
+        }
+    } table;
+
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0;  i < length;  ++i)
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+bool ReadRecordAt (const MappedFile& file, uint64_t offset, StoreRecord& record) {
+    // Read and verify the record at the offset. Returns false if there is none, or it is torn or
+    // corrupt.
+
+    const auto size = file.Size();
+    if (offset < historyHeaderSize || offset > size || size - offset < historyRecordOverhead)
+        return false;
+
+    const auto base   = file.Data() + offset;
+    const auto length = GetFixed32(base + 1);
+
+    if (length > size - offset - historyRecordOverhead)
+        return false;
+
+    const auto tail = base + 5 + length;
+    if (GetFixed32(tail) != Crc32(base, 5 + length) || GetFixed32(tail + 4) != length)
+        return false;
+
+    record = StoreRecord{static_cast<char>(base[0]), base + 5, length, offset, offset + historyRecordOverhead + length};
+    return true;
+}
+
+bool ReadRecordBefore (const MappedFile& file, uint64_t end, StoreRecord& record) {
+    // Read and verify the record that ends at the given offset. Returns false if there is none.
+
+    if (end > file.Size() || end < historyHeaderSize + historyRecordOverhead)
+        return false;
+
+    const auto length = GetFixed32(file.Data() + end - 4);
+    if (length > end - historyHeaderSize - historyRecordOverhead)
+        return false;
+
+    return ReadRecordAt(file, end - historyRecordOverhead - length, record) && record.end == end;
+}
+
+struct HistorySummary {
+    // Statistics of a volume's samples over the reported time span.
+
+    size_t  samples {0};
+    int64_t firstTime {0}, lastTime {0};
+    int64_t total {0}, free {0};             // Latest sample
+    int64_t minFree {INT64_MAX}, maxFree {INT64_MIN};
+
+    // Least-squares sums for the trend of free space, with time in days from the first sample
+    double sumT {0}, sumF {0}, sumTT {0}, sumTF {0};
+
+    void Add (int64_t time, int64_t sampleTotal, int64_t sampleFree) {
+        if (samples++ == 0)
+            firstTime = time;
+        lastTime = time;
+        total    = sampleTotal;
+        free     = sampleFree;
+        minFree  = min(minFree, sampleFree);
+        maxFree  = max(maxFree, sampleFree);
+
+        const auto t = static_cast<double>(time - firstTime) / 86'400'000.0;
+        const auto f = static_cast<double>(sampleFree);
+        sumT += t;  sumF += f;  sumTT += t * t;  sumTF += t * f;
+    }
+
+    bool HasTrend () const {
+        // The samples must span some time for their trend to mean anything.
+        return samples >= 2 && lastTime - firstTime >= historyTrendSpan;
+    }
+
+    double TrendPerDay () const {
+        // Returns the least-squares slope of free space, in bytes per day.
+
+        const auto n = static_cast<double>(samples);
+        const auto denominator = n * sumTT - sumT * sumT;
+        return (denominator <= 0) ? 0.0 : (n * sumTF - sumT * sumF) / denominator;
+    }
+};
+
+void PrintTime (int64_t ms, bool iso) {
+    // Print a time (in ms since the epoch) in UTC, as "2026-10-18 09:30", or in ISO 8601 form
+    // ("2026-10-18T09:30:00Z").
+
+    const auto seconds = (ms >= 0 ? ms : ms - 999) / 1000;
+    const auto days    = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    const auto ofDay   = seconds - days * 86400;
+
+    int year, month, day;
+    CivilFromDays(days, year, month, day);
+
+    const auto fill = wcout.fill(L'0');
+    wcout << setw(4) << year << L'-' << setw(2) << month << L'-' << setw(2) << day << (iso ? L'T' : L' ')
+          << setw(2) << ofDay / 3600 << L':' << setw(2) << ofDay / 60 % 60;
+    if (iso)
+        wcout << L':' << setw(2) << ofDay % 60 << L'Z';
+    wcout.fill(fill);
+}
+
+int RunHistory (const CommandOptions& options) {
+    // Report each volume's free space over the time span from the history store. Returns the program
+    // exit code.
+
+    HistoryStore store;
+    wstring      error;
+
+    if (!store.Open(ToNativePath(options.historyPath), error)) {
+        wcerr << options.programName << L": ERROR: " << error << L" (" << options.historyPath << L").\n";
+        return 1;
+    }
+
+    vector<HistorySummary> summaries;
+
+    store.Decode(store.StartBefore(options.historyFromMs), options.historyToMs,
+        [&](size_t volume, int64_t time, int64_t total, int64_t free) {
+            if (time < options.historyFromMs || time > options.historyToMs)
+                return;
+            if (volume >= summaries.size())
+                summaries.resize(volume + 1);
+            summaries[volume].Add(time, total, free);
+        });
+
+    const auto& volumes = store.Volumes();
+    bool first = true;
+
+    if (options.format == OutputFormat::JSON)
+        wcout << L"[\n";
+
+    for (size_t i = 0;  i < summaries.size() && i < volumes.size();  ++i) {
+        const auto& summary = summaries[i];
+        const auto& volume  = volumes[i];
+
+        if (!summary.samples)
+            continue;
+
+        if (!options.singleVolume.empty() && volume.key != options.singleVolume && volume.root != options.singleVolume)
+            continue;
+
+        const bool hasTrend   = summary.HasTrend();
+        const auto trend      = hasTrend ? summary.TrendPerDay() : 0.0;
+        const bool fillsUp    = trend < 0 && summary.free > 0;
+        const auto daysToFull = fillsUp ? static_cast<double>(summary.free) / -trend : 0.0;
+
+        if (options.format == OutputFormat::JSON) {
+            wcout << (first ? L"" : L",\n") << L"  {\n"
+                  << L"    \"volume\": \"" << Escape(volume.key.c_str()) << L"\",\n"
+                  << L"    \"mountPoint\": \"" << Escape(volume.root.c_str()) << L"\",\n"
+                  << L"    \"samples\": " << summary.samples << L",\n"
+                  << L"    \"firstTime\": \"";
+            PrintTime(summary.firstTime, true);
+            wcout << L"\",\n    \"lastTime\": \"";
+            PrintTime(summary.lastTime, true);
+            wcout << L"\",\n"
+                  << L"    \"capacityBytes\": " << summary.total << L",\n"
+                  << L"    \"freeBytes\": " << summary.free << L",\n"
+                  << L"    \"minFreeBytes\": " << summary.minFree << L",\n"
+                  << L"    \"maxFreeBytes\": " << summary.maxFree << L",\n"
+                  << L"    \"trendBytesPerDay\": ";
+            if (hasTrend)
+                wcout << static_cast<int64_t>(trend);
+            else
+                wcout << L"null";
+            wcout << L",\n    \"daysUntilFull\": ";
+            if (fillsUp)
+                wcout << daysToFull;
+            else
+                wcout << L"null";
+            wcout << L"\n  }";
+        } else {
+            wcout << volume.root;
+            if (volume.key != volume.root)
+                wcout << L"  " << volume.key;
+
+            wcout << L"\n   " << summary.samples << (summary.samples == 1 ? L" sample, " : L" samples, ");
+            PrintTime(summary.firstTime, false);
+            wcout << L" to ";
+            PrintTime(summary.lastTime, false);
+            wcout << L" UTC\n   " << numberPretty(summary.free) << L" free (min " << numberPretty(summary.minFree)
+                  << L", max " << numberPretty(summary.maxFree) << L") / " << numberPretty(summary.total);
+            if (hasTrend) {
+                wcout << L", trend " << (trend < 0 ? L"-" : L"+")
+                      << numberPretty(static_cast<int64_t>(fabs(trend))) << L"/day";
+            }
+            if (fillsUp)
+                wcout << L", full in " << static_cast<int64_t>(ceil(daysToFull)) << L" days";
+            wcout << L"\n\n";
+        }
+
+        first = false;
+    }
+
+    if (options.format == OutputFormat::JSON)
+        wcout << (first ? L"]" : L"\n]") << endl;
+
+    return 0;
+}
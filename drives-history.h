@@ -0,0 +1,560 @@
+//==================================================================================================
+//
+//  drives: Capacity History
+//
+//  With `--record <store>`, drives appends the capacity and free space of each volume to a history
+//  store; with `--history <store>`, it reports the range and trend of each volume's free space over
+//  a span of time. The store is an append-only file of checksummed records, after an 8-byte header:
+//
+//      type   length   payload   CRC-32   length
+//
+//  The type is one byte, the lengths (of the payload) and CRC (of the type, length and payload) are
+//  32 bits, little-endian. The trailing length lets the file be walked backward from its end.
+//
+//    - Volume records ('V') name a new volume, which takes the next volume number: its identity
+//      (the volume ID, or else the mount point) and mount point.
+//    - Sample records ('S') hold one run: its time, as the change from the previous run's, and the
+//      volumes' numbers and changes in capacity and free space since their previous samples. All
+//      numbers are varints, with signed values zigzag-encoded, so a typical sample takes a few
+//      bytes.
+//    - Index records ('I') hold the full state (the time, and every volume with its latest sample)
+//      and the offset of the previous index record. One is written after every 64 KiB of records,
+//      so readers start decoding at the index record before the span of interest, found through the
+//      chain from the end of the file, and read no more of the (memory-mapped) file than they need.
+//
+//  Each run's records are written with one write, and flushed to disk. A crash can leave only a
+//  torn final write, which fails its checksum: readers stop before it, and the next append
+//  truncates it. Each append holds an exclusive lock on the store (flock(2), or LockFileEx on
+//  Windows) from reading its state to writing the run, so processes may append at once; readers
+//  need no lock.
+//
+//==================================================================================================
+
+#ifndef DRIVES_HISTORY_H
+#define DRIVES_HISTORY_H
+
+#include "drives-info.h"
+
+const uint8_t  historyMagic[8]        = { 'D', 'R', 'V', 'H', 'I', 'S', 'T', 1 };
+const uint64_t historyHeaderSize      = sizeof historyMagic;
+const uint64_t historyRecordOverhead  = 1 + 4 + 4 + 4;      // Type, length, CRC and trailing length
+const uint64_t historyIndexInterval   = 64 * 1024;          // Bytes of records between index records
+const int64_t  historyTrendSpan       = 3'600'000;          // Least span of samples (ms) to report a trend
+
+uint32_t Crc32 (const uint8_t* data, size_t length);
+
+inline uint32_t GetFixed32 (const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+class RecordWriter {
+    // Builds history store records in a byte buffer.
+
+    vector<uint8_t> bytes;
+    size_t          start {0};  // Offset of the record being built
+
+  public:
+
+    const vector<uint8_t>& Bytes () const { return bytes; }
+
+    void Begin (char type) {
+        start = bytes.size();
+        bytes.push_back(static_cast<uint8_t>(type));
+        PutFixed32(0);
+    }
+
+    void End () {
+        // Finish the record: fill in its length, and add its checksum and trailing length.
+
+        const auto length = static_cast<uint32_t>(bytes.size() - start - 5);
+        for (int i = 0;  i < 4;  ++i)
+            bytes[start + 1 + i] = static_cast<uint8_t>(length >> (8 * i));
+
+        PutFixed32(Crc32(bytes.data() + start, 5 + length));
+        PutFixed32(length);
+    }
+
+    void PutFixed32 (uint32_t value) {
+        for (int i = 0;  i < 4;  ++i)
+            bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void PutVarint (uint64_t value) {
+        for (;  value >= 0x80;  value >>= 7)
+            bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    void PutSigned (int64_t value) {
+        PutVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void PutString (const wstring& value) {
+        const auto utf8 = ToUTF8(value);
+        PutVarint(utf8.length());
+        bytes.insert(bytes.end(), utf8.begin(), utf8.end());
+    }
+};
+
+class PayloadReader {
+    // Reads the fields of a record payload. Reads past the end return zero and mark the payload bad.
+
+    const uint8_t* cursor;
+    const uint8_t* end;
+    bool           ok {true};
+
+  public:
+
+    PayloadReader (const uint8_t* data, size_t length) : cursor{data}, end{data + length} {}
+
+    bool Done () const { return ok && cursor == end; }
+    bool Ok () const { return ok; }
+
+    uint64_t Varint () {
+        uint64_t value = 0;
+        for (int shift = 0;  shift < 64;  shift += 7) {
+            if (cursor == end)
+                break;
+            const auto byte = *cursor++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t Signed () {
+        const auto value = Varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    wstring String () {
+        const auto length = Varint();
+        if (length > static_cast<uint64_t>(end - cursor)) {
+            ok = false;
+            return {};
+        }
+        string utf8 {reinterpret_cast<const char*>(cursor), static_cast<size_t>(length)};
+        cursor += length;
+        return FromUTF8(utf8);
+    }
+};
+
+class MappedFile {
+    // A file mapped read-only into memory.
+
+    const uint8_t* data {nullptr};
+    uint64_t       size {0};
+
+#if defined(_WIN32)
+    HANDLE mapping {nullptr};
+#endif
+
+  public:
+
+    ~MappedFile() { Close(); }
+
+    const uint8_t* Data () const { return data; }
+    uint64_t       Size () const { return size; }
+
+    bool Open (const NativePath& path) {
+        // Map the file. Returns false if it can't be read.
+
+        Close();
+
+#if defined(_WIN32)
+        const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        bool ok = 0 != GetFileSizeEx(file, &fileSize);
+        size = ok ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+
+        if (ok && size > 0) {
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            ok = data != nullptr;
+        }
+
+        CloseHandle(file);
+#else
+        const int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            return false;
+
+        struct stat info;
+        bool ok = 0 == fstat(file, &info);
+        size = ok ? static_cast<uint64_t>(info.st_size) : 0;
+
+        if (ok && size > 0) {
+            const auto mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+            data = (mapped == MAP_FAILED) ? nullptr : static_cast<const uint8_t*>(mapped);
+            ok = data != nullptr;
+        }
+
+        close(file);
+#endif
+
+        if (!ok)
+            Close();
+        return ok;
+    }
+
+    void Close () {
+#if defined(_WIN32)
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        if (data)
+            munmap(const_cast<uint8_t*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+};
+
+struct StoreRecord {
+    char           type;
+    const uint8_t* payload;
+    uint32_t       length;   // Payload length
+    uint64_t       offset;   // Offset of the record in the file
+    uint64_t       end;      // Offset of the next record
+};
+
+bool ReadRecordAt (const MappedFile& file, uint64_t offset, StoreRecord& record);
+bool ReadRecordBefore (const MappedFile& file, uint64_t end, StoreRecord& record);
+
+struct HistoryVolume {
+    wstring key;           // Identity: the volume ID, or else the mount point
+    wstring root;          // Mount point when first recorded
+    int64_t total {0};     // Latest sample
+    int64_t free {0};
+};
+
+class HistoryStore {
+    // Reads a history store, and appends to it.
+
+    MappedFile file;
+    uint64_t   validEnd {0};         // End of the last intact record
+
+    // State, as of the last record decoded
+
+    vector<HistoryVolume> volumes;   // By volume number
+    int64_t               time {0};  // Time of the latest run, in ms since the epoch
+    uint64_t              lastIndex {0};  // Offset of the latest index record, or 0 if none
+
+  public:
+
+    bool Open (const NativePath& path, wstring& error) {
+        // Map the store, and find the end of its intact records. Returns false (with an error
+        // message) if it is not a history store.
+
+        if (!file.Open(path)) {
+            error = L"Unable to read history store";
+            return false;
+        }
+
+        if (file.Size() < historyHeaderSize || 0 != memcmp(file.Data(), historyMagic, historyHeaderSize)) {
+            error = L"Not a history store";
+            return false;
+        }
+
+        // Normally the file ends with an intact record. If not, the last append was torn: find the
+        // end of the intact records from the start.
+
+        StoreRecord record;
+        if (file.Size() == historyHeaderSize || ReadRecordBefore(file, file.Size(), record)) {
+            validEnd = file.Size();
+        } else {
+            for (validEnd = historyHeaderSize;  ReadRecordAt(file, validEnd, record);  validEnd = record.end)
+                continue;
+        }
+
+        return true;
+    }
+
+    uint64_t Size () const { return file.Size(); }
+    uint64_t ValidEnd () const { return validEnd; }
+    const vector<HistoryVolume>& Volumes () const { return volumes; }
+    int64_t Time () const { return time; }
+    uint64_t LastIndex () const { return lastIndex; }
+
+    void Close () { file.Close(); }
+
+    uint64_t StartBefore (int64_t from) const {
+        // Returns the offset to start decoding at, to see all samples from the given time on: the
+        // last index record before that time, or else the start of the records. (An index record
+        // holds the state after the run at its time, so decoding from it does not see that run's
+        // samples.)
+
+        // Find the last index record. It lies within an index interval of the end.
+
+        StoreRecord record;
+        auto end = validEnd;
+        while (ReadRecordBefore(file, end, record) && record.type != 'I')
+            end = record.offset;
+
+        if (end == historyHeaderSize || record.type != 'I')
+            return historyHeaderSize;
+
+        // Follow the chain of index records back to one before the time.
+
+        while (true) {
+            PayloadReader reader {record.payload, record.length};
+            const auto indexTime     = static_cast<int64_t>(reader.Varint());
+            const auto previousIndex = reader.Varint();
+
+            if (indexTime < from)
+                return record.offset;
+
+            if (!previousIndex || !ReadRecordAt(file, previousIndex, record) || record.type != 'I')
+                return historyHeaderSize;
+        }
+    }
+
+    template <typename OnSample>
+    void Decode (uint64_t start, int64_t until, OnSample onSample) {
+        // Decode the records from the start offset up to the end of the intact records (or the first
+        // run after the given time), calling onSample(volume, time, total, free) for each sample.
+        // Decoding starts from an empty state unless it starts at an index record.
+
+        volumes.clear();
+        time = 0;
+        lastIndex = 0;
+
+        StoreRecord record;
+        for (auto offset = start;  offset < validEnd && ReadRecordAt(file, offset, record);  offset = record.end) {
+            if (!Apply(record, onSample) || time > until)
+                break;
+        }
+    }
+
+    bool Append (const NativePath& path, const vector<DriveInfo>& drives, int64_t now, wstring& error) {
+        // Append a run's samples of the drives' capacities, creating the store if need be. Returns
+        // false (with an error message) on failure.
+
+        const auto output = OpenLocked(path);
+        if (!output) {
+            error = L"Unable to open history store";
+            return false;
+        }
+
+        // A new store gets its header. Otherwise, load the state from the last index record on.
+
+        fseek(output, 0, SEEK_END);
+        if (ftell(output) == 0
+            && (fwrite(historyMagic, 1, historyHeaderSize, output) != historyHeaderSize || 0 != fflush(output))) {
+            CloseLocked(output);
+            error = L"Unable to write history store";
+            return false;
+        }
+
+        if (!Open(path, error)) {
+            CloseLocked(output);
+            return false;
+        }
+
+        Decode(StartBefore(INT64_MAX), INT64_MAX, [](size_t, int64_t, int64_t, int64_t) {});
+
+        const auto size = file.Size();
+        const auto end  = validEnd;
+        Close();  // Windows can't truncate a mapped file
+
+        // Build the run's records: any new volumes, the samples, and an index record if due.
+
+        RecordWriter records;
+
+        unordered_map<wstring, size_t> numbers;
+        for (size_t i = 0;  i < volumes.size();  ++i)
+            numbers.emplace(volumes[i].key, i);
+
+        vector<pair<size_t, const DriveInfo*>> samples;
+
+        for (const auto& drive : drives) {
+            if (!drive.HasCapacity())
+                continue;
+
+            const wstring key {*drive.VolumeId() ? drive.VolumeId() : drive.RootPath()};
+            auto found = numbers.find(key);
+
+            if (found == numbers.end()) {
+                found = numbers.emplace(key, volumes.size()).first;
+                volumes.push_back(HistoryVolume{key, drive.RootPath()});
+
+                records.Begin('V');
+                records.PutString(key);
+                records.PutString(drive.RootPath());
+                records.End();
+            }
+
+            samples.emplace_back(found->second, &drive);
+        }
+
+        records.Begin('S');
+        records.PutSigned(now - time);
+        records.PutVarint(samples.size());
+
+        for (const auto& sample : samples) {
+            auto& volume = volumes[sample.first];
+            records.PutVarint(sample.first);
+            records.PutSigned(sample.second->BytesTotal() - volume.total);
+            records.PutSigned(sample.second->BytesFree() - volume.free);
+            volume.total = sample.second->BytesTotal();
+            volume.free  = sample.second->BytesFree();
+        }
+
+        records.End();
+        time = now;
+
+        if (!lastIndex || end + records.Bytes().size() - lastIndex >= historyIndexInterval) {
+            records.Begin('I');
+            records.PutVarint(static_cast<uint64_t>(time));
+            records.PutVarint(lastIndex);
+            records.PutVarint(volumes.size());
+            for (const auto& volume : volumes) {
+                records.PutString(volume.key);
+                records.PutString(volume.root);
+                records.PutVarint(static_cast<uint64_t>(volume.total));
+                records.PutVarint(static_cast<uint64_t>(volume.free));
+            }
+            records.End();
+        }
+
+        // Drop any torn record, then write the run and flush it to disk.
+
+        const auto& bytes = records.Bytes();
+        bool ok = true;
+
+#if defined(_WIN32)
+        if (end < size)
+            ok = 0 == _chsize_s(_fileno(output), static_cast<long long>(end));
+        ok = ok && 0 == _fseeki64(output, static_cast<long long>(end), SEEK_SET);
+#else
+        if (end < size)
+            ok = 0 == ftruncate(fileno(output), static_cast<off_t>(end));
+        ok = ok && 0 == fseeko(output, static_cast<off_t>(end), SEEK_SET);
+#endif
+
+        ok = ok && fwrite(bytes.data(), 1, bytes.size(), output) == bytes.size() && 0 == fflush(output);
+
+#if defined(_WIN32)
+        ok = ok && 0 == _commit(_fileno(output));
+#else
+        ok = ok && 0 == fsync(fileno(output));
+#endif
+
+        ok = (0 == CloseLocked(output)) && ok;
+
+        if (!ok)
+            error = L"Unable to write history store";
+        return ok;
+    }
+
+  private:
+
+    static FILE* OpenLocked (const NativePath& path) {
+        // Open the store for update, creating it if need be, and wait for an exclusive lock on it.
+        // Returns null on failure.
+
+#if defined(_WIN32)
+        int descriptor = -1;
+        _wsopen_s(&descriptor, path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY | _O_NOINHERIT, _SH_DENYNO,
+                  _S_IREAD | _S_IWRITE);
+        const auto output = (descriptor < 0) ? nullptr : _fdopen(descriptor, "r+b");
+        if (!output && descriptor >= 0)
+            _close(descriptor);
+
+        // Lock a byte far past the end of any store, not the records, which readers map unlocked.
+
+        OVERLAPPED overlapped {};
+        overlapped.Offset     = 0xffffffff;
+        overlapped.OffsetHigh = 0x7fffffff;
+        const auto handle = output ? reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(output))) : nullptr;
+        const bool locked = output && LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+#else
+        const int descriptor = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        const auto output = (descriptor < 0) ? nullptr : fdopen(descriptor, "r+b");
+        if (!output && descriptor >= 0)
+            close(descriptor);
+
+        bool locked = false;
+        while (output && !locked) {
+            locked = 0 == flock(descriptor, LOCK_EX);
+            if (!locked && errno != EINTR)
+                break;
+        }
+#endif
+
+        if (output && !locked) {
+            fclose(output);
+            return nullptr;
+        }
+        return output;
+    }
+
+    static int CloseLocked (FILE* output) {
+        // Unlock and close the store. Returns zero on success, as fclose().
+
+#if defined(_WIN32)
+        OVERLAPPED overlapped {};
+        overlapped.Offset     = 0xffffffff;
+        overlapped.OffsetHigh = 0x7fffffff;
+        UnlockFileEx(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(output))), 0, 1, 0, &overlapped);
+#endif
+        return fclose(output);  // Closing the file releases its flock()
+    }
+
+    template <typename OnSample>
+    bool Apply (const StoreRecord& record, OnSample& onSample) {
+        // Apply a record to the state. Returns false if it is malformed.
+
+        PayloadReader reader {record.payload, record.length};
+
+        if (record.type == 'V') {
+            auto key  = reader.String();
+            auto root = reader.String();
+            volumes.push_back(HistoryVolume{move(key), move(root)});
+
+        } else if (record.type == 'S') {
+            time += reader.Signed();
+
+            for (auto count = reader.Varint();  count > 0 && reader.Ok();  --count) {
+                const auto number = reader.Varint();
+                if (number >= volumes.size())
+                    return false;
+
+                auto& volume = volumes[number];
+                volume.total += reader.Signed();
+                volume.free  += reader.Signed();
+                onSample(static_cast<size_t>(number), time, volume.total, volume.free);
+            }
+
+        } else if (record.type == 'I') {
+            time = static_cast<int64_t>(reader.Varint());
+            reader.Varint();  // The previous index record
+            lastIndex = record.offset;
+
+            volumes.clear();
+            for (auto count = reader.Varint();  count > 0 && reader.Ok();  --count) {
+                HistoryVolume volume;
+                volume.key   = reader.String();
+                volume.root  = reader.String();
+                volume.total = static_cast<int64_t>(reader.Varint());
+                volume.free  = static_cast<int64_t>(reader.Varint());
+                volumes.push_back(move(volume));
+            }
+        }
+
+        return reader.Done();
+    }
+};
+
+int RunHistory (const CommandOptions& options);
+
+#endif
@@ -0,0 +1,62 @@
+//==================================================================================================
+//
+//  drives: Volume Information
+//
+//  Volume list output. See drives-info.h.
+//
+//==================================================================================================
+
+#include "drives-info.h"
+
+void PrintResultsHuman(const CommandOptions& options, vector<DriveInfo>& drives) {
+    size_t widthDriveName{0};
+    size_t widthVolumeLabel{0};
+    size_t widthDriveType{0};
+    size_t widthFileSysName{0};
+
+    for (const auto& drive : drives) {
+        widthDriveName   = drive.WidthDriveName(widthDriveName);
+        widthVolumeLabel = drive.WidthVolumeLabel(widthVolumeLabel);
+        widthDriveType   = drive.WidthDriveType(widthDriveType);
+        widthFileSysName = drive.WidthFileSysName(widthFileSysName);
+    }
+
+    for (const auto& drive : drives)
+        drive.PrintVolumeInformation(options, widthDriveName, widthVolumeLabel, widthDriveType, widthFileSysName);
+}
+
+//======================================================================================================================
+
+void PrintResultsJSON(const vector<DriveInfo>& drives) {
+    wcout << L"[\n";
+
+    bool first = true;
+    for (const auto& drive : drives) {
+        drive.PrintJSONVolumeInformation(first);
+        first = false;
+    }
+
+    wcout << L"\n]" << endl;
+}
+
+//======================================================================================================================
+
+void RenderPrometheus (MetricsBuffer& metrics, const vector<DriveRow>& rows) {
+    // Render the drives in Prometheus text exposition format, grouped by metric family.
+
+    metrics.Reserve(4096 * (rows.size() + 1));
+
+    for (const auto& family : prometheusFamilies) {
+        metrics.Append("# HELP ").Append(family.name).Append(" ").Append(family.help).Append("\n");
+        metrics.Append("# TYPE ").Append(family.name).Append(" gauge\n");
+
+        for (const auto& row : rows)
+            row.second->PrintPrometheusMetric(metrics, family.metric, family.name, row.first);
+    }
+}
+
+void PrintResultsPrometheus (const vector<DriveRow>& rows) {
+    MetricsBuffer metrics {4096 * (rows.size() + 1)};
+    RenderPrometheus(metrics, rows);
+    fwrite(metrics.Text().data(), 1, metrics.Text().length(), stdout);
+}
@@ -0,0 +1,789 @@
+//==================================================================================================
+//
+//  drives: Volume Information
+//
+//  The information of one volume, as read through libdrives, and its human, JSON, Prometheus and
+//  agent record output.
+//
+//==================================================================================================
+
+#ifndef DRIVES_INFO_H
+#define DRIVES_INFO_H
+
+#include "drives-options.h"
+
+// File-system flags reported by GetVolumeInformationW(), in increasing value order (bit place,
+// right-to-left).
+const struct {
+    const wchar_t* name;
+    const uint32_t value;
+} sysFlagBits[] = {
+    { L"caseSensitiveSearch",       DRIVES_FS_CASE_SENSITIVE_SEARCH },
+    { L"casePreservedNames",        DRIVES_FS_CASE_PRESERVED_NAMES },
+    { L"unicodeOnDisk",             DRIVES_FS_UNICODE_ON_DISK },
+    { L"persistentACLs",            DRIVES_FS_PERSISTENT_ACLS },
+    { L"fileCompression",           DRIVES_FS_FILE_COMPRESSION },
+    { L"volumeQuotas",              DRIVES_FS_VOLUME_QUOTAS },
+    { L"supportsSparseFiles",       DRIVES_FS_SUPPORTS_SPARSE_FILES },
+    { L"supportsReparsePoints",     DRIVES_FS_SUPPORTS_REPARSE_POINTS },
+    { L"supportsRemoteStorage",     DRIVES_FS_SUPPORTS_REMOTE_STORAGE },
+    { L"returnsCleanupResultInfo",  DRIVES_FS_RETURNS_CLEANUP_RESULT_INFO },
+    { L"supportsPosixUnlinkRename", DRIVES_FS_SUPPORTS_POSIX_UNLINK_RENAME },
+    { L"volumeIsCompressed",        DRIVES_FS_VOLUME_IS_COMPRESSED },
+    { L"supportsObjectIds",         DRIVES_FS_SUPPORTS_OBJECT_IDS },
+    { L"supportsEncryption",        DRIVES_FS_SUPPORTS_ENCRYPTION },
+    { L"namedStreams",              DRIVES_FS_NAMED_STREAMS },
+    { L"readOnlyVolume",            DRIVES_FS_READ_ONLY_VOLUME },
+    { L"sequentialWriteOnce",       DRIVES_FS_SEQUENTIAL_WRITE_ONCE },
+    { L"supportsTransactions",      DRIVES_FS_SUPPORTS_TRANSACTIONS },
+    { L"supportsHardLinks",         DRIVES_FS_SUPPORTS_HARD_LINKS },
+    { L"extendedAttributes",        DRIVES_FS_SUPPORTS_EXTENDED_ATTRIBUTES },
+    { L"supportsOpenByFileId",      DRIVES_FS_SUPPORTS_OPEN_BY_FILE_ID },
+    { L"supportsUSNJournal",        DRIVES_FS_SUPPORTS_USN_JOURNAL },
+    { L"supportsIntegrityStreams",  DRIVES_FS_SUPPORTS_INTEGRITY_STREAMS },
+    { L"supportsBlockRefcounting",  DRIVES_FS_SUPPORTS_BLOCK_REFCOUNTING },
+    { L"supportsSparseVDL",         DRIVES_FS_SUPPORTS_SPARSE_VDL },
+    { L"DAXvolume",                 DRIVES_FS_DAX_VOLUME },
+    { L"supportsGhosting",          DRIVES_FS_SUPPORTS_GHOSTING },
+};
+
+//======================================================================================================================
+
+class MetricsBuffer {
+    // Accumulates Prometheus text exposition output (UTF-8) in a single buffer. The buffer is sized
+    // up front and reused from one render to the next, so appending metrics does not allocate.
+
+    string text;
+
+  public:
+
+    MetricsBuffer (size_t capacity) { text.reserve(capacity); }
+
+    void Clear() { text.clear(); }  // Keeps the buffer capacity.
+    void Reserve(size_t capacity) { text.reserve(capacity); }
+    const string& Text() const { return text; }
+
+    MetricsBuffer& Append (const char* source) {
+        text.append(source);
+        return *this;
+    }
+
+    MetricsBuffer& Integer (int64_t value) {
+        char digits[24];
+        text.append(digits, snprintf(digits, sizeof digits, "%lld", static_cast<long long>(value)));
+        return *this;
+    }
+
+    MetricsBuffer& Real (double value) {
+        char digits[32];
+        text.append(digits, snprintf(digits, sizeof digits, "%.6g", value));
+        return *this;
+    }
+
+    MetricsBuffer& LabelValue (const wchar_t* source) {
+        // Append a label value, encoded as UTF-8 with backslashes, double quotes and newlines escaped.
+
+        for (auto p = source;  *p; ) {
+            if (*p == L'\\' || *p == L'"') {
+                text += '\\';
+                text += static_cast<char>(*p++);
+            } else if (*p == L'\n') {
+                text += "\\n";
+                ++p;
+            } else {
+                AppendUTF8(text, p);
+            }
+        }
+
+        return *this;
+    }
+};
+
+enum class PrometheusMetric { Info, SizeBytes, FreeBytes, FreePercent, FileSystemFlag };
+
+// Prometheus metric families, in output order. All are gauges.
+const struct {
+    PrometheusMetric metric;
+    const char*      name;
+    const char*      help;
+} prometheusFamilies[] = {
+    { PrometheusMetric::Info,           "drives_volume_info",
+      "Volume identity. Always 1." },
+    { PrometheusMetric::SizeBytes,      "drives_volume_size_bytes",
+      "Total volume capacity in bytes." },
+    { PrometheusMetric::FreeBytes,      "drives_volume_free_bytes",
+      "Free volume space in bytes available to the caller." },
+    { PrometheusMetric::FreePercent,    "drives_volume_free_percent",
+      "Free volume space as a percentage of capacity." },
+    { PrometheusMetric::FileSystemFlag, "drives_volume_filesystem_flag",
+      "File-system flags reported by GetVolumeInformationW(), 1 if set." },
+};
+
+//======================================================================================================================
+
+// The libdrives field groups (DRIVES_FIELD_*), in bit order, with their names in JSON output.
+const struct {
+    uint32_t       field;
+    const wchar_t* name;
+} volumeFields[] = {
+    { DRIVES_FIELD_TYPE,        L"type" },
+    { DRIVES_FIELD_VOLUME_ID,   L"volumeId" },
+    { DRIVES_FIELD_MAPPING,     L"mapping" },
+    { DRIVES_FIELD_VOLUME_INFO, L"volumeInfo" },
+    { DRIVES_FIELD_CAPACITY,    L"capacity" },
+};
+
+const size_t volumeFieldCount = size(volumeFields);
+
+//======================================================================================================================
+
+// Volume fields that threshold rules (--check) can test. Text fields come first.
+enum class CheckField {
+    MountPoint, DriveType, FileSystem, Label, VolumeId, NetworkMapping,
+    PercentFree, FreeBytes, CapacityBytes,
+};
+
+const size_t checkFieldCount     = static_cast<size_t>(CheckField::CapacityBytes) + 1;
+const size_t checkTextFieldCount = static_cast<size_t>(CheckField::PercentFree);
+
+// Rule file names of each field, with their JSON output names first.
+const struct {
+    CheckField     field;
+    const wchar_t* name;
+} checkFieldNames[] = {
+    { CheckField::MountPoint,     L"mountPoint" },
+    { CheckField::DriveType,      L"driveType" },
+    { CheckField::FileSystem,     L"fileSystem" },
+    { CheckField::Label,          L"label" },
+    { CheckField::VolumeId,       L"volumeId" },
+    { CheckField::NetworkMapping, L"networkMapping" },
+    { CheckField::PercentFree,    L"percentFree" },
+    { CheckField::FreeBytes,      L"freeBytes" },
+    { CheckField::CapacityBytes,  L"capacityBytes" },
+    { CheckField::DriveType,      L"type" },
+    { CheckField::FileSystem,     L"fs" },
+};
+
+//======================================================================================================================
+
+class DriveInfo {
+  private:
+
+    // Strings are held inline, so that collecting and printing drives does not allocate.
+
+    wchar_t          driveLetter {0};  // Assigned drive letter ['A' .. 'Z'], or 0 if none
+    VolumeString     rootPath;         // Volume root path (for example, 'X:\' or '/home')
+    VolumeString     driveName;        // Drive string with no trailing slash ('X:'), else the root path
+    InlineString<16> driveType;        // Type of drive volume
+
+    VolumeString volumeId;      // Unique volume ID (Windows volume GUID or Linux file system UUID)
+    VolumeString netMap;        // If applicable, the network map associated with the drive
+    VolumeString subst;         // Subst redirection (or, on Linux, bind mount source directory)
+
+    // Drive Capacity and Use
+    uint32_t sectorsPerCluster {0};
+    uint32_t bytesPerSector {0};
+    uint64_t clustersFree {0};
+    uint64_t clustersTotal {0};
+    int64_t  bytesTotal {0};
+    int64_t  bytesFree {0};
+    double   percentFree {0};
+
+    // Volume Information
+    bool         isVolInfoValid {false};  // True if we got the drive volume information.
+    VolumeString volumeLabel;             // Drive label
+    uint32_t     serialNumber {0};        // Volume serial number
+    uint32_t     maxComponentLength {0};  // Maximum length for volume path components
+    uint32_t     fileSysFlags {0};        // Flags for volume file system (DRIVES_FS_*)
+    VolumeString fileSysName;             // Name of volume file system
+
+    // Page Cache Residency (with --cached)
+    bool    hasCacheInfo {false};   // True if the volume's files were scanned for cached pages
+    int64_t bytesCached {0};        // Bytes of the volume's files in the page cache
+    int64_t bytesInFiles {0};       // Total size of the volume's files
+
+    // Fragmentation (with --frag)
+    bool    hasFragInfo {false};    // True if the volume's files were scanned for extents
+    int64_t filesWithData {0};      // Files with at least one extent
+    int64_t filesFragmented {0};    // Files with more than one extent
+    int64_t fileExtents {0};        // Extents of all files
+
+    // Field Ages (with --refresh-loop)
+    bool    hasFieldAges {false};            // True if the drive came from the refresh cache
+    int64_t fieldAgeMs[volumeFieldCount] {}; // Age of each volumeFields group, or -1 if never probed
+
+    // This class contains the information for a single drive, as reported by libdrives.
+
+  public:
+
+    DriveInfo (const DrivesVolume& volume) {
+        driveLetter = volume.driveLetter;
+        rootPath    = volume.root;
+        driveType   = drives_type_name(volume.type);
+
+        volumeId = volume.volumeId;
+        netMap   = volume.networkMapping;
+        subst    = volume.substituteFor;
+
+        sectorsPerCluster = volume.sectorsPerCluster;
+        bytesPerSector    = volume.bytesPerSector;
+        clustersFree      = volume.clustersFree;
+        clustersTotal     = volume.clustersTotal;
+        bytesTotal        = volume.bytesTotal;
+        bytesFree         = volume.bytesFree;
+
+        isVolInfoValid     = volume.volumeInfoValid != 0;
+        volumeLabel        = volume.label;
+        serialNumber       = volume.serialNumber;
+        maxComponentLength = volume.maxComponentLength;
+        fileSysFlags       = volume.fileSystemFlags;
+        fileSysName        = volume.fileSystem;
+
+        SetDerivedFields();
+    }
+
+    DriveInfo () {
+        // Creates an empty drive, to be filled in with FromRecord().
+    }
+
+    ~DriveInfo() {}
+
+    void SetFieldAges (const int64_t (&ages)[volumeFieldCount]) {
+        // Record the age in milliseconds of each field group (see volumeFields), or -1 where the group
+        // has never been probed.
+
+        hasFieldAges = true;
+        copy(begin(ages), end(ages), fieldAgeMs);
+    }
+
+    void SetCacheResidency (int64_t cached, int64_t inFiles) {
+        // Record how much of the volume's file data is in the page cache.
+
+        hasCacheInfo = true;
+        bytesCached  = cached;
+        bytesInFiles = inFiles;
+    }
+
+    void SetFragmentation (int64_t files, int64_t fragmented, int64_t extents) {
+        // Record the extent counts of the volume's files.
+
+        hasFragInfo     = true;
+        filesWithData   = files;
+        filesFragmented = fragmented;
+        fileExtents     = extents;
+    }
+
+    double FragmentationPercent () const {
+        // Returns the fragmentation factor: the share of the files' extents beyond the one extent
+        // per file of an unfragmented volume.
+        return Percent(fileExtents - filesWithData, fileExtents);
+    }
+
+    const wchar_t* RootPath () const { return rootPath.c_str(); }
+    const wchar_t* VolumeId () const { return volumeId.c_str(); }
+    bool           HasCapacity () const { return clustersTotal > 0; }
+    int64_t        BytesTotal () const { return bytesTotal; }
+    int64_t        BytesFree () const { return bytesFree; }
+
+    const wchar_t* CheckText (CheckField field) const {
+        // Returns the value of a text field for threshold rules (see CheckRules).
+
+        switch (field) {
+            case CheckField::MountPoint:     return rootPath.c_str();
+            case CheckField::DriveType:      return driveType.c_str();
+            case CheckField::FileSystem:     return fileSysName.c_str();
+            case CheckField::Label:          return volumeLabel.c_str();
+            case CheckField::VolumeId:       return volumeId.c_str();
+            case CheckField::NetworkMapping: return netMap.c_str();
+            default:                         return L"";
+        }
+    }
+
+    double CheckNumber (CheckField field) const {
+        // Returns the value of a numeric field for threshold rules, or NaN if the volume has no
+        // capacity information (so that no comparison with it holds).
+
+        if (clustersTotal == 0)
+            return nan("");
+
+        switch (field) {
+            case CheckField::PercentFree:   return percentFree;
+            case CheckField::FreeBytes:     return static_cast<double>(bytesFree);
+            case CheckField::CapacityBytes: return static_cast<double>(bytesTotal);
+            default:                        return nan("");
+        }
+    }
+
+    bool Matches (const wstring& spec) const {
+        // Returns true if the volume specification (as given on the command line) names this drive:
+        // by drive letter ('X', 'X:' or 'X:\'), root path, or volume ID.
+
+        if (driveLetter && spec.length() <= 3 && static_cast<wchar_t>(towupper(spec[0])) == driveLetter)
+            return 0 == wcsncmp(spec.c_str() + 1, rootPath.c_str() + 1, spec.length() - 1);
+
+        return rootPath == spec.c_str() || driveName == spec.c_str()
+            || (!volumeId.empty() && volumeId == spec.c_str());
+    }
+
+    wstring Record() const {
+        // Returns this drive's information as a single line of tab-separated fields, used by the
+        // fleet agent protocol. FromRecord() reverses this.
+
+        wostringstream record;
+
+        record << (driveLetter ? wstring{driveLetter} : wstring{})
+               << L'\t' << RecordEscape(rootPath.c_str())
+               << L'\t' << RecordEscape(driveType.c_str())
+               << L'\t' << RecordEscape(volumeId.c_str())
+               << L'\t' << RecordEscape(subst.c_str())
+               << L'\t' << RecordEscape(netMap.c_str())
+               << L'\t' << (isVolInfoValid ? 1 : 0)
+               << L'\t' << RecordEscape(volumeLabel.c_str())
+               << L'\t' << serialNumber
+               << L'\t' << maxComponentLength
+               << L'\t' << fileSysFlags
+               << L'\t' << RecordEscape(fileSysName.c_str())
+               << L'\t' << sectorsPerCluster
+               << L'\t' << bytesPerSector
+               << L'\t' << clustersFree
+               << L'\t' << clustersTotal
+               << L'\t' << bytesTotal
+               << L'\t' << bytesFree;
+
+        return record.str();
+    }
+
+    bool FromRecord (const wstring& record) {
+        // Fills in this drive's information from a record produced by Record(). Returns false if
+        // the record is malformed.
+
+        const auto fields = RecordFields(record);
+
+        if (fields.size() != 18 || fields[0].length() > 1 || fields[1].empty())
+            return false;
+
+        if (!fields[0].empty() && (fields[0][0] < L'A' || L'Z' < fields[0][0]))
+            return false;
+
+        driveLetter = fields[0].empty() ? 0 : fields[0][0];
+        rootPath    = fields[1];
+        driveType   = fields[2];
+
+        volumeId = fields[3];
+        subst    = fields[4];
+        netMap   = fields[5];
+
+        isVolInfoValid     = (fields[6] == L"1");
+        volumeLabel        = fields[7];
+        serialNumber       = wcstoul(fields[8].c_str(), nullptr, 10);
+        maxComponentLength = wcstoul(fields[9].c_str(), nullptr, 10);
+        fileSysFlags       = wcstoul(fields[10].c_str(), nullptr, 10);
+        fileSysName        = fields[11];
+
+        sectorsPerCluster = wcstoul(fields[12].c_str(), nullptr, 10);
+        bytesPerSector    = wcstoul(fields[13].c_str(), nullptr, 10);
+        clustersFree      = wcstoull(fields[14].c_str(), nullptr, 10);
+        clustersTotal     = wcstoull(fields[15].c_str(), nullptr, 10);
+        bytesTotal        = wcstoll(fields[16].c_str(), nullptr, 10);
+        bytesFree         = wcstoll(fields[17].c_str(), nullptr, 10);
+
+        SetDerivedFields();
+        return true;
+    }
+
+    size_t WidthDriveName(size_t currentWidth) const {
+        return max(driveName.length(), currentWidth);
+    }
+
+    size_t WidthVolumeLabel(size_t currentWidth) const {
+        return max(volumeLabel.length(), currentWidth);
+    }
+
+    size_t WidthDriveType(size_t currentWidth) const {
+        return max(driveType.length(), currentWidth);
+    }
+
+    size_t WidthFileSysName(size_t currentWidth) const {
+        return max(fileSysName.length(), currentWidth);
+    }
+
+    void PrintVolumeInformation (
+        const CommandOptions& options, size_t widthDriveName, size_t widthVolumeLabel, size_t widthDriveType,
+        size_t widthFileSysName
+    ) const {
+        // Prints human-readable volume information for this drive.
+
+        PrintVolumeColumns(widthDriveName, widthVolumeLabel, widthDriveType, widthFileSysName);
+
+        // Drive Substitution or Network Mapping
+
+        if (subst.length()) // Drive substitution, if any.
+            wcout << L"  === " << subst;
+        else if (netMap.length()) // Mapping, if any.
+            wcout << L"  --> " << netMap;
+        else if (volumeId.length() > 0)
+            wcout << L"  " << volumeId;
+
+        // Page Cache Residency
+
+        if (hasCacheInfo) {
+            wcout << L"\n   " << numberPretty(bytesCached) << L" (";
+            PrintPercent(Percent(bytesCached, bytesInFiles));
+            wcout << L"%) cached / " << numberPretty(bytesInFiles) << L" in files";
+        }
+
+        // Fragmentation
+
+        if (hasFragInfo) {
+            wcout << L"\n   " << filesWithData << L" files, " << filesFragmented << L" (";
+            PrintPercent(Percent(filesFragmented, filesWithData));
+            wcout << L"%) fragmented, " << fileExtents << L" extents, fragmentation ";
+            PrintPercent(FragmentationPercent());
+            wcout << L'%';
+        }
+
+        // Verbose Information
+
+        if (options.printVerbose) {
+            wcout << L"\n   " << numberPretty(bytesFree) << L" (";
+            PrintPercent(percentFree);
+            wcout << L"%) free / " << numberPretty(bytesTotal);
+
+            const auto capacityAge = fieldAgeMs[volumeFieldCount - 1];
+            if (hasFieldAges && capacityAge >= 0)
+                wcout << L"  (" << capacityAge << L" ms old)";
+
+            wcout << '\n';
+        }
+
+        wcout << '\n';
+    }
+
+    static double Percent (int64_t part, int64_t whole) {
+        // Returns the part as a percentage of the whole, or zero if the whole is zero.
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    }
+
+    static void PrintPercent (double percent) {
+        // Prints a percentage for human-readable output, to four significant digits.
+
+        if (percent > 99.99)
+            wcout << L"100.0";
+        else {
+            auto priorPrecision = wcout.precision();
+            wcout << defaultfloat << setprecision(4) << percent << setprecision(priorPrecision);
+        }
+    }
+
+    void PrintVolumeColumns (
+        size_t widthDriveName, size_t widthVolumeLabel, size_t widthDriveType, size_t widthFileSysName
+    ) const {
+        // Prints the fixed-width columns of the human-readable volume information: drive, label, serial
+        // number, type and file system.
+
+        // Drive Letter (or Root Path)
+
+        wcout << driveName << L' ';
+        if (driveName.length() < widthDriveName)
+            wcout << Padding{widthDriveName - driveName.length()};
+
+        // Volume Label
+
+        if (volumeLabel.empty())
+            wcout << L"- ";
+        else
+            wcout << '"' << volumeLabel << '"';
+
+        if (volumeLabel.length() < widthVolumeLabel)
+            wcout << Padding{widthVolumeLabel - volumeLabel.length()};
+
+        // Volume Serial Number
+
+        if (!isVolInfoValid)
+            wcout << L" -        ";
+        else {
+            wcout << L' ';
+            wcout << hex;
+            wcout << setw(4) << setfill(L'0') << (serialNumber >> 16);
+            wcout << L'-';
+            wcout << setw(4) << setfill(L'0') << (serialNumber & 0xffff);
+            wcout << dec;
+        }
+
+        // Drive Type
+
+        wcout << L"  " << driveType << L' ';
+        if (driveType.length() < widthDriveType)
+            wcout << Padding{widthDriveType - driveType.length()};
+
+        // File System Type
+
+        if (!isVolInfoValid)
+            wcout << L" -";
+        else
+            wcout << ' ' << fileSysName << ' ';
+
+        if (fileSysName.length() < widthFileSysName)
+            wcout << Padding{widthFileSysName - fileSysName.length()};
+    }
+
+    void PrintJSONVolumeInformation (
+        bool first, const wchar_t* keyName = nullptr, const wchar_t* keyValue = nullptr
+    ) const {
+        // Prints volume information in JSON format. If given, the key field (for example, the host)
+        // is included as the first field.
+
+        if (!first)
+            wcout << L",\n";
+
+        wcout << L"  {\n";
+
+        if (keyName)
+            wcout << L"    \"" << keyName << L"\": \"" << Escape(keyValue) << L"\",\n";
+
+        PrintJSONVolumeFields();
+
+        wcout << L"\n  }";
+    }
+
+    void PrintJSONVolumeFields () const {
+        // Prints the fields of the volume's JSON object, with no trailing comma or newline, so that
+        // callers may add fields of their own.
+
+        if (driveLetter)
+            wcout << L"    \"driveLetter\": \"" << driveLetter << L"\",\n";
+        else {
+            wcout << L"    \"driveLetter\": null,\n";
+            wcout << L"    \"mountPoint\": \"" << Escape(rootPath.c_str()) << L"\",\n";
+        }
+
+        // Volume names take the platform's form: Linux volumes (with root paths like "/home") are
+        // named by UUID link, and Windows volumes by GUID.
+
+        if (volumeId.empty())
+            wcout << L"    \"volumeName\": null,\n";
+        else if (rootPath[0] == L'/')
+            wcout << L"    \"volumeName\": \"/dev/disk/by-uuid/" << Escape(volumeId.c_str()) << L"\",\n";
+        else
+            wcout << L"    \"volumeName\": \"\\\\\\\\?\\\\Volume{" << Escape(volumeId.c_str()) << L"}\\\\\",\n";
+
+        wcout << L"    \"driveType\": \"" << Escape(driveType.c_str()) << L"\",\n";
+
+        wcout << L"    \"substituteFor\": ";
+        if (!subst.length())
+            wcout << L"null,\n";
+        else
+            wcout << L"\"" << Escape(subst.c_str()) << L"\",\n";
+
+        wcout << L"    \"networkMapping\": ";
+        if (!netMap.length())
+            wcout << L"null,\n";
+        else
+            wcout << L"\"" << Escape(netMap.c_str()) << L"\",\n";
+
+        if (!isVolInfoValid) {
+            wcout << L"    \"serialNumber\": null,\n";
+            wcout << L"    \"label\": null,\n";
+            wcout << L"    \"maxComponentLength\": null,\n";
+            wcout << L"    \"fileSystem\": null,\n";
+            wcout << L"    \"fileSystemFlagsValue\": 0,\n";
+            wcout << L"    \"fileSystemFlags\": null";
+        } else {
+            wcout << L"    \"serialNumber\": \"" << hex << setw(4) << setfill(L'0')
+                  << (serialNumber >> 16) << L'-' << setw(4) << (serialNumber & 0xffff)
+                  << dec << L"\",\n";
+            wcout << L"    \"label\": \"" << Escape(volumeLabel.c_str()) << L"\",\n";
+            wcout << L"    \"maxComponentLength\": " << maxComponentLength << L",\n";
+            wcout << L"    \"fileSystem\": \"" << Escape(fileSysName.c_str()) << L"\",\n";
+            wcout << L"    \"fileSystemFlagsValue\": \"0x"
+                <<hex <<setw(8) <<setfill(L'0') << fileSysFlags <<dec <<L"\",\n";
+
+            wcout << L"    \"fileSystemFlags\": {\n";
+
+            bool first = true;
+            for (auto sysFlag : sysFlagBits) {
+                if (!first) wcout << L",\n";
+                wcout << L"      \"" << sysFlag.name << L"\": " << (fileSysFlags & sysFlag.value ? 1 : 0);
+                first = false;
+            }
+
+            wcout << L"\n    }";
+        }
+
+        // Drive Capacity and Usage
+        if (clustersTotal > 0) {
+            wcout << L",\n";
+            wcout << L"    \"capacityBytes\": " << bytesTotal << L",\n";
+            wcout << L"    \"capacityPretty\": \"" << numberPretty(bytesTotal) << L"\",\n";
+            wcout << L"    \"freeBytes\": " << bytesFree << L",\n";
+            wcout << L"    \"freePretty\": \"" << numberPretty(bytesFree) << L"\",\n";
+            wcout << L"    \"percentFree\": " << percentFree;
+        }
+
+        // Page Cache Residency
+        if (hasCacheInfo) {
+            wcout << L",\n";
+            wcout << L"    \"cachedBytes\": " << bytesCached << L",\n";
+            wcout << L"    \"cachedPretty\": \"" << numberPretty(bytesCached) << L"\",\n";
+            wcout << L"    \"fileBytes\": " << bytesInFiles << L",\n";
+            wcout << L"    \"filePretty\": \"" << numberPretty(bytesInFiles) << L"\",\n";
+            wcout << L"    \"percentCached\": " << Percent(bytesCached, bytesInFiles);
+        }
+
+        // Fragmentation
+        if (hasFragInfo) {
+            wcout << L",\n";
+            wcout << L"    \"filesWithData\": " << filesWithData << L",\n";
+            wcout << L"    \"fragmentedFiles\": " << filesFragmented << L",\n";
+            wcout << L"    \"extents\": " << fileExtents << L",\n";
+            wcout << L"    \"extentsPerFile\": "
+                  << (filesWithData ? static_cast<double>(fileExtents) / static_cast<double>(filesWithData) : 0.0)
+                  << L",\n";
+            wcout << L"    \"percentFragmentation\": " << FragmentationPercent();
+        }
+
+        // Field Ages
+        if (hasFieldAges) {
+            wcout << L",\n    \"ageMs\": {";
+            for (size_t i = 0;  i < volumeFieldCount;  ++i) {
+                wcout << (i ? L", \"" : L" \"") << volumeFields[i].name << L"\": ";
+                if (fieldAgeMs[i] < 0)
+                    wcout << L"null";
+                else
+                    wcout << fieldAgeMs[i];
+            }
+            wcout << L" }";
+        }
+    }
+
+    void PrintPrometheusMetric (MetricsBuffer& out, PrometheusMetric metric, const char* name, const wstring* host)
+    const {
+        // Appends this drive's samples for the given metric family in Prometheus text format. Drives
+        // lacking the underlying information produce no samples. If given, the host is included as the
+        // first label.
+
+        switch (metric) {
+            case PrometheusMetric::Info: {
+                wchar_t serial[] = L"0000-0000";
+                if (isVolInfoValid)
+                    swprintf(serial, size(serial), L"%04x-%04x", serialNumber >> 16, serialNumber & 0xffff);
+
+                PrintPrometheusLabels(out, name, host);
+                out.Append(",volume=\"").LabelValue(volumeId.c_str())
+                   .Append("\",label=\"").LabelValue(volumeLabel.c_str())
+                   .Append("\",serial=\"").LabelValue(isVolInfoValid ? serial : L"")
+                   .Append("\",type=\"").LabelValue(driveType.c_str())
+                   .Append("\",fs=\"").LabelValue(fileSysName.c_str())
+                   .Append("\",substitute=\"").LabelValue(subst.c_str())
+                   .Append("\",network=\"").LabelValue(netMap.c_str())
+                   .Append("\"} 1\n");
+                break;
+            }
+
+            case PrometheusMetric::SizeBytes:
+                if (clustersTotal > 0) {
+                    PrintPrometheusLabels(out, name, host);
+                    out.Append("} ").Integer(bytesTotal).Append("\n");
+                }
+                break;
+
+            case PrometheusMetric::FreeBytes:
+                if (clustersTotal > 0) {
+                    PrintPrometheusLabels(out, name, host);
+                    out.Append("} ").Integer(bytesFree).Append("\n");
+                }
+                break;
+
+            case PrometheusMetric::FreePercent:
+                if (clustersTotal > 0) {
+                    PrintPrometheusLabels(out, name, host);
+                    out.Append("} ").Real(percentFree).Append("\n");
+                }
+                break;
+
+            case PrometheusMetric::FileSystemFlag:
+                if (isVolInfoValid) {
+                    for (auto sysFlag : sysFlagBits) {
+                        PrintPrometheusLabels(out, name, host);
+                        out.Append(",flag=\"").LabelValue(sysFlag.name)
+                           .Append(fileSysFlags & sysFlag.value ? "\"} 1\n" : "\"} 0\n");
+                    }
+                }
+                break;
+        }
+    }
+
+  private:
+
+    void SetDerivedFields() {
+        // Set the fields derived from the volume information.
+
+        const wchar_t letterName[] = { driveLetter, L':', 0 };
+        driveName = driveLetter ? letterName : rootPath.c_str();
+        percentFree = 100.0 * static_cast<double>(bytesFree) / static_cast<double>(bytesTotal);
+    }
+
+    void PrintPrometheusLabels (MetricsBuffer& out, const char* name, const wstring* host) const {
+        // Appends the metric name and the labels common to all samples, leaving the label set open.
+
+        out.Append(name).Append("{");
+        if (host)
+            out.Append("host=\"").LabelValue(host->c_str()).Append("\",");
+        out.Append("drive=\"").LabelValue(driveName.c_str()).Append("\"");
+    }
+};
+
+//======================================================================================================================
+
+using DriveRow = pair<const wstring*, const DriveInfo*>;  // A drive and its host (null if local)
+
+void PrintResultsHuman (const CommandOptions& options, vector<DriveInfo>& drives);
+void PrintResultsJSON (const vector<DriveInfo>& drives);
+void RenderPrometheus (MetricsBuffer& metrics, const vector<DriveRow>& rows);
+void PrintResultsPrometheus (const vector<DriveRow>& rows);
+
+//======================================================================================================================
+
+class DriveCollector {
+    // Queries volumes through libdrives. The volume array is kept from one collection to the next,
+    // so once it (and the caller's drive list) has grown to hold all volumes, repeated collections
+    // do not allocate.
+
+    vector<DrivesVolume> volumes;
+
+  public:
+
+    DriveCollector () : volumes(26) {}
+
+    DrivesStatus Collect (vector<DriveInfo>& drives, const wstring& onlyVolume = {}) {
+        // Replace the drive list with all volumes (or only the given volume).
+
+        drives.clear();
+
+        if (!onlyVolume.empty()) {
+            const auto status = drives_query(onlyVolume.c_str(), DRIVES_FIELD_ALL, volumes.data());
+            if (status == DRIVES_OK)
+                drives.emplace_back(volumes[0]);
+            return status;
+        }
+
+        // Volumes may come and go between calls, so grow the array until it holds them all.
+
+        size_t count;
+        DrivesStatus status;
+
+        while (DRIVES_ERROR_INSUFFICIENT_BUFFER
+               == (status = drives_enumerate(DRIVES_FIELD_ALL, volumes.data(), volumes.size(), &count))) {
+            volumes.resize(count);
+        }
+
+        if (status == DRIVES_OK) {
+            for (size_t i = 0;  i < count;  ++i)
+                drives.emplace_back(volumes[i]);
+        }
+
+        return status;
+    }
+};
+
+#endif
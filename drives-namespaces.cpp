@@ -0,0 +1,285 @@
+//==================================================================================================
+//
+//  drives: Mount Namespaces
+//
+//  See drives-namespaces.h.
+//
+//==================================================================================================
+
+#include "drives-namespaces.h"
+
+size_t ParallelWorkers (size_t taskCount) {
+    // Returns the number of worker threads to run the given number of tasks: one per processor, but
+    // no more than there are tasks.
+
+    return min<size_t>(taskCount, max(1u, thread::hardware_concurrency()));
+}
+
+template <typename Task>
+void RunParallel (size_t taskCount, Task task) {
+    // Run task(index, worker) for each index in [0, taskCount) on ParallelWorkers() threads. Each
+    // worker runs its tasks one at a time, so tasks may reuse per-worker buffers.
+
+    atomic<size_t> next {0};
+    vector<thread> workers;
+
+    for (size_t worker = 0;  worker < ParallelWorkers(taskCount);  ++worker) {
+        workers.emplace_back([&, worker] {
+            for (size_t index;  (index = next++) < taskCount; )
+                task(index, worker);
+        });
+    }
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+struct MountNamespace {
+    // A mount namespace, the processes in it, and the mounts they see.
+
+    ino_t                    id;          // Inode number of the namespace (/proc/<pid>/ns/mnt)
+    vector<int>              pids;        // Processes in the namespace, in ascending order
+    int                      reader {0};  // The process through which the mounts were read
+    vector<DrivesMountPoint> mounts;      // Mount table entries of the visible mounts
+};
+
+struct NamespaceView {
+    // Where a volume is seen: a namespace, and the volume's mount points there.
+
+    size_t          space;        // Index of the namespace
+    vector<wstring> mountPoints;  // In mount order
+};
+
+vector<MountNamespace> FindMountNamespaces () {
+    // Group all processes by mount namespace. The current process's namespace comes first. Processes
+    // that can't be inspected (those of other users, unless running as root) are skipped.
+
+    vector<pair<ino_t, int>> processes;   // Namespace and process ID
+
+    if (auto proc = opendir("/proc")) {
+        while (auto entry = readdir(proc)) {
+            char* end;
+            const auto pid = strtol(entry->d_name, &end, 10);
+            if (*end || pid <= 0)
+                continue;
+
+            char path[64];
+            snprintf(path, sizeof path, "/proc/%ld/ns/mnt", pid);
+
+            struct stat info;
+            if (0 == stat(path, &info))
+                processes.emplace_back(info.st_ino, static_cast<int>(pid));
+        }
+
+        closedir(proc);
+    }
+
+    sort(processes.begin(), processes.end());
+
+    vector<MountNamespace> spaces;
+    for (const auto& process : processes) {
+        if (spaces.empty() || spaces.back().id != process.first)
+            spaces.push_back(MountNamespace{process.first, {}, 0, {}});
+        spaces.back().pids.push_back(process.second);
+    }
+
+    struct stat self;
+    if (0 == stat("/proc/self/ns/mnt", &self)) {
+        stable_partition(spaces.begin(), spaces.end(),
+            [&](const MountNamespace& space) { return space.id == self.st_ino; });
+    }
+
+    return spaces;
+}
+
+void ReadNamespaceMounts (MountNamespace& space, vector<DrivesMountPoint>& buffer) {
+    // Read the visible mounts of the namespace, through the first of its processes that still exists.
+    // Where one mount hides another at the same mount point, only the later one is kept. Mount points
+    // too long to list can't be probed, and are left out.
+
+    for (const auto pid : space.pids) {
+        size_t count;
+        DrivesStatus status;
+
+        while (DRIVES_ERROR_INSUFFICIENT_BUFFER
+               == (status = drives_namespace_mount_points(pid, buffer.data(), buffer.size(), &count))) {
+            buffer.resize(count);
+        }
+
+        if (status != DRIVES_OK)
+            continue;
+
+        // Find the last mount at each mount point, and keep only those.
+
+        unordered_map<wstring_view, size_t> lastMount;
+        for (size_t i = 0;  i < count;  ++i)
+            lastMount[buffer[i].path] = i;
+
+        for (size_t i = 0;  i < count;  ++i) {
+            if (!buffer[i].truncated && lastMount[buffer[i].path] == i)
+                space.mounts.push_back(buffer[i]);
+        }
+
+        space.reader = pid;
+        return;
+    }
+}
+
+void PrintNamespacePids (const MountNamespace& space, size_t limit) {
+    // Print the namespace's process IDs, separated by commas, up to the given limit.
+
+    for (size_t i = 0;  i < space.pids.size() && i < limit;  ++i)
+        wcout << (i ? L", " : L"") << space.pids[i];
+
+    if (space.pids.size() > limit)
+        wcout << L" (+" << (space.pids.size() - limit) << L" more)";
+}
+
+int RunAllNamespaces (const CommandOptions& options) {
+    // Report the volumes of all mount namespaces, and the namespaces and processes that see each one.
+    // Returns the program exit code.
+
+    auto spaces = FindMountNamespaces();
+
+    if (spaces.empty()) {
+        wcerr << options.programName << L": ERROR: Unable to read the process list.\n";
+        return 1;
+    }
+
+    // Read the mount table of each namespace.
+
+    vector<vector<DrivesMountPoint>> buffers (ParallelWorkers(spaces.size()), vector<DrivesMountPoint>(64));
+
+    RunParallel(spaces.size(), [&](size_t index, size_t worker) {
+        ReadNamespaceMounts(spaces[index], buffers[worker]);
+    });
+
+    // Group the mounts by device. Each group is a volume, listed in the order first seen.
+
+    struct Sighting {
+        uint64_t device;
+        size_t   space;
+        size_t   mount;  // Index in the namespace's mounts
+    };
+
+    vector<Sighting> sightings;
+    for (size_t space = 0;  space < spaces.size();  ++space) {
+        for (size_t mount = 0;  mount < spaces[space].mounts.size();  ++mount)
+            sightings.push_back(Sighting{spaces[space].mounts[mount].device, space, mount});
+    }
+
+    stable_sort(sightings.begin(), sightings.end(),
+        [](const Sighting& a, const Sighting& b) { return a.device < b.device; });
+
+    vector<pair<size_t, size_t>> groups;  // Range of sightings of each volume
+    for (size_t i = 0;  i < sightings.size();  ++i) {
+        if (groups.empty() || sightings[groups.back().first].device != sightings[i].device)
+            groups.emplace_back(i, i);
+        groups.back().second = i + 1;
+    }
+
+    sort(groups.begin(), groups.end(), [&](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) {
+        const auto& sa = sightings[a.first];
+        const auto& sb = sightings[b.first];
+        return (sa.space != sb.space) ? (sa.space < sb.space) : (sa.mount < sb.mount);
+    });
+
+    // Probe each volume once, through the first namespace that can reach it, from the mount table
+    // entry already read. File systems with no storage are skipped, as by drives_enumerate().
+
+    vector<DrivesVolume> volumes (groups.size());
+    vector<char>         probed (groups.size(), 0);
+
+    RunParallel(groups.size(), [&](size_t index, size_t) {
+        for (auto i = groups[index].first;  !probed[index] && i < groups[index].second;  ++i) {
+            const auto& space = spaces[sightings[i].space];
+            const auto& mount = space.mounts[sightings[i].mount];
+
+            probed[index] = DRIVES_OK == drives_mount_point_query(
+                space.reader, &mount, DRIVES_FIELD_ALL, &volumes[index]);
+        }
+
+        probed[index] = probed[index] && volumes[index].clustersTotal > 0;
+    });
+
+    vector<pair<DriveInfo, vector<NamespaceView>>> results;
+
+    for (size_t index = 0;  index < groups.size();  ++index) {
+        if (!probed[index])
+            continue;
+
+        vector<NamespaceView> views;
+        for (auto i = groups[index].first;  i < groups[index].second;  ++i) {
+            const auto& sighting = sightings[i];
+            if (views.empty() || views.back().space != sighting.space)
+                views.push_back(NamespaceView{sighting.space, {}});
+            views.back().mountPoints.emplace_back(spaces[sighting.space].mounts[sighting.mount].path);
+        }
+
+        results.emplace_back(DriveInfo{volumes[index]}, move(views));
+    }
+
+    // Print the results.
+
+    if (options.format == OutputFormat::JSON) {
+        wcout << L"[\n";
+
+        for (size_t i = 0;  i < results.size();  ++i) {
+            wcout << (i ? L",\n" : L"") << L"  {\n";
+            results[i].first.PrintJSONVolumeFields();
+            wcout << L",\n    \"namespaces\": [";
+
+            for (size_t j = 0;  j < results[i].second.size();  ++j) {
+                const auto& view  = results[i].second[j];
+                const auto& space = spaces[view.space];
+                wcout << (j ? L",\n" : L"\n") << L"      { \"id\": " << space.id << L", \"mountPoints\": [";
+                for (size_t k = 0;  k < view.mountPoints.size();  ++k)
+                    wcout << (k ? L", \"" : L"\"") << Escape(view.mountPoints[k].c_str()) << L'"';
+                wcout << L"], \"pids\": [";
+                PrintNamespacePids(space, space.pids.size());
+                wcout << L"] }";
+            }
+
+            wcout << L"\n    ]\n  }";
+        }
+
+        wcout << L"\n]" << endl;
+        return 0;
+    }
+
+    size_t widthDriveName{0};
+    size_t widthVolumeLabel{0};
+    size_t widthDriveType{0};
+    size_t widthFileSysName{0};
+
+    for (const auto& result : results) {
+        widthDriveName   = result.first.WidthDriveName(widthDriveName);
+        widthVolumeLabel = result.first.WidthVolumeLabel(widthVolumeLabel);
+        widthDriveType   = result.first.WidthDriveType(widthDriveType);
+        widthFileSysName = result.first.WidthFileSysName(widthFileSysName);
+    }
+
+    const size_t pidLimit = options.printVerbose ? SIZE_MAX : 8;
+
+    for (const auto& result : results) {
+        result.first.PrintVolumeInformation(
+            options, widthDriveName, widthVolumeLabel, widthDriveType, widthFileSysName);
+
+        // Each namespace's first mount point is followed by its processes; any others are listed
+        // below it.
+
+        for (const auto& view : result.second) {
+            const auto& space  = spaces[view.space];
+            const auto  prefix = L"    mnt:[" + to_wstring(space.id) + L"]  ";
+
+            wcout << prefix << view.mountPoints[0] << ((space.pids.size() == 1) ? L"  pid " : L"  pids ");
+            PrintNamespacePids(space, pidLimit);
+            wcout << L'\n';
+
+            for (size_t i = 1;  i < view.mountPoints.size();  ++i)
+                wcout << Padding{prefix.length()} << view.mountPoints[i] << L'\n';
+        }
+    }
+
+    return 0;
+}
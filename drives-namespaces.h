@@ -0,0 +1,19 @@
+//==================================================================================================
+//
+//  drives: Mount Namespaces
+//
+//  On Linux, each process sees the mounts of its own mount namespace, so on a container host most
+//  volumes are invisible from drives' own namespace. With `--all-namespaces`, processes are grouped
+//  by mount namespace, the mount table of each namespace is read in parallel, and each file system
+//  (by device number) is then probed once, through a process that sees it.
+//
+//==================================================================================================
+
+#ifndef DRIVES_NAMESPACES_H
+#define DRIVES_NAMESPACES_H
+
+#include "drives-info.h"
+
+int RunAllNamespaces (const CommandOptions& options);
+
+#endif
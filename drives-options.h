@@ -0,0 +1,423 @@
+//==================================================================================================
+//
+//  drives: Command-Line Options
+//
+//  The modes of the drives tool, the options each allows, and the parsed command line.
+//
+//==================================================================================================
+
+#ifndef DRIVES_OPTIONS_H
+#define DRIVES_OPTIONS_H
+
+#include "drives-common.h"
+
+enum class OutputFormat { Human, JSON, Prometheus };
+
+// The mode of operation, chosen by at most one mode option. Without one, the volumes are reported once
+// (or with --refresh-loop, periodically).
+enum class Mode { Report, RefreshLoop, Textfile, Hosts, Agent, Which, AllNamespaces, Check, History, Cached, Frag };
+
+constexpr unsigned ModeBit (Mode mode) { return 1u << static_cast<unsigned>(mode); }
+
+// The option of each mode (in the order of the Mode values), and what the mode allows.
+const struct {
+    Mode           mode;
+    const wchar_t* option;      // Mode option, or nullptr for the default report
+    bool           volume;      // True => A volume (or with --which, paths) may be given
+    bool           prometheus;  // True => The prometheus format is supported
+    bool           linuxOnly;   // True => Only supported on Linux
+} modeInfo[] = {
+    { Mode::Report,        nullptr,             true,  true,  false },
+    { Mode::RefreshLoop,   L"--refresh-loop",   true,  true,  false },
+    { Mode::Textfile,      L"--textfile",       true,  true,  false },
+    { Mode::Hosts,         L"--hosts",          true,  true,  false },
+    { Mode::Agent,         L"--agent",          false, true,  false },
+    { Mode::Which,         L"--which",          true,  false, false },
+    { Mode::AllNamespaces, L"--all-namespaces", false, false, true  },
+    { Mode::Check,         L"--check",          true,  false, false },
+    { Mode::History,       L"--history",        true,  false, false },
+    { Mode::Cached,        L"--cached",         false, false, true  },
+    { Mode::Frag,          L"--frag",           false, false, false },
+};
+
+// Options that only some modes use, and the modes that allow them. (--refresh-loop without --textfile
+// or --agent is the refresh loop mode.)
+const struct {
+    const wchar_t* option;
+    unsigned       modes;
+} modeOnlyOptions[] = {
+    { L"--refresh-loop", ModeBit(Mode::RefreshLoop) | ModeBit(Mode::Textfile) | ModeBit(Mode::Agent) },
+    { L"--interval",     ModeBit(Mode::RefreshLoop) | ModeBit(Mode::Textfile) },
+    { L"--timeout",      ModeBit(Mode::Hosts) },
+    { L"--agent-delay",  ModeBit(Mode::Agent) },
+    { L"--record",       ModeBit(Mode::Report) | ModeBit(Mode::Check) },
+    { L"--from",         ModeBit(Mode::History) },
+    { L"--to",           ModeBit(Mode::History) },
+    { L"--depth",        ModeBit(Mode::Cached) },
+    { L"--top",          ModeBit(Mode::Frag) },
+};
+
+//======================================================================================================================
+
+class CommandOptions {
+    // This class stores and manages all command line options.
+
+  public:
+    wstring programName;           // Name of executable
+    bool    printVersion {false};  // True => Print program version
+    bool    printHelp {false};     // True => print help information
+    bool    printVerbose {false};  // True => Print verbose; include additional information
+    wstring singleVolume;          // Specified single volume (drive letter, path or ID), else empty
+
+    OutputFormat format {OutputFormat::Human};  // Output format (--format, --json)
+    Mode         mode {Mode::Report};           // Mode of operation, from the mode option given
+
+    // Prometheus Textfile Options
+    wstring textfilePath;                       // Metrics file to rewrite periodically (--textfile)
+    int     intervalSeconds {60};               // Seconds between textfile rewrites or refresh-loop reports
+
+    bool    refreshLoop {false};                // True => Answer from a background-refreshed cache
+
+    vector<wstring> whichPaths;     // Paths to resolve (--which), or empty to read them from standard input
+
+    wstring checkRulesPath;         // Threshold rules file to check volumes against (--check), else empty
+
+    // Capacity History Options
+    wstring recordPath;                         // History store to append this run's samples to (--record)
+    wstring historyPath;                        // History store to report on (--history)
+    int64_t historyFromMs {INT64_MIN};          // Start of the reported time span (--from), in ms since the epoch
+    int64_t historyToMs {INT64_MAX};            // End of the reported time span (--to)
+
+    // Page Cache Residency Options (Linux)
+    wstring cachedVolume;       // Volume to scan for page cache residency (--cached), else empty
+    int     cachedDepth {1};    // Directory levels below the volume root to report (--depth)
+
+    // Fragmentation Options
+    wstring fragVolume;         // Volume to scan for file fragmentation (--frag), else empty
+    int     fragTop {10};       // Most fragmented large files to report (--top)
+
+    // Fleet Query Options
+    wstring hosts;                          // Comma-separated hosts to query (--hosts), else empty
+    int     timeoutMs {defaultTimeoutMs};   // Per-host fleet query timeout in milliseconds
+    wstring agentAddress;                   // Agent listen address (--agent), else empty
+    int     agentDelayMs {0};               // Agent reply delay in milliseconds, to simulate slow hosts
+
+    CommandOptions() {}
+
+    static bool TakesValue (const wstring& option) {
+        // Returns true if the given double-dash option requires a value.
+        return option == L"--hosts" || option == L"--timeout" || option == L"--agent" || option == L"--agent-delay"
+            || option == L"--format" || option == L"--textfile" || option == L"--interval" || option == L"--cached"
+            || option == L"--depth" || option == L"--check" || option == L"--record" || option == L"--history"
+            || option == L"--from" || option == L"--to" || option == L"--frag" || option == L"--top";
+    }
+
+    bool parseCount (const wstring& option, const wstring& value, int& result) const {
+        // Parse a non-negative count (for example, of milliseconds) for the given option. Returns
+        // false on error.
+
+        wchar_t* end;
+        const auto parsed = wcstol(value.c_str(), &end, 10);
+
+        if (value.empty() || *end != 0 || parsed < 0) {
+            wcerr << programName << L": ERROR: Invalid value for " << option << L" (" << value << L").\n";
+            return false;
+        }
+
+        result = static_cast<int>(parsed);
+        return true;
+    }
+
+    bool parseTime (const wstring& option, const wstring& value, int64_t& result) const {
+        // Parse a time for the given option: a UTC date and time ("2026-10-01", "2026-10-01T12:00" or
+        // "2026-10-01T12:00:00"), or a duration before now ("90s", "30m", "12h", "7d" or "2w").
+        // Returns false on error.
+
+        int     year, month, day, hour = 0, minute = 0, second = 0;
+        wchar_t unit;
+        double  count;
+        int     length = 0;
+        int     timeLength = 0;
+        int     secondsLength = 0;
+
+        const auto text = value.c_str();
+
+        if (3 <= swscanf(text, L"%4d-%2d-%2d%n", &year, &month, &day, &length) && length > 0
+            && (text[length] == 0
+                || (2 <= swscanf(text + length, L"T%2d:%2d%n", &hour, &minute, &timeLength) && timeLength > 0
+                    && (text[length + timeLength] == 0
+                        || (1 <= swscanf(text + length + timeLength, L":%2d%n", &second, &secondsLength)
+                            && secondsLength > 0 && text[length + timeLength + secondsLength] == 0))))) {
+            result = ((DaysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * 60'000LL + second * 1'000LL;
+            return true;
+        }
+
+        length = 0;
+        if (2 == swscanf(text, L"%lf%lc%n", &count, &unit, &length) && length > 0 && text[length] == 0 && count >= 0) {
+            const wchar_t* const units = L"smhdw";
+            const int64_t unitMs[] = { 1'000, 60'000, 3'600'000, 86'400'000, 604'800'000 };
+            if (auto found = wcschr(units, unit)) {
+                result = NowMs() - static_cast<int64_t>(count * static_cast<double>(unitMs[found - units]));
+                return true;
+            }
+        }
+
+        wcerr << programName << L": ERROR: Invalid time for " << option << L" (" << value << L").\n";
+        return false;
+    }
+
+    bool setMode (Mode newMode) {
+        // Set the mode for its mode option. Returns false if another mode option was given.
+
+        if (mode != Mode::Report && mode != newMode) {
+            wcerr << programName << L": ERROR: Options " << modeInfo[static_cast<size_t>(mode)].option << L" and "
+                  << modeInfo[static_cast<size_t>(newMode)].option << L" may not be used together.\n";
+            return false;
+        }
+
+        mode = newMode;
+        return true;
+    }
+
+    bool checkMode (const vector<wstring>& optionsGiven, const vector<wstring>& positionals) const {
+        // Check that the mode allows the options and arguments given. Returns false on error.
+
+        const auto& info = modeInfo[static_cast<size_t>(mode)];
+
+#if defined(_WIN32)
+        if (info.linuxOnly) {
+            wcerr << programName << L": ERROR: Option " << info.option << L" is only supported on Linux.\n";
+            return false;
+        }
+#endif
+
+        if (!info.volume && !positionals.empty()) {
+            wcerr << programName << L": ERROR: A volume may not be specified with " << info.option << L".\n";
+            return false;
+        }
+
+        if (!info.prometheus && format == OutputFormat::Prometheus) {
+            wcerr << programName << L": ERROR: Option " << info.option << L" does not support the prometheus format.\n";
+            return false;
+        }
+
+        for (const auto& use : modeOnlyOptions) {
+            const bool given = optionsGiven.end() != find(optionsGiven.begin(), optionsGiven.end(), use.option);
+            if (!given || (use.modes & ModeBit(mode)))
+                continue;
+
+            wcerr << programName << L": ERROR: Option " << use.option;
+
+            if (info.option) {
+                wcerr << L" may not be used with " << info.option << L".\n";
+                return false;
+            }
+
+            // Without a mode option, list the mode options that allow it.
+
+            vector<const wchar_t*> allowing;
+            for (const auto& other : modeInfo) {
+                if (use.modes & ModeBit(other.mode))
+                    allowing.push_back(other.option);
+            }
+
+            wcerr << L" may only be used with ";
+            for (size_t i = 0;  i < allowing.size();  ++i)
+                wcerr << (i == 0 ? L"" : (i + 1 < allowing.size()) ? L", " : L" or ") << allowing[i];
+            wcerr << L".\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool parseArguments (int argCount, wchar_t* argTokens[]) {
+        // Parse the command line into the individual command options.
+
+        programName = argTokens[0];
+
+        vector<wstring> positionals;    // Non-switch arguments
+        vector<wstring> optionsGiven;   // Double-dash options
+
+        for (int argIndex = 1;  argIndex < argCount;  ++argIndex) {
+            auto token = argTokens[argIndex];
+
+            if (token[0] == L'/' && token[1] == L'?' && token[2] == 0) {
+                printHelp = true;
+                continue;
+            }
+
+            if (token[0] != L'-') {
+                // Non switches: a single volume, as a drive letter ('X' or 'X:'), a path on the
+                // volume, or a volume ID (see drives_query()). With --which, the paths to resolve.
+
+                positionals.push_back(token);
+
+            } else if (0 == wcsncmp(token, L"--", wcslen(L"--"))) {
+
+                wstring tokenString {token};
+
+                // Double-dash switches. Options with values accept both "--option=value" and
+                // "--option value" forms.
+
+                wstring optionValue;
+                const auto equalsPos = tokenString.find(L'=');
+
+                if (equalsPos != wstring::npos) {
+                    optionValue = tokenString.substr(equalsPos + 1);
+                    tokenString.erase(equalsPos);
+
+                    if (!TakesValue(tokenString)) {
+                        wcerr << programName << L": ERROR: Option " << tokenString << L" takes no value.\n";
+                        return false;
+                    }
+                } else if (TakesValue(tokenString)) {
+                    if (argIndex + 1 >= argCount) {
+                        wcerr << programName << L": ERROR: Missing value for option " << tokenString << L".\n";
+                        return false;
+                    }
+                    optionValue = argTokens[++argIndex];
+                }
+
+                optionsGiven.push_back(tokenString);
+
+                if (tokenString == L"--help")
+                    printHelp = true;
+                else if (tokenString == L"--json")
+                    format = OutputFormat::JSON;
+                else if (tokenString == L"--verbose")
+                    printVerbose = true;
+                else if (tokenString == L"--version")
+                    printVersion = true;
+                else if (tokenString == L"--refresh-loop")
+                    refreshLoop = true;
+                else if (tokenString == L"--which") {
+                    if (!setMode(Mode::Which))
+                        return false;
+                } else if (tokenString == L"--all-namespaces") {
+                    if (!setMode(Mode::AllNamespaces))
+                        return false;
+                } else if (tokenString == L"--hosts") {
+                    if (!setMode(Mode::Hosts))
+                        return false;
+                    hosts = optionValue;
+                } else if (tokenString == L"--timeout") {
+                    if (!parseCount(tokenString, optionValue, timeoutMs))
+                        return false;
+                } else if (tokenString == L"--agent") {
+                    if (!setMode(Mode::Agent))
+                        return false;
+                    agentAddress = optionValue;
+                } else if (tokenString == L"--agent-delay") {
+                    if (!parseCount(tokenString, optionValue, agentDelayMs))
+                        return false;
+                } else if (tokenString == L"--format") {
+                    if (optionValue == L"human")
+                        format = OutputFormat::Human;
+                    else if (optionValue == L"json")
+                        format = OutputFormat::JSON;
+                    else if (optionValue == L"prometheus")
+                        format = OutputFormat::Prometheus;
+                    else {
+                        wcerr << programName << L": ERROR: Unknown output format (" << optionValue << L").\n";
+                        return false;
+                    }
+                } else if (tokenString == L"--textfile") {
+                    if (!setMode(Mode::Textfile))
+                        return false;
+                    textfilePath = optionValue;
+                } else if (tokenString == L"--interval") {
+                    if (!parseCount(tokenString, optionValue, intervalSeconds))
+                        return false;
+                    if (intervalSeconds == 0) {
+                        wcerr << programName << L": ERROR: The --interval value must be at least one second.\n";
+                        return false;
+                    }
+                } else if (tokenString == L"--cached") {
+                    if (!setMode(Mode::Cached))
+                        return false;
+                    cachedVolume = optionValue;
+                } else if (tokenString == L"--check") {
+                    if (!setMode(Mode::Check))
+                        return false;
+                    checkRulesPath = optionValue;
+                } else if (tokenString == L"--frag") {
+                    if (!setMode(Mode::Frag))
+                        return false;
+                    fragVolume = optionValue;
+                } else if (tokenString == L"--top") {
+                    if (!parseCount(tokenString, optionValue, fragTop))
+                        return false;
+                } else if (tokenString == L"--record")
+                    recordPath = optionValue;
+                else if (tokenString == L"--history") {
+                    if (!setMode(Mode::History))
+                        return false;
+                    historyPath = optionValue;
+                } else if (tokenString == L"--from") {
+                    if (!parseTime(tokenString, optionValue, historyFromMs))
+                        return false;
+                } else if (tokenString == L"--to") {
+                    if (!parseTime(tokenString, optionValue, historyToMs))
+                        return false;
+                } else if (tokenString == L"--depth") {
+                    if (!parseCount(tokenString, optionValue, cachedDepth))
+                        return false;
+                } else {
+                    wcerr << programName << L": ERROR: Unrecognized option (" << token << L").\n";
+                    return false;
+                }
+
+            } else {
+
+                // Single letter switches
+
+                if (!token[1]) {
+                    wcerr << programName << L": ERROR: Missing option letter for '" << token[0] << L"'.\n";
+                    return false;
+                }
+                ++token;
+
+                do switch(*token) {
+                    case L'h': case L'H': case L'?':
+                        printHelp = true;
+                        break;
+
+                    case L'j': case L'J':
+                        format = OutputFormat::JSON;
+                        break;
+
+                    case L'v': case L'V':
+                        printVerbose = true;
+                        break;
+
+                    default:
+                        wcerr << programName << L": ERROR: Unrecognized option (" << *token << L").\n";
+                        return false;
+
+                } while (*++token);
+            }
+        }
+
+        printVersion = printVersion || printHelp;
+
+        if (mode == Mode::Report && refreshLoop)
+            mode = Mode::RefreshLoop;
+
+        if (!checkMode(optionsGiven, positionals))
+            return false;
+
+        if (mode == Mode::Which) {
+            whichPaths = move(positionals);
+        } else if (positionals.size() > 1) {
+            wcerr << programName << L": ERROR: Unexpected argument (" << positionals[1] << L").\n";
+            return false;
+        } else if (!positionals.empty()) {
+            singleVolume = positionals[0];
+        }
+
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,103 @@
+//==================================================================================================
+//
+//  drives: Refresh Loop
+//
+//  See drives-refresh.h.
+//
+//==================================================================================================
+
+#include "drives-refresh.h"
+
+void CopyVolumeFields (DrivesVolume& target, const DrivesVolume& source, uint32_t fields) {
+    // Copy the given field groups (DRIVES_FIELD_*) from one volume to another.
+
+    target.driveLetter = source.driveLetter;
+    memcpy(target.root, source.root, sizeof target.root);
+    target.fields |= fields;
+
+    if (fields & DRIVES_FIELD_TYPE)
+        target.type = source.type;
+
+    if (fields & DRIVES_FIELD_VOLUME_ID)
+        memcpy(target.volumeId, source.volumeId, sizeof target.volumeId);
+
+    if (fields & DRIVES_FIELD_MAPPING) {
+        memcpy(target.substituteFor,  source.substituteFor,  sizeof target.substituteFor);
+        memcpy(target.networkMapping, source.networkMapping, sizeof target.networkMapping);
+    }
+
+    if (fields & DRIVES_FIELD_VOLUME_INFO) {
+        target.volumeInfoValid    = source.volumeInfoValid;
+        target.serialNumber       = source.serialNumber;
+        target.maxComponentLength = source.maxComponentLength;
+        target.fileSystemFlags    = source.fileSystemFlags;
+        memcpy(target.label,      source.label,      sizeof target.label);
+        memcpy(target.fileSystem, source.fileSystem, sizeof target.fileSystem);
+    }
+
+    if (fields & DRIVES_FIELD_CAPACITY) {
+        target.sectorsPerCluster = source.sectorsPerCluster;
+        target.bytesPerSector    = source.bytesPerSector;
+        target.clustersFree      = source.clustersFree;
+        target.clustersTotal     = source.clustersTotal;
+        target.bytesTotal        = source.bytesTotal;
+        target.bytesFree         = source.bytesFree;
+    }
+}
+
+bool VolumeFieldsEqual (const DrivesVolume& a, const DrivesVolume& b, uint32_t fields) {
+    // Returns true if the given field groups of two volumes are equal.
+
+    if ((fields & DRIVES_FIELD_TYPE) && a.type != b.type)
+        return false;
+
+    if ((fields & DRIVES_FIELD_VOLUME_ID) && 0 != wcscmp(a.volumeId, b.volumeId))
+        return false;
+
+    if ((fields & DRIVES_FIELD_MAPPING)
+        && (0 != wcscmp(a.substituteFor, b.substituteFor) || 0 != wcscmp(a.networkMapping, b.networkMapping)))
+        return false;
+
+    if ((fields & DRIVES_FIELD_VOLUME_INFO)
+        && (a.volumeInfoValid != b.volumeInfoValid || a.serialNumber != b.serialNumber
+            || a.maxComponentLength != b.maxComponentLength || a.fileSystemFlags != b.fileSystemFlags
+            || 0 != wcscmp(a.label, b.label) || 0 != wcscmp(a.fileSystem, b.fileSystem)))
+        return false;
+
+    if ((fields & DRIVES_FIELD_CAPACITY)
+        && (a.sectorsPerCluster != b.sectorsPerCluster || a.bytesPerSector != b.bytesPerSector
+            || a.clustersFree != b.clustersFree || a.clustersTotal != b.clustersTotal
+            || a.bytesTotal != b.bytesTotal || a.bytesFree != b.bytesFree))
+        return false;
+
+    return true;
+}
+
+void RunRefreshLoop (const CommandOptions& options, VolumeCache& cache) {
+    // Print the cached volume information every interval, until terminated. The first report is
+    // printed as soon as every volume has been probed (or after one interval, if some probe is slow).
+
+    vector<DriveInfo> drives;
+    vector<DriveRow>  rows;
+
+    cache.WaitForFirstProbes(chrono::seconds(options.intervalSeconds));
+
+    while (true) {
+        cache.Snapshot(drives);
+
+        if (options.format == OutputFormat::Prometheus) {
+            rows.clear();
+            for (const auto& drive : drives)
+                rows.emplace_back(nullptr, &drive);
+            PrintResultsPrometheus(rows);
+            fflush(stdout);
+        } else if (options.format == OutputFormat::JSON) {
+            PrintResultsJSON(drives);
+        } else {
+            PrintResultsHuman(options, drives);
+            wcout << endl;
+        }
+
+        this_thread::sleep_for(chrono::seconds(options.intervalSeconds));
+    }
+}
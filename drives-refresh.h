@@ -0,0 +1,318 @@
+//==================================================================================================
+//
+//  drives: Refresh Loop
+//
+//  With `--refresh-loop`, drives keeps volume information in a cache that is refreshed in the
+//  background, and answers from the cache immediately. Each volume has its own prober thread, so
+//  slow volumes never hold up fast ones.
+//
+//  Each volume's fields are refreshed in two groups: identity (type, ID, mapping and volume
+//  information) and capacity. After every probe, a group is rescheduled from moving averages of its
+//  probe latency and of how often its probes find a change. Volatile groups are refreshed often and
+//  stable groups rarely, and slow probes take no more than a small fraction of the time.
+//
+//==================================================================================================
+
+#ifndef DRIVES_REFRESH_H
+#define DRIVES_REFRESH_H
+
+#include "drives-info.h"
+
+using Clock = chrono::steady_clock;
+
+const int    refreshMinMs         = 1'000;    // Shortest time between refreshes of a field group
+const int    refreshMaxMs         = 300'000;  // Longest time between refreshes of a field group
+const int    refreshDiscoveryMs   = 10'000;   // Time between checks for added or removed volumes
+const double refreshLatencyBudget = 20.0;     // Refresh interval is at least this multiple of probe latency
+const double refreshSmoothing     = 0.3;      // Weight of the newest sample in the moving averages
+
+// Probes a volume, as drives_query() does. The prober can be replaced to simulate volumes.
+using ProbeFunction = DrivesStatus (*)(const wchar_t* volume, uint32_t fields, DrivesVolume* result);
+
+// Lists the volumes, as drives_enumerate() does. The lister can be replaced to simulate volumes.
+using EnumerateFunction = DrivesStatus (*)(uint32_t fields, DrivesVolume* volumes, size_t capacity, size_t* count);
+
+void CopyVolumeFields (DrivesVolume& target, const DrivesVolume& source, uint32_t fields);
+bool VolumeFieldsEqual (const DrivesVolume& a, const DrivesVolume& b, uint32_t fields);
+
+class VolumeCache {
+    // Volume information, refreshed in the background and read with Snapshot(). Call Start() once to
+    // begin refreshing. Destroying the cache stops its threads, after any probes in progress.
+
+    struct FieldGroup {
+        uint32_t          fields;
+        double            latencyMs {0};   // Moving average of probe latency
+        double            changeRate {1};  // Moving average of probes that found a change, 0 to 1
+        bool              probed {false};  // True once a probe of the group has succeeded
+        Clock::time_point updated;         // Time of the last successful probe
+        Clock::time_point due;             // Time of the next probe
+
+        FieldGroup (uint32_t _fields) : fields{_fields} {}
+
+        Clock::duration Interval() const {
+            // The time until the next probe: from refreshMaxMs for stable groups, down to
+            // refreshMinMs for groups that change on every probe, but never less than the latency
+            // budget.
+
+            auto intervalMs = exp(log(refreshMaxMs) + changeRate * (log(refreshMinMs) - log(refreshMaxMs)));
+            intervalMs = min<double>(refreshMaxMs, max(intervalMs, refreshLatencyBudget * latencyMs));
+            return chrono::milliseconds(static_cast<int64_t>(intervalMs));
+        }
+    };
+
+    struct Entry {
+        // A volume and its refresh state. All but the root and prober are guarded by the cache mutex.
+
+        const wstring root;
+        thread        prober;
+        bool          present {true};    // False once the volume is gone, which stops its prober
+        bool          finished {false};  // True once the prober has stopped
+        bool          attempted {false}; // True once every field group has been probed, or failed to be
+        DrivesVolume  volume;
+        FieldGroup    groups[2] {
+            DRIVES_FIELD_TYPE | DRIVES_FIELD_VOLUME_ID | DRIVES_FIELD_MAPPING | DRIVES_FIELD_VOLUME_INFO,
+            DRIVES_FIELD_CAPACITY
+        };
+
+        Entry (const DrivesVolume& _volume) : root{_volume.root}, volume(_volume) {}
+    };
+
+    const wstring             onlyVolume;  // The single volume to cache, else empty for all
+    const ProbeFunction       probe;
+    const EnumerateFunction   enumerate;
+    mutex                     entriesMutex;
+    condition_variable        wake;        // Wakes waiting threads when the volumes change, or to stop
+    condition_variable        firstProbes; // Wakes threads waiting for the first probes of the volumes
+    bool                      stopping {false};
+    bool                      discovered {false};        // True once the volume list has been read
+    DrivesStatus              listStatus {DRIVES_OK};    // Result of the latest reading of the volume list
+    vector<shared_ptr<Entry>> entries;     // In enumeration order
+    vector<shared_ptr<Entry>> retired;     // Volumes that are gone, whose probers may still be running
+    thread                    discoverer;
+
+  public:
+
+    VolumeCache (
+        const wstring& _onlyVolume, ProbeFunction _probe = drives_query, EnumerateFunction _enumerate = drives_enumerate
+    ) : onlyVolume{_onlyVolume}, probe{_probe}, enumerate{_enumerate}
+    {}
+
+    ~VolumeCache() {
+        // Stop all threads. Probes are not interrupted, so this waits for those in progress.
+
+        {
+            lock_guard<mutex> lock {entriesMutex};
+            stopping = true;
+        }
+        wake.notify_all();
+
+        if (discoverer.joinable())
+            discoverer.join();
+
+        // With the discoverer stopped, the entry lists no longer change.
+
+        for (auto list : { &entries, &retired }) {
+            for (auto& entry : *list) {
+                if (entry->prober.joinable())
+                    entry->prober.join();
+            }
+        }
+    }
+
+    void Start() {
+        // Start the thread that tracks the volume list, which in turn starts a prober per volume.
+
+        discoverer = thread([this] {
+            unique_lock<mutex> lock {entriesMutex};
+
+            while (!stopping) {
+                lock.unlock();
+                Discover();
+                lock.lock();
+                wake.wait_for(lock, chrono::milliseconds(refreshDiscoveryMs), [this] { return stopping; });
+            }
+        });
+    }
+
+    bool WaitForFirstProbes (Clock::duration timeout) {
+        // Wait until the volume list has been read and every volume in it has had its first probe, or
+        // until the timeout. Returns true if the first probes are done.
+
+        unique_lock<mutex> lock {entriesMutex};
+
+        return firstProbes.wait_for(lock, timeout, [this] {
+            return stopping || (discovered && all_of(entries.begin(), entries.end(),
+                                                     [](const shared_ptr<Entry>& entry) { return entry->attempted; }));
+        });
+    }
+
+    DrivesStatus Snapshot (vector<DriveInfo>& drives) {
+        // Replace the drive list with the cached volumes that have been probed. Returns the result of
+        // the latest reading of the volume list (DRIVES_ERROR_NOT_FOUND if the single cached volume is
+        // not present). This never waits on a probe.
+
+        drives.clear();
+
+        lock_guard<mutex> lock {entriesMutex};
+        const auto now = Clock::now();
+
+        for (const auto& entry : entries) {
+            int64_t ages[volumeFieldCount];
+            bool    probed = false;
+
+            for (size_t i = 0;  i < volumeFieldCount;  ++i) {
+                ages[i] = -1;
+                for (const auto& group : entry->groups) {
+                    if (group.probed && (group.fields & volumeFields[i].field)) {
+                        ages[i] = chrono::duration_cast<chrono::milliseconds>(now - group.updated).count();
+                        probed = true;
+                    }
+                }
+            }
+
+            if (probed) {
+                drives.emplace_back(entry->volume);
+                drives.back().SetFieldAges(ages);
+            }
+        }
+
+        return listStatus;
+    }
+
+  private:
+
+    void Discover() {
+        // Update the volume list, starting a prober for each new volume, and stopping the prober of
+        // each volume that is gone. Only root paths are queried here; probers fill in the rest.
+
+        vector<DrivesVolume> volumes(26);
+        size_t count = 0;
+        DrivesStatus status;
+
+        if (!onlyVolume.empty()) {
+            status = probe(onlyVolume.c_str(), 0, volumes.data());
+            count  = (status == DRIVES_OK) ? 1 : 0;
+        } else {
+            while (DRIVES_ERROR_INSUFFICIENT_BUFFER
+                   == (status = enumerate(0, volumes.data(), volumes.size(), &count))) {
+                volumes.resize(count);
+            }
+        }
+
+        lock_guard<mutex> lock {entriesMutex};
+
+        listStatus = status;
+        discovered = true;
+        firstProbes.notify_all();
+
+        if (status != DRIVES_OK && status != DRIVES_ERROR_NOT_FOUND)
+            return;
+
+        vector<shared_ptr<Entry>> current;
+
+        for (size_t i = 0;  i < count;  ++i) {
+            auto existing = find_if(entries.begin(), entries.end(),
+                [&](const shared_ptr<Entry>& entry) { return entry->root == volumes[i].root; });
+
+            if (existing != entries.end()) {
+                current.push_back(*existing);
+            } else {
+                current.push_back(make_shared<Entry>(volumes[i]));
+                current.back()->prober = thread(&VolumeCache::RunProber, this, current.back());
+            }
+        }
+
+        for (auto& entry : entries) {
+            if (find(current.begin(), current.end(), entry) == current.end()) {
+                entry->present = false;
+                retired.push_back(entry);
+            }
+        }
+
+        entries.swap(current);
+        wake.notify_all();
+
+        // Reclaim the probers of volumes that are gone, once they have stopped.
+
+        for (auto& entry : retired) {
+            if (entry->finished)
+                entry->prober.join();
+        }
+
+        retired.erase(remove_if(retired.begin(), retired.end(),
+                          [](const shared_ptr<Entry>& entry) { return !entry->prober.joinable(); }),
+                      retired.end());
+    }
+
+    void RunProber (shared_ptr<Entry> entry) {
+        // Probe the volume's field groups as they come due, until the volume is gone or the cache is
+        // stopped.
+
+        unique_lock<mutex> lock {entriesMutex};
+
+        while (!stopping && entry->present) {
+            uint32_t          dueFields = 0;
+            Clock::time_point wakeTime  = Clock::now() + chrono::milliseconds(refreshMaxMs);
+
+            const auto now = Clock::now();
+            for (const auto& group : entry->groups) {
+                if (group.due <= now)
+                    dueFields |= group.fields;
+                else
+                    wakeTime = min(wakeTime, group.due);
+            }
+
+            if (!dueFields) {
+                wake.wait_until(lock, wakeTime, [&] { return stopping || !entry->present; });
+                continue;
+            }
+
+            // Probe outside the lock, so a slow volume holds up no other volume, nor snapshots.
+
+            lock.unlock();
+
+            DrivesVolume result;
+            const auto start  = Clock::now();
+            const auto status = probe(entry->root.c_str(), dueFields, &result);
+            const auto end    = Clock::now();
+
+            const auto latencyMs = chrono::duration<double, milli>(end - start).count();
+
+            lock.lock();
+
+            for (auto& group : entry->groups) {
+                if (!(dueFields & group.fields))
+                    continue;
+
+                if (status == DRIVES_OK) {
+                    const bool changed = !group.probed || !VolumeFieldsEqual(entry->volume, result, group.fields);
+                    CopyVolumeFields(entry->volume, result, group.fields);
+
+                    group.changeRate = group.probed
+                        ? refreshSmoothing * (changed ? 1 : 0) + (1 - refreshSmoothing) * group.changeRate
+                        : 1;
+                    group.latencyMs = group.probed
+                        ? refreshSmoothing * latencyMs + (1 - refreshSmoothing) * group.latencyMs
+                        : latencyMs;
+                    group.probed  = true;
+                    group.updated = end;
+                } else {
+                    group.latencyMs = max(group.latencyMs, latencyMs);
+                }
+
+                group.due = end + group.Interval();
+            }
+
+            if (!entry->attempted) {
+                entry->attempted = true;
+                firstProbes.notify_all();
+            }
+        }
+
+        entry->finished = true;
+    }
+};
+
+void RunRefreshLoop (const CommandOptions& options, VolumeCache& cache);
+
+#endif
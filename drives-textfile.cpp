@@ -0,0 +1,102 @@
+//==================================================================================================
+//
+//  drives: Prometheus Textfile Collector
+//
+//  See drives-textfile.h.
+//
+//==================================================================================================
+
+#include "drives-textfile.h"
+
+bool ReplaceFileContents (const NativePath& path, const NativePath& tempPath, const string& contents) {
+    // Atomically replace the contents of the given file. The contents are first written to the
+    // temporary path, which must be in the same directory, and then renamed over the target, so
+    // readers see either the old or the new file, never a partial one. Returns false on failure.
+
+#if defined(_WIN32)
+    auto file = _wfopen(tempPath.c_str(), L"wb");
+#else
+    auto file = fopen(tempPath.c_str(), "wb");
+#endif
+
+    if (!file)
+        return false;
+
+    // Flush the data to disk before the rename, so that after a crash the file holds either the old
+    // or the new contents, and never an empty or partial file.
+
+    bool written = fwrite(contents.data(), 1, contents.length(), file) == contents.length()
+                && 0 == fflush(file);
+
+#if defined(_WIN32)
+    written = written && 0 == _commit(_fileno(file));
+#else
+    written = written && 0 == fsync(fileno(file));
+#endif
+
+    const bool closed = (0 == fclose(file));
+
+#if defined(_WIN32)
+    if (written && closed)
+        return 0 != MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+    DeleteFileW(tempPath.c_str());
+#else
+    if (written && closed)
+        return 0 == rename(tempPath.c_str(), path.c_str());
+    remove(tempPath.c_str());
+#endif
+
+    return false;
+}
+
+void RenderTextfile (MetricsBuffer& metrics, DrivesStatus status, const vector<DriveRow>& rows) {
+    // Render one textfile collector cycle: the metrics of the drives read, and drives_up, which is 0 if
+    // the volume list could not be read. A failure then shows in Prometheus, rather than as a file
+    // that no longer changes.
+
+    metrics.Clear();
+    RenderPrometheus(metrics, rows);
+
+    metrics.Append("# HELP drives_up Whether the volume list was read. 0 if it could not be.\n")
+           .Append("# TYPE drives_up gauge\n")
+           .Append(status == DRIVES_OK ? "drives_up 1\n" : "drives_up 0\n");
+}
+
+void RunTextfileCollector (const CommandOptions& options, VolumeCache* cache) {
+    // Rewrite the Prometheus textfile every interval. The temporary file ends in ".tmp", which the
+    // node_exporter textfile collector ignores since it reads only "*.prom" files. All buffers are
+    // kept across cycles, so after the first cycle, rewrites do not allocate. If given, drive
+    // information comes from the refresh cache, whose first probes are awaited (for up to one
+    // interval) so that the first file is not empty.
+
+    const auto path     = ToNativePath(options.textfilePath);
+    const auto tempPath = ToNativePath(options.textfilePath + L".tmp");
+
+    DriveCollector    collector;
+    MetricsBuffer     metrics {64 * 1024};
+    vector<DriveInfo> drives;
+    vector<DriveRow>  rows;
+
+    if (cache)
+        cache->WaitForFirstProbes(chrono::seconds(options.intervalSeconds));
+
+    while (true) {
+        const auto status = cache ? cache->Snapshot(drives) : collector.Collect(drives, options.singleVolume);
+
+        if (status == DRIVES_ERROR_NOT_FOUND)
+            wcerr << options.programName << L": No volume present at " << options.singleVolume << L".\n";
+        else if (status != DRIVES_OK)
+            wcerr << options.programName << L": ERROR: Unable to read the system volume list.\n";
+
+        rows.clear();
+        for (const auto& drive : drives)
+            rows.emplace_back(nullptr, &drive);
+
+        RenderTextfile(metrics, status, rows);
+
+        if (!ReplaceFileContents(path, tempPath, metrics.Text()))
+            wcerr << options.programName << L": ERROR: Unable to write " << options.textfilePath << L".\n";
+
+        this_thread::sleep_for(chrono::seconds(options.intervalSeconds));
+    }
+}
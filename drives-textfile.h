@@ -0,0 +1,19 @@
+//==================================================================================================
+//
+//  drives: Prometheus Textfile Collector
+//
+//  With `--textfile`, drives rewrites a metrics file for the node_exporter textfile collector (or a
+//  similar scraper) on a fixed interval, until terminated.
+//
+//==================================================================================================
+
+#ifndef DRIVES_TEXTFILE_H
+#define DRIVES_TEXTFILE_H
+
+#include "drives-refresh.h"
+
+bool ReplaceFileContents (const NativePath& path, const NativePath& tempPath, const string& contents);
+void RenderTextfile (MetricsBuffer& metrics, DrivesStatus status, const vector<DriveRow>& rows);
+void RunTextfileCollector (const CommandOptions& options, VolumeCache* cache = nullptr);
+
+#endif
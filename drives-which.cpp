@@ -0,0 +1,92 @@
+//==================================================================================================
+//
+//  drives: Path Resolution
+//
+//  See drives-which.h.
+//
+//==================================================================================================
+
+#include "drives-which.h"
+
+int ComparePathComponents (wstring_view a, wstring_view b) {
+    // Compare two path components, ignoring case on Windows.
+
+#if defined(_WIN32)
+    for (size_t i = 0;  i < a.length() && i < b.length();  ++i) {
+        const auto ca = towupper(a[i]), cb = towupper(b[i]);
+        if (ca != cb)
+            return (ca < cb) ? -1 : 1;
+    }
+    return (a.length() == b.length()) ? 0 : (a.length() < b.length()) ? -1 : 1;
+#else
+    return a.compare(b);
+#endif
+}
+
+int RunWhich (const CommandOptions& options) {
+    // Print the volume of each path given on the command line, or else read from standard input (one
+    // per line). Returns the program exit code: 1 if any path is on no volume, else 0.
+
+    PathResolver resolver;
+    if (resolver.Build() != DRIVES_OK) {
+        wcerr << options.programName << L": ERROR: Unable to read the system mount points.\n";
+        return 1;
+    }
+
+    size_t widthDriveName{0};
+    size_t widthVolumeLabel{0};
+    size_t widthDriveType{0};
+    size_t widthFileSysName{0};
+
+    for (const auto& drive : resolver.Drives()) {
+        widthDriveName   = drive.WidthDriveName(widthDriveName);
+        widthVolumeLabel = drive.WidthVolumeLabel(widthVolumeLabel);
+        widthDriveType   = drive.WidthDriveType(widthDriveType);
+        widthFileSysName = drive.WidthFileSysName(widthFileSysName);
+    }
+
+    bool allResolved = true;
+    bool first       = true;
+
+    auto report = [&](const wstring& path) {
+        const auto drive = resolver.Resolve(path);
+        allResolved = allResolved && drive;
+
+        if (options.format == OutputFormat::JSON) {
+            if (drive) {
+                drive->PrintJSONVolumeInformation(first, L"path", path.c_str());
+            } else {
+                wcout << (first ? L"" : L",\n") << L"  {\n    \"path\": \"" << Escape(path.c_str())
+                      << L"\",\n    \"driveLetter\": null,\n    \"mountPoint\": null\n  }";
+            }
+            first = false;
+        } else {
+            if (drive)
+                drive->PrintVolumeColumns(widthDriveName, widthVolumeLabel, widthDriveType, widthFileSysName);
+            else
+                wcout << L'-' << Padding{widthDriveName + widthVolumeLabel + widthDriveType + widthFileSysName + 16};
+            wcout << L"  " << path << L'\n';
+        }
+    };
+
+    if (options.format == OutputFormat::JSON)
+        wcout << L"[\n";
+
+    if (!options.whichPaths.empty()) {
+        for (const auto& path : options.whichPaths)
+            report(path);
+    } else {
+        string line;
+        while (getline(cin, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                report(FromUTF8(line));
+        }
+    }
+
+    if (options.format == OutputFormat::JSON)
+        wcout << L"\n]" << endl;
+
+    return allResolved ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+//==================================================================================================
+//
+//  drives: Path Resolution
+//
+//  With `--which`, drives reports the volume that holds each of a list of paths. The mount points
+//  of all volumes are read once into a trie of path components, and each path is then resolved by
+//  walking the trie, with no system call per path. Paths are resolved lexically: "." and ".." are
+//  applied to the path as written, and symbolic links are not followed.
+//
+//==================================================================================================
+
+#ifndef DRIVES_WHICH_H
+#define DRIVES_WHICH_H
+
+#include "drives-info.h"
+
+int ComparePathComponents (wstring_view a, wstring_view b);
+
+class PathResolver {
+    // Resolves paths to the volumes that hold them, using a trie of the mount point path components.
+
+    struct Node {
+        vector<pair<wstring, int>> children;   // Child node indices, sorted by path component
+        int                        drive {-1}; // Index of the drive mounted here, or -1 if none
+        bool                       longMountBelow {false};  // A mount point too long to list lies below
+    };
+
+    vector<Node>      nodes;         // The trie. Node 0 is the root.
+    vector<DriveInfo> drives;        // All mounted volumes
+    wstring           currentPath;   // Current directory, for relative paths
+    vector<int>       walk;          // Nodes along the path being resolved, kept to avoid allocation
+
+  public:
+
+    DrivesStatus Build() {
+        // Read the mount points, and probe each mounted volume once.
+
+        vector<DrivesMountPoint> mounts(64);
+        size_t count;
+        DrivesStatus status;
+
+        while (DRIVES_ERROR_INSUFFICIENT_BUFFER
+               == (status = drives_mount_points(mounts.data(), mounts.size(), &count))) {
+            mounts.resize(count);
+        }
+
+        if (status != DRIVES_OK)
+            return status;
+
+        nodes.assign(1, Node{});
+        drives.clear();
+
+        // Place every mount point in the trie first, so that mounts hidden by a later mount at the
+        // same mount point are never probed.
+
+        vector<int> mountNodes(count, -1);  // Trie node of each mount, or -1 if it is not in the trie
+
+        for (size_t i = 0;  i < count;  ++i) {
+            const auto& mount = mounts[i];
+
+            // The path of a truncated mount point is only a prefix of the real one. Rather than
+            // attribute the paths below it to the wrong volume, leave those paths unresolved.
+
+            if (mount.truncated) {
+                wstring_view prefix {mount.path};
+                const auto lastSeparator = prefix.find_last_of(L"/\\");
+                nodes[Insert(prefix.substr(0, (lastSeparator == wstring_view::npos) ? 0 : lastSeparator))]
+                    .longMountBelow = true;
+                continue;
+            }
+
+            mountNodes[i] = Insert(mount.path);
+        }
+
+        vector<size_t> lastMounts(nodes.size(), count);  // Index of the last mount at each node
+        for (size_t i = 0;  i < count;  ++i) {
+            if (mountNodes[i] >= 0)
+                lastMounts[mountNodes[i]] = i;
+        }
+
+        // Probe each visible mount's volume once.
+
+        unordered_map<wstring, int> volumeDrives;  // Drive index of each volume from drives_mount_points()
+        DrivesVolume                volume;
+
+        for (size_t i = 0;  i < count;  ++i) {
+            const auto node = mountNodes[i];
+            if (node < 0 || lastMounts[node] != i)
+                continue;
+
+            const auto& mount = mounts[i];
+            auto drive = volumeDrives.find(mount.volume);
+
+            if (drive == volumeDrives.end()) {
+                if (DRIVES_OK != drives_mount_point_query(0, &mount, DRIVES_FIELD_ALL, &volume))
+                    continue;
+                drive = volumeDrives.emplace(mount.volume, static_cast<int>(drives.size())).first;
+                drives.emplace_back(volume);
+            }
+
+            nodes[node].drive = drive->second;
+        }
+
+#if defined(_WIN32)
+        wchar_t current [MAX_PATH + 1];
+        if (GetCurrentDirectoryW(MAX_PATH + 1, current))
+            currentPath = current;
+#else
+        char current [PATH_MAX];
+        if (getcwd(current, sizeof current))
+            currentPath = FromUTF8(current);
+#endif
+
+        return DRIVES_OK;
+    }
+
+    const vector<DriveInfo>& Drives() const { return drives; }
+
+    const DriveInfo* Resolve (const wstring& path) {
+        // Returns the drive that holds the given path, or null if none does.
+
+        walk.assign(1, 0);
+        int offTrie = 0;  // Path components walked below the deepest trie node
+
+        auto visit = [&](wstring_view component) {
+            if (component.empty() || component == L".")
+                return;
+
+            if (component == L"..") {
+                if (offTrie > 0)
+                    --offTrie;
+                else if (walk.size() > 1)
+                    walk.pop_back();
+                return;
+            }
+
+            const auto child = offTrie ? -1 : Child(walk.back(), component);
+            if (child < 0)
+                ++offTrie;
+            else
+                walk.push_back(child);
+        };
+
+        wstring_view pathView {path};
+
+#if defined(_WIN32)
+        // Strip the "\\?\" prefix of long paths. A path with no drive letter takes that of the
+        // current directory.
+
+        if (pathView.substr(0, 4) == L"\\\\?\\")
+            pathView.remove_prefix(4);
+
+        const bool hasDrive = pathView.length() >= 2 && pathView[1] == L':';
+
+        if (!hasDrive && !pathView.empty() && IsPathSeparator(pathView[0])) {
+            if (pathView.length() > 1 && IsPathSeparator(pathView[1]))
+                return nullptr;  // A UNC path, which is on no local volume
+            VisitComponents(wstring_view{currentPath}.substr(0, 2), visit);
+        } else if (!hasDrive) {
+            VisitComponents(currentPath, visit);
+        }
+#else
+        if (pathView.empty() || !IsPathSeparator(pathView[0]))
+            VisitComponents(currentPath, visit);
+#endif
+
+        VisitComponents(pathView, visit);
+
+        if (offTrie && nodes[walk.back()].longMountBelow)
+            return nullptr;
+
+        for (auto node = walk.rbegin();  node != walk.rend();  ++node) {
+            if (nodes[*node].drive >= 0)
+                return &drives[nodes[*node].drive];
+        }
+
+        return nullptr;
+    }
+
+  private:
+
+    template <typename Visitor>
+    static void VisitComponents (wstring_view path, Visitor&& visit) {
+        // Call the visitor with each separator-delimited component of the path.
+
+        size_t start = 0;
+        for (size_t i = 0;  i <= path.length();  ++i) {
+            if (i == path.length() || IsPathSeparator(path[i])) {
+                visit(path.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+    }
+
+    int Child (int node, wstring_view component) const {
+        // Returns the index of the child node for the path component, or -1 if there is none.
+
+        const auto& children = nodes[node].children;
+        const auto found = lower_bound(children.begin(), children.end(), component,
+            [](const pair<wstring, int>& child, wstring_view key) {
+                return ComparePathComponents(child.first, key) < 0;
+            });
+
+        if (found == children.end() || ComparePathComponents(found->first, component) != 0)
+            return -1;
+
+        return found->second;
+    }
+
+    int Insert (wstring_view path) {
+        // Add the path to the trie, and return its node index.
+
+        int node = 0;
+
+        VisitComponents(path, [&](wstring_view component) {
+            if (component.empty() || component == L".")
+                return;
+
+            auto child = Child(node, component);
+            if (child < 0) {
+                child = static_cast<int>(nodes.size());
+                nodes.emplace_back();
+
+                auto& children = nodes[node].children;
+                const auto position = lower_bound(children.begin(), children.end(), component,
+                    [](const pair<wstring, int>& entry, wstring_view key) {
+                        return ComparePathComponents(entry.first, key) < 0;
+                    });
+                children.emplace(position, wstring{component}, child);
+            }
+
+            node = child;
+        });
+
+        return node;
+    }
+};
+
+int RunWhich (const CommandOptions& options);
+
+#endif
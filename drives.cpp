@@ -3,601 +3,218 @@
 //  drives
 //
 //  Command-line tool to print out volume information about all drives. See "::helpText" below for
-//  usage information.
+//  usage information. Volume information comes from libdrives (see drives.h). Each mode is in its
+//  own drives-<mode> source file; this file holds the help text and the entry point.
 //
 //==================================================================================================
 
-#include <stdlib.h>
-#include <stdio.h>
 
-#define _WIN32_WINNT 0x501   // Windows XP or Greater
-#include <windows.h>
+#include "drives-check.h"
+#include "drives-fleet.h"
+#include "drives-frag.h"
+#include "drives-history.h"
+#include "drives-refresh.h"
+#include "drives-textfile.h"
+#include "drives-which.h"
 
-#include <string>
-#include <iostream>
-#include <iomanip>
-#include <vector>
-
-using namespace std;
-
-// Program Version (using the semantic versioning scheme)
-const auto programVersion = L"drives v3.0.1 | 2022-10-31 | https://github.com/hollasch/drives";
-
-
-//======================================================================================================================
-
-class CommandOptions {
-    // This class stores and manages all command line options.
-
-  public:
-    wstring programName;           // Name of executable
-    bool    printVersion {false};  // True => Print program version
-    bool    printHelp {false};     // True => print help information
-    bool    printVerbose {false};  // True => Print verbose; include additional information
-    bool    printJSON {false};     // True => print results in JSON format
-    wchar_t singleDrive {0};       // Specified single drive ('A'-'Z'), else 0
-
-    CommandOptions() {}
-
-    bool parseArguments (int argCount, wchar_t* argTokens[]) {
-        // Parse the command line into the individual command options.
-
-        programName = argTokens[0];
-
-        for (int argIndex = 1;  argIndex < argCount;  ++argIndex) {
-            auto token = argTokens[argIndex];
-
-            if (token[0] == L'/' && token[1] == L'?' && token[2] == 0) {
-                printHelp = true;
-                continue;
-            }
-
-            if (token[0] != L'-') {
-                // Non switches
-
-                // Allowable drive formats: 'X', 'X:.*'.
-
-                const bool driveLetterInRange =  ((L'A' <= token[0]) && (token[0] <= L'Z'))
-                                              || ((L'a' <= token[0]) && (token[0] <= L'z'));
-                const bool driveStringTailValid = (token[1] == 0 || token[1] == L':');
-
-                if (driveLetterInRange && driveStringTailValid) {
-                    singleDrive = towupper(token[0]);
-                } else {
-                    wcerr << programName << L": ERROR: Unexpected argument (" << token << ").\n";
-                    return false;
-                }
-
-            } else if (0 == wcsncmp(token, L"--", wcslen(L"--"))) {
-
-                wstring tokenString {token};
-
-                // Double-dash switches
-
-                if (tokenString == L"--help")
-                    printHelp = true;
-                else if (tokenString == L"--json")
-                    printJSON = true;
-                else if (tokenString == L"--verbose")
-                    printVerbose = true;
-                else if (tokenString == L"--version")
-                    printVersion = true;
-                else {
-                    wcerr << programName << L": ERROR: Unrecognized option (" << token << L").\n";
-                    return false;
-                }
-
-            } else {
-
-                // Single letter switches
-
-                if (!token[1]) {
-                    wcerr << programName << L": ERROR: Missing option letter for '" << token[0] << L"'.\n";
-                    return false;
-                }
-                ++token;
-
-                do switch(*token) {
-                    case L'h': case L'H': case L'?':
-                        printHelp = true;
-                        break;
-
-                    case L'j': case L'J':
-                        printJSON = true;
-                        break;
-
-                    case L'v': case L'V':
-                        printVerbose = true;
-                        break;
-
-                    default:
-                        wcerr << programName << L": ERROR: Unrecognized option (" << *token << L").\n";
-                        return false;
-
-                } while (*++token);
-            }
-        }
-
-        printVersion = printVersion || printHelp;
-
-        return true;
-    }
-};
-
-//======================================================================================================================
-
-bool DriveValid (wchar_t driveLetter) {
-    static int logicalDrives = GetLogicalDrives();  // Query system logical drives.
-
-    // Returns true if the drive letter is valid.
-    return 0 != (logicalDrives & (1 << (driveLetter - L'A')));
-}
-
-//======================================================================================================================
-
-wstring Escape(const wstring& source) {
-    // Return the source string with backslashes escaped ("\" -> "\\")
-    wstring result;
-    for (auto c : source) {
-        if (c == '\\')
-            result += '\\';
-        result += c;
-    }
-    return result;
-}
-
-//======================================================================================================================
-
-wstring DriveType (UINT type) {
-    // Returns the string value for drive type values.
-
-    switch (type) {
-        case DRIVE_NO_ROOT_DIR:  return L"No root";
-        case DRIVE_REMOVABLE:    return L"Removable";
-        case DRIVE_FIXED:        return L"Fixed";
-        case DRIVE_REMOTE:       return L"Remote";
-        case DRIVE_CDROM:        return L"CD-ROM";
-        case DRIVE_RAMDISK:      return L"RAM Disk";
-    }
-
-    return L"Unknown";
-}
-
-//======================================================================================================================
-
-wstring DriveSubstitution(wchar_t driveLetter) {
-    // Returns the substitution for the given DOS drive. For example, by using the `subst` command.
-
-    WCHAR drive[] = L"_:";
-    const DWORD bufferSize = 4096;
-    WCHAR outBuffer[bufferSize];
-
-    drive[0] = driveLetter;
-
-    auto numChars = QueryDosDeviceW(drive, outBuffer, bufferSize);
-
-    // Substituted drives have a device name beginning with "\??\", followed by the full drive path.
-    // For example, if X: is a substitute for A:\users\yoda, then the device path would be
-    // "\??\A:\users\yoda".
-    if (numChars > 4 && outBuffer[0] == '\\' && outBuffer[1] == '?' && outBuffer[2] == '?' && outBuffer[3] == '\\') {
-        return {outBuffer + 4};
-    }
-
-    return {};
-}
-
-//======================================================================================================================
-
-wstring GetNetworkMap(const wstring& driveNoSlash) {
-    // Get the network-mapped connection for the specified drive, if any. The drive string should be
-    // a string consisting only of the drive letter followed by a colon.
-
-    DWORD netMapBufferSize {MAX_PATH + 1};
-    auto retry = false;    // True iff this is a retry.
-
-    vector<wchar_t> netMapBuffer(1 + netMapBufferSize);
-
-    auto result = WNetGetConnectionW (driveNoSlash.c_str(), netMapBuffer.data(), &netMapBufferSize);
-    if (result == ERROR_MORE_DATA) {
-        netMapBuffer.reserve(netMapBufferSize);
-        result = WNetGetConnectionW (driveNoSlash.c_str(), netMapBuffer.data(), &netMapBufferSize);
-    }
-
-    if (result != NO_ERROR) {
-        // For all error results, return the empty string. Possible errors include ERROR_BAD_DEVICE,
-        // ERROR_NOT_CONNECTED, ERROR_CONNECTION_UNAVAIL, ERROR_NO_NETWORK, ERROR_EXTENDED_ERROR,
-        // ERROR_NO_NET_OR_BAD_PATH.
-        return {};
-    }
-
-    return netMapBuffer.data();
-}
-
-//======================================================================================================================
-
-struct Thousands {
-    int64_t base;
-    wstring suffix;
-} thousands[] {
-    { 1'000'000'000'000'000'000, L" EB" },
-    { 1'000'000'000'000'000, L" PB" },
-    { 1'000'000'000'000, L" TB" },
-    { 1'000'000'000, L" GB" },
-    { 1'000'000, L" MB" },
-    { 1'000, L" KB" },
-};
-
-wstring numberPretty (int64_t value) {
-    // Return a pretty-printed string (with thousands suffix) of the input value.
-
-    // Handle the case of numbers less than 1,000 (including negative values).
-    if (value < 1'000)
-        return std::move(to_wstring(value) + L" B");
-
-    // Identify the proper thousands group of the value.
-    const Thousands *group = thousands;
-    while (value < group->base)
-        ++group;
-
-    // Get the significant digits of the value as a multiplier of the base (KB, MB, GB, ...).
-    auto sigDigits = static_cast<double>(value) / group->base;
-
-    wchar_t buffer[] = L"1.234";
-    swprintf(buffer, size(buffer), L"%5f", sigDigits);
-
-    return std::move(wstring{buffer} + group->suffix);
-}
-
-//======================================================================================================================
-
-class DriveInfo {
-  private:
-
-    wchar_t driveLetter;   // Assigned drive letter ['A' .. 'Z']
-    int     driveIndex;    // Logical drive index 0=A, 1=B, ..., 25=Z.
-    wstring drive;         // Drive string with trailing slash (for example, 'X:\').
-    wstring driveNoSlash;  // Drive string with no trailing slash ('X:').
-    wstring driveType;     // Type of drive volume
-
-    wstring volumeGUID;    // Unique volume GUID
-    wstring netMap;        // If applicable, the network map associated with the drive
-    wstring subst;         // Subst redirection
-
-    // Drive Capacity and Use
-    DWORD   sectorsPerCluster {0};
-    DWORD   bytesPerSector {0};
-    DWORD   clustersFree {0};
-    DWORD   clustersTotal {0};
-    int64_t bytesTotal {0};
-    int64_t bytesFree {0};
-    double  percentFree {0};
-
-    // Info from GetVolumeInformation
-    bool    isVolInfoValid {false};  // True if we got the drive volume information.
-    wstring volumeLabel;             // Drive label
-    DWORD   serialNumber {0};        // Volume serial number
-    DWORD   maxComponentLength {0};  // Maximum length for volume path components
-    DWORD   fileSysFlags {0};        // Flags for volume file system
-    wstring fileSysName;             // Name of volume file system
-
-    // This class contains the information for a single drive.
-
-  public:
-
-    DriveInfo (wchar_t _driveLetter /* in [L'A', L'Z'] */)
-      : driveLetter{_driveLetter},
-        driveIndex {_driveLetter - L'A'},
-        drive {L"_:\\"},
-        driveNoSlash {L"_:"}
-    {
-        drive[0] = driveNoSlash[0] = L'A' + driveIndex;
-
-        driveType = DriveType(GetDriveTypeW (drive.c_str()));
-
-        wchar_t nameBuffer [MAX_PATH + 1];
-        if (GetVolumeNameForVolumeMountPointW (drive.c_str(), nameBuffer, sizeof nameBuffer)) {
-            // The standard volume name is of the form "\\?\Volume{GUID}\". Extract just the GUID.
-
-            volumeGUID = nameBuffer;
-            auto guidStart = volumeGUID.find_first_of(L'{') + 1;
-            auto guidLen = volumeGUID.find_last_of(L'}') - guidStart;
-            volumeGUID = volumeGUID.substr(guidStart, guidLen);
-        }
-
-        subst = DriveSubstitution(driveLetter);
-        netMap = GetNetworkMap(driveNoSlash);
-
-        wchar_t labelBuffer   [MAX_PATH + 1];   // Buffer for volume label
-        wchar_t fileSysBuffer [MAX_PATH + 1];   // Buffer for file system name
-
-        isVolInfoValid = (0 != GetVolumeInformationW (
-            drive.c_str(), labelBuffer, sizeof labelBuffer, &serialNumber, &maxComponentLength, &fileSysFlags,
-            fileSysBuffer, MAX_PATH + 1));
-
-        if (isVolInfoValid) {
-            volumeLabel = labelBuffer;
-            fileSysName = fileSysBuffer;
-        } else {
-            volumeLabel.clear();
-            fileSysName.clear();
-            serialNumber       = 0;
-            maxComponentLength = 0;
-            fileSysFlags       = 0;
-        }
-
-        // Get drive capacity information.
-        if (GetDiskFreeSpaceW(drive.c_str(), &sectorsPerCluster, &bytesPerSector, &clustersFree, &clustersTotal)) {
-            int64_t bytesPerCluster = bytesPerSector * int64_t(sectorsPerCluster);
-            bytesTotal = bytesPerCluster * clustersTotal;
-            bytesFree  = bytesPerCluster * clustersFree;
-        }
-
-        percentFree = 100.0 * static_cast<double>(bytesFree) / static_cast<double>(bytesTotal);
-    }
-
-    ~DriveInfo() {}
-
-    size_t WidthVolumeLabel(size_t currentWidth) const {
-        return max(volumeLabel.length(), currentWidth);
-    }
-
-    size_t WidthDriveType(size_t currentWidth) const {
-        return max(driveType.length(), currentWidth);
-    }
-
-    size_t WidthFileSysName(size_t currentWidth) const {
-        return max(fileSysName.length(), currentWidth);
-    }
-
-    void PrintVolumeInformation (
-        const CommandOptions& options, size_t widthVolumeLabel, size_t widthDriveType, size_t widthFileSysName
-    ) const {
-        // Prints human-readable volume information for this drive.
-
-        // Drive Letter
-
-        wcout << driveNoSlash << L' ';
-
-        // Volume Label
-
-        if (volumeLabel.empty())
-            wcout << "- ";
-        else
-            wcout << '"' << volumeLabel << '"';
-
-        if (volumeLabel.length() < widthVolumeLabel)
-            wcout << wstring(widthVolumeLabel - volumeLabel.length(), ' ');
-
-        // Volume Serial Number
-
-        if (!isVolInfoValid)
-            wcout << L" -        ";
-        else {
-            wcout << L' ';
-            wcout << hex;
-            wcout << setw(4) << setfill(L'0') << (serialNumber >> 16);
-            wcout << L'-';
-            wcout << setw(4) << setfill(L'0') << (serialNumber & 0xffff);
-            wcout << dec;
-        }
-
-        // Drive Type
-
-        wcout << L"  " << driveType << L' ';
-        if (driveType.length() < widthDriveType)
-            wcout << wstring(widthDriveType - driveType.length(), ' ');
-
-        // File System Type
-
-        if (!isVolInfoValid)
-            wcout << " -";
-        else
-            wcout << ' ' << fileSysName << ' ';
-
-        if (fileSysName.length() < widthFileSysName)
-            wcout << wstring(widthFileSysName - fileSysName.length(), ' ');
-
-        // Drive Substitution or Network Mapping
-
-        if (subst.length()) // Drive substitution, if any.
-            wcout << L"  === " << subst;
-        else if (netMap.length()) // Mapping, if any.
-            wcout << L"  --> " << netMap;
-        else if (volumeGUID.length() > 0)
-            wcout << L"  " << volumeGUID;
-
-        // Verbose Information
-
-        if (options.printVerbose) {
-            wcout << L"\n   " << numberPretty(bytesFree) << " (";
-
-            if (percentFree > 99.99)
-                wcout << "100.0";
-            else {
-                auto priorPrecision = wcout.precision();
-                wcout << defaultfloat << setprecision(4) << percentFree << setprecision(priorPrecision);
-            }
-
-            wcout << "%) free / " << numberPretty(bytesTotal) << '\n';
-        }
-
-        wcout << '\n';
-    }
-
-    void PrintJSONVolumeInformation(bool first) const {
-        // Prints volume information in JSON format.
-
-        if (!first)
-            wcout << ",\n";
-
-        wcout << "  {\n";
-        wcout << L"    \"driveLetter\": \"" << driveLetter << "\",\n";
-
-        if (volumeGUID.length() > 0)
-            wcout << L"    \"volumeName\": \"\\\\\\\\?\\\\Volume{" << volumeGUID << "}\\\\\",\n";
-        else
-            wcout << L"    \"volumeName\": null,\n";
-
-        wcout << L"    \"driveType\": \"" << driveType << L"\",\n";
-
-        wcout << L"    \"substituteFor\": ";
-        if (!subst.length())
-            wcout << "null,\n";
-        else
-            wcout << "\"" << Escape(subst) << "\",\n";
-
-        wcout << L"    \"networkMapping\": ";
-        if (!netMap.length())
-            wcout << "null,\n";
-        else
-            wcout << "\"" << Escape(netMap) << "\",\n";
-
-        if (!isVolInfoValid) {
-            wcout << L"    \"serialNumber\": null,\n";
-            wcout << L"    \"label\": null,\n";
-            wcout << L"    \"maxComponentLength\": null,\n";
-            wcout << L"    \"fileSystem\": null,\n";
-            wcout << L"    \"fileSystemFlagsValue\": 0,\n";
-            wcout << L"    \"fileSystemFlags\": null";
-        } else {
-            wcout << L"    \"serialNumber\": \"" << hex << setw(4) << setfill(L'0')
-                  << (serialNumber >> 16) << L'-' << (serialNumber & 0xffff)
-                  << dec << L"\",\n";
-            wcout << L"    \"label\": \"" << Escape(volumeLabel) << L"\",\n";
-            wcout << L"    \"maxComponentLength\": " << maxComponentLength << ",\n";
-            wcout << L"    \"fileSystem\": \"" << fileSysName << "\",\n";
-            wcout << L"    \"fileSystemFlagsValue\": \"0x"
-                <<hex <<setw(8) <<setfill(L'0') << fileSysFlags <<dec <<"\",\n";
-
-            // These file-system flags are in increasing value order (bit place, right-to-left).
-            static const struct {
-                const wchar_t* name;
-                const long     value;
-            } sysFlagBits[] = {
-                { L"caseSensitiveSearch",       FILE_CASE_SENSITIVE_SEARCH },
-                { L"casePreservedNames",        FILE_CASE_PRESERVED_NAMES },
-                { L"unicodeOnDisk",             FILE_UNICODE_ON_DISK },
-                { L"persistentACLs",            FILE_PERSISTENT_ACLS },
-                { L"fileCompression",           FILE_FILE_COMPRESSION },
-                { L"volumeQuotas",              FILE_VOLUME_QUOTAS },
-                { L"supportsSparseFiles",       FILE_SUPPORTS_SPARSE_FILES },
-                { L"supportsReparsePoints",     FILE_SUPPORTS_REPARSE_POINTS },
-                { L"supportsRemoteStorage",     FILE_SUPPORTS_REMOTE_STORAGE },
-                { L"returnsCleanupResultInfo",  FILE_RETURNS_CLEANUP_RESULT_INFO },
-                { L"supportsPosixUnlinkRename", FILE_SUPPORTS_POSIX_UNLINK_RENAME },
-                { L"volumeIsCompressed",        FILE_VOLUME_IS_COMPRESSED },
-                { L"supportsObjectIds",         FILE_SUPPORTS_OBJECT_IDS },
-                { L"supportsEncryption",        FILE_SUPPORTS_ENCRYPTION },
-                { L"namedStreams",              FILE_NAMED_STREAMS },
-                { L"readOnlyVolume",            FILE_READ_ONLY_VOLUME },
-                { L"sequentialWriteOnce",       FILE_SEQUENTIAL_WRITE_ONCE },
-                { L"supportsTransactions",      FILE_SUPPORTS_TRANSACTIONS },
-                { L"supportsHardLinks",         FILE_SUPPORTS_HARD_LINKS },
-                { L"extendedAttributes",        FILE_SUPPORTS_EXTENDED_ATTRIBUTES },
-                { L"supportsOpenByFileId",      FILE_SUPPORTS_OPEN_BY_FILE_ID },
-                { L"supportsUSNJournal",        FILE_SUPPORTS_USN_JOURNAL },
-                { L"supportsIntegrityStreams",  FILE_SUPPORTS_INTEGRITY_STREAMS },
-                { L"supportsBlockRefcounting",  FILE_SUPPORTS_BLOCK_REFCOUNTING },
-                { L"supportsSparseVDL",         FILE_SUPPORTS_SPARSE_VDL },
-                { L"DAXvolume",                 FILE_DAX_VOLUME },
-                { L"supportsGhosting",          FILE_SUPPORTS_GHOSTING },
-            };
-
-            wcout << L"    \"fileSystemFlags\": {\n";
-
-            bool first = true;
-            for (auto sysFlag : sysFlagBits) {
-                if (!first) wcout << L",\n";
-                wcout << L"      \"" << sysFlag.name << L"\": " << (fileSysFlags & sysFlag.value ? 1 : 0);
-                first = false;
-            }
-
-            wcout << L"\n    }";
-        }
-
-        // Drive Capacity and Usage
-        if (clustersTotal > 0) {
-            wcout << L",\n";
-            wcout << L"    \"capacityBytes\": " << bytesTotal << ",\n";
-            wcout << L"    \"capacityPretty\": \"" << numberPretty(bytesTotal) << "\",\n";
-            wcout << L"    \"freeBytes\": " << bytesFree << ",\n";
-            wcout << L"    \"freePretty\": \"" << numberPretty(bytesFree) << "\",\n";
-            wcout << L"    \"percentFree\": " << percentFree;
-        }
-
-        wcout << "\n  }";
-    }
-
-};
-
-//======================================================================================================================
-
-void PrintResultsHuman(const CommandOptions& options, vector<DriveInfo>& drives) {
-    size_t widthVolumeLabel{0};
-    size_t widthDriveType{0};
-    size_t widthFileSysName{0};
-
-    for (const auto& drive : drives) {
-        widthVolumeLabel = drive.WidthVolumeLabel(widthVolumeLabel);
-        widthDriveType   = drive.WidthDriveType(widthDriveType);
-        widthFileSysName = drive.WidthFileSysName(widthFileSysName);
-    }
-
-    for (const auto& drive : drives)
-        drive.PrintVolumeInformation(options, widthVolumeLabel, widthDriveType, widthFileSysName);
-}
-
-//======================================================================================================================
-
-void PrintResultsJSON(const CommandOptions& options, vector<DriveInfo>& drives) {
-    wcout << "[\n";
-
-    bool first = true;
-    for (const auto& drive : drives) {
-        drive.PrintJSONVolumeInformation(first);
-        first = false;
-    }
-
-    wcout << "\n]" << endl;
-}
+#if !defined(_WIN32)
+    #include "drives-cached.h"
+    #include "drives-namespaces.h"
+#endif
 
 //======================================================================================================================
 
-wchar_t* helpText = LR"(
-drives: Print Windows drive and volume information
-usage : drives  [--json|-j] [--verbose|-v] [drive]
-                [--help|-h|/?] [--version]
+const wchar_t* helpText = LR"(
+drives: Print drive and volume information
+usage : drives  [--json|-j] [--format=<human|json|prometheus>] [--verbose|-v]
+                [--textfile <path>] [--interval <seconds>] [--refresh-loop]
+                [--hosts <host>[,<host>...]] [--timeout <ms>]
+                [--agent <[address:]port[-lastPort]>] [--agent-delay <ms>]
+                [--which [path...]] [--all-namespaces]
+                [--cached <volume> [--depth <levels>]] [--frag <volume> [--top <count>]]
+                [--check <rules file>]
+                [--record <store>] [--history <store> [--from <time>] [--to <time>]]
+                [--help|-h|/?] [--version] [volume]
 
 This program prints drive information for all devices, network mappings, DOS
-devices, and drive substitutions (via the `subst` command).
+devices, and drive substitutions (via the `subst` command). On Linux, it prints
+information for all mounted file systems with storage, including network file
+systems and bind mounts.
 
 Unless the `--json` option is supplied, the following drive values will be
 printed, in this order:
 
-    - Drive Letter
+    - Drive Letter (Linux: mount point)
     - Label
     - Serial Number
-    - Type (No root, Removable, Fixed, Remote, CD-ROM, or RAM Disk)
-    - File System (for example, NTFS, FAT, or FAT32)
-    - Volume GUID, drive substitution or target, or network mapping
+    - Type (No root, Removable, Fixed, Remote, CD-ROM, RAM Disk, or Unknown)
+    - File System (for example, NTFS, FAT, FAT32, or ext4)
+    - Volume GUID (Linux: file system UUID), drive substitution or target (Linux:
+      bind mount source directory), or network mapping
 
 The volume GUID can be used in a formal volume name, with the following form:
 
     \\?\Volume{GUID}\
 
 Options
-    [drive]
-        Optional drive letter for specific drive report (colon optional). If no
-        drive is specified, reports information for all drives.
+    [volume]
+        Optional volume for a specific volume report. The volume may be given
+        as a drive letter (colon optional), as any path on the volume, or as a
+        volume ID (Windows: volume GUID or name; Linux: file system UUID or
+        source device). If no volume is specified, reports information for all
+        drives.
+
+    --agent <[address:]port[-lastPort]>
+        Run as a drive agent, answering fleet queries (see `--hosts`) from
+        other machines. The agent listens on the given TCP port, or on every
+        port in the given range. Without an address, the agent listens on all
+        interfaces. A port range on the loopback address can simulate a fleet
+        of hosts on a single machine. The agent runs until terminated.
+
+    --agent-delay <ms>
+        Delay each agent reply by the given number of milliseconds. Use this to
+        simulate slow hosts when testing fleet query timeouts.
+
+    --format=<human|json|prometheus>
+        Select the output format. The default is `human`. The `json` format is
+        the same as the `--json` option. The `prometheus` format prints volume
+        metrics in the Prometheus text exposition format: volume identity
+        (`drives_volume_info`), capacity (`drives_volume_size_bytes`), free
+        space (`drives_volume_free_bytes`, `drives_volume_free_percent`), and
+        file system flags (`drives_volume_filesystem_flag`), each labeled with
+        the drive (and host, with `--hosts`).
 
     --help, -h, /?
         Print help information.
 
+    --hosts <host>[,<host>...]
+        Query the drive agents (see `--agent`) on all of the given hosts at
+        once, and print the merged results with a leading host column (or a
+        "host" field in JSON output). Each host has the form `name`,
+        `name:port`, or `[IPv6-address]:port`. The default port is 7250. If a
+        volume is specified, only that volume is reported for each host, where
+        it matches by drive letter, root path or volume ID. Hosts
+        that cannot be queried are reported to the error stream, and the exit
+        code is 1.
+
+    --interval <seconds>
+        The time between metrics file rewrites with `--textfile`, or between
+        reports with `--refresh-loop`. Defaults to 60 seconds.
+
     --json, -j
         Print full drive information in JSON format. To understand the file
         system flags, see documentation for the Windows function
         GetVolumeInformationW().
 
+    --refresh-loop
+        Run until terminated, keeping volume information in a cache that is
+        refreshed in the background, and print it from the cache every interval
+        (see `--interval`). Each volume is probed on its own, so slow volumes
+        never hold up fast ones. Fields that change often, such as free space,
+        are refreshed as often as every second, and stable fields down to every
+        five minutes. Slow volumes are probed less often, in proportion to how
+        long their probes take. JSON output includes the age of each group of
+        fields in milliseconds (`ageMs`), and verbose output includes the age
+        of the free space. With `--agent` or `--textfile`, replies and metrics
+        come from the cache instead of being printed.
+
+    --textfile <path>
+        Run until terminated, rewriting the given file with Prometheus metrics
+        (see `--format`) every interval (see `--interval`), for use with the
+        node_exporter textfile collector. Each rewrite goes to the temporary
+        file `<path>.tmp`, which then atomically replaces the target, so the
+        collector never reads a partial file.
+
+    --timeout <ms>
+        The time limit for querying each host with `--hosts`. Defaults to 5000
+        milliseconds.
+
+    --which [path...]
+        Report the volume that holds each of the given paths, or of each path
+        read from standard input (one per line) if none are given. The mount
+        points of all volumes (drive roots and folder mount points on Windows;
+        every mount, including bind mounts, on Linux) are read once, and then
+        each path is resolved without further system calls. Paths are resolved
+        as written: relative paths are taken from the current directory, and
+        symbolic links are not followed. Each path is printed after its
+        volume's drive, label, serial number, type and file system (or with
+        all volume fields in JSON output, with a leading "path" field). Paths
+        on no known volume are reported with no volume, and the exit code is 1.
+
+    --all-namespaces
+        Linux only. Report the volumes seen by the processes of all mount
+        namespaces (for example, those of containers), not just the volumes
+        of this process's namespace. Each file system is reported once, with
+        each namespace that sees it (by inode number), its mount point there,
+        and the namespace's processes (the first 8, or all in verbose or JSON
+        output). Seeing the namespaces of other users' processes requires
+        root.
+
+    --cached <volume>
+        Linux only. Scan the files of the given volume (a mount point or any
+        path on it) and report how much of their data is in the page cache,
+        for the volume and for each directory down to the --depth level. The
+        scan reads no file data, so it does not itself fill the cache. On
+        kernels without cachestat(2) (before 6.5), files you neither own nor
+        can write are reported as unmeasured, unless run as root.
+
+    --depth <levels>
+        With --cached, the number of directory levels below the volume root
+        to report. Deeper directories count toward their ancestor at this
+        level. Zero reports only the volume. Default: 1.
+
+    --frag <volume>
+        Scan the files of the given volume (a mount point or any path on it)
+        and report their extents: the files with data, how many are
+        fragmented (in more than one extent), the total extents, and the
+        volume's fragmentation factor (the share of extents beyond one per
+        file), followed by the most fragmented files of 1 MB or more. The
+        scan reads only extent maps, not file data.
+
+    --top <count>
+        With --frag, the number of most fragmented files to report. Default:
+        10.
+
+    --check <rules file>
+        Check all volumes (or the given volume) against the threshold rules
+        in the given file, print the volumes that fail them, and exit with a
+        monitoring plugin status: 0 (OK), 1 (WARNING), 2 (CRITICAL), or 3
+        (UNKNOWN, if the rules or volumes can't be read). Each line of the
+        file holds one rule, with one or more conditions joined by "and":
+
+            percentFree < 10 and driveType == Fixed => critical
+            fs != NTFS => warning
+
+        Numeric fields are percentFree, freeBytes and capacityBytes, compared
+        with <, <=, >, >=, == or !=; values may have a size suffix (KB, MB,
+        GB, TB, or KiB, MiB, GiB, TiB). No numeric condition holds for a
+        volume without capacity information. Text fields are mountPoint,
+        driveType (or type), fileSystem (or fs), label, volumeId and
+        networkMapping, compared with == or != (quote values with spaces).
+        Lines starting with '#' are comments. Each failing volume is printed
+        with its status and a rule it fails.
+
+    --record <store>
+        Append the capacity and free space of all volumes (or the given
+        volume) to the given history store file, creating it if need be, and
+        print nothing (unless with --check). Run this periodically (for
+        example, from cron) to build a history. Each sample takes a few bytes,
+        and the store is safe against crashes during an append.
+
+    --history <store>
+        Report each volume's free space over time from the given history
+        store: the number of samples and their time span, the latest, least
+        and greatest free space, the trend (by least-squares fit) in bytes per
+        day (given samples over at least an hour), and, if free space is
+        falling, the days until the volume is full.
+        With a volume argument, report only that volume (by volume ID or mount
+        point).
+
+    --from <time>, --to <time>
+        With --history, the span of time to report. Times are UTC dates
+        ("2026-10-01", "2026-10-01T12:00"), or durations before now ("12h",
+        "7d", "2w"). Default: all samples.
+
     --verbose, -v
         Generally, print additional volume information. This switch is ignored
         if the `--json` option is supplied. Additional volume information
@@ -628,29 +245,114 @@ int wmain (int argc, wchar_t* argv[]) {
         return 0;
     }
 
+    switch (commandOptions.mode) {
+        case Mode::Which:          return RunWhich(commandOptions);
+        case Mode::History:        return RunHistory(commandOptions);
+        case Mode::Frag:           return RunFrag(commandOptions);
+
+#if !defined(_WIN32)
+        case Mode::AllNamespaces:  return RunAllNamespaces(commandOptions);
+        case Mode::Cached:         return RunCached(commandOptions);
+#endif
+
+        case Mode::Hosts:
+        case Mode::Agent:
+            return RunFleet(commandOptions);
+
+        case Mode::RefreshLoop: {
+            VolumeCache volumeCache {commandOptions.singleVolume};
+            volumeCache.Start();
+            RunRefreshLoop(commandOptions, volumeCache);
+            return 0;
+        }
+
+        case Mode::Textfile: {
+            if (!commandOptions.refreshLoop) {
+                RunTextfileCollector(commandOptions);
+                return 0;
+            }
+
+            VolumeCache volumeCache {commandOptions.singleVolume};
+            volumeCache.Start();
+            RunTextfileCollector(commandOptions, &volumeCache);
+            return 0;
+        }
+
+        default:
+            break;   // Report or Check
+    }
+
+    // Query all drives (or the single specified volume) for volume information.
+
     vector<DriveInfo> drives;
+    const auto status = DriveCollector().Collect(drives, commandOptions.singleVolume);
+
+    // Monitoring checks report failures to probe as UNKNOWN.
+    const int failureCode = (commandOptions.mode == Mode::Check) ? static_cast<int>(CheckStatus::Unknown) : 1;
+
+    if (status == DRIVES_ERROR_NOT_FOUND) {
+        wcout << commandOptions.programName
+              << L": No volume present at " << commandOptions.singleVolume << L"." << endl;
+        return failureCode;
+    } else if (status != DRIVES_OK) {
+        wcerr << commandOptions.programName << L": ERROR: Unable to read the system volume list.\n";
+        return failureCode;
+    }
+
+    // Record the run to the history store. Without a check, nothing is printed.
 
-    if (commandOptions.singleDrive) {
-        if (!DriveValid(commandOptions.singleDrive)) {
-            wcout << commandOptions.programName
-                  << L": No volume present at drive " << commandOptions.singleDrive << L":." << endl;
-            return 1;
+    if (!commandOptions.recordPath.empty()) {
+        wstring error;
+        if (!HistoryStore().Append(ToNativePath(commandOptions.recordPath), drives, NowMs(), error)) {
+            wcerr << commandOptions.programName << L": ERROR: " << error << L" (" << commandOptions.recordPath
+                  << L").\n";
+            return failureCode;
         }
-        const auto drive = commandOptions.singleDrive;
-        if (DriveValid(drive))
-            drives.emplace_back(drive);
-    } else {
-        // Query all drives for volume information.
-        for (auto driveLetter = L'A';  driveLetter <= L'Z';  ++driveLetter)
-            if (DriveValid(driveLetter))
-                drives.emplace_back(driveLetter);
+
+        if (commandOptions.mode != Mode::Check)
+            return 0;
     }
 
+    if (commandOptions.mode == Mode::Check)
+        return RunCheck(commandOptions, drives);
+
     // For each drive, print volume information.
-    if (commandOptions.printJSON)
-        PrintResultsJSON(commandOptions, drives);
+    if (commandOptions.format == OutputFormat::Prometheus) {
+        vector<DriveRow> rows;
+        for (const auto& drive : drives)
+            rows.emplace_back(nullptr, &drive);
+        PrintResultsPrometheus(rows);
+    } else if (commandOptions.format == OutputFormat::JSON)
+        PrintResultsJSON(drives);
     else
         PrintResultsHuman(commandOptions, drives);
 
     return 0;
 }
+
+//======================================================================================================================
+
+#if !defined(_WIN32)
+
+int main (int argc, char* argv[]) {
+    // Convert the UTF-8 command line to wide strings for wmain(). Wide output is encoded according to
+    // the locale, falling back to UTF-8 where the locale's character set can't represent it all.
+
+    setlocale(LC_ALL, "");
+    if (0 != strcmp(nl_langinfo(CODESET), "UTF-8"))
+        setlocale(LC_CTYPE, "C.UTF-8");
+
+    vector<wstring>  arguments;
+    vector<wchar_t*> argumentPointers;
+
+    for (int i = 0;  i < argc;  ++i)
+        arguments.push_back(FromUTF8(argv[i]));
+
+    for (auto& argument : arguments)
+        argumentPointers.push_back(&argument[0]);
+    argumentPointers.push_back(nullptr);
+
+    return wmain(argc, argumentPointers.data());
+}
+
+#endif
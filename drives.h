@@ -0,0 +1,187 @@
+//==================================================================================================
+//
+//  libdrives
+//
+//  Volume enumeration and query library behind the `drives` command-line tool. This is a C API:
+//  all results are returned in caller-owned storage, and the library keeps no state between calls.
+//
+//==================================================================================================
+
+#ifndef DRIVES_H
+#define DRIVES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wchar.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DRIVES_API_VERSION 2
+
+// Capacity (in characters, including the terminating null) of each string field of DrivesVolume.
+// Longer values are truncated.
+#define DRIVES_MAX_STRING 261
+
+// Fields of DrivesVolume, selected with a field mask. The drive letter and root path are always
+// returned.
+typedef enum DrivesField {
+    DRIVES_FIELD_TYPE        = 0x01,  // type
+    DRIVES_FIELD_VOLUME_ID   = 0x02,  // volumeId
+    DRIVES_FIELD_MAPPING     = 0x04,  // substituteFor, networkMapping
+    DRIVES_FIELD_VOLUME_INFO = 0x08,  // volumeInfoValid, label, serialNumber, maxComponentLength,
+                                      // fileSystemFlags, fileSystem
+    DRIVES_FIELD_CAPACITY    = 0x10,  // sectorsPerCluster, bytesPerSector, clustersFree,
+                                      // clustersTotal, bytesTotal, bytesFree
+    DRIVES_FIELD_ALL         = 0x1f
+} DrivesField;
+
+typedef enum DrivesStatus {
+    DRIVES_OK = 0,
+    DRIVES_ERROR_INVALID_ARGUMENT,      // A null pointer or malformed volume specification
+    DRIVES_ERROR_NOT_FOUND,             // No volume matches the specification
+    DRIVES_ERROR_INSUFFICIENT_BUFFER,   // More volumes exist than the caller's array holds
+    DRIVES_ERROR_SYSTEM,                // The system volume list could not be read
+    DRIVES_ERROR_UNSUPPORTED            // The function is not available on this platform
+} DrivesStatus;
+
+typedef enum DrivesType {
+    DRIVES_TYPE_UNKNOWN = 0,
+    DRIVES_TYPE_NO_ROOT,
+    DRIVES_TYPE_REMOVABLE,
+    DRIVES_TYPE_FIXED,
+    DRIVES_TYPE_REMOTE,
+    DRIVES_TYPE_CDROM,
+    DRIVES_TYPE_RAMDISK
+} DrivesType;
+
+// File system flags (DrivesVolume.fileSystemFlags). These have the values of the corresponding
+// Windows FILE_* flags reported by GetVolumeInformationW(). The Linux backend reports the subset it
+// can determine from the mount.
+#define DRIVES_FS_CASE_SENSITIVE_SEARCH         0x00000001
+#define DRIVES_FS_CASE_PRESERVED_NAMES          0x00000002
+#define DRIVES_FS_UNICODE_ON_DISK               0x00000004
+#define DRIVES_FS_PERSISTENT_ACLS               0x00000008
+#define DRIVES_FS_FILE_COMPRESSION              0x00000010
+#define DRIVES_FS_VOLUME_QUOTAS                 0x00000020
+#define DRIVES_FS_SUPPORTS_SPARSE_FILES         0x00000040
+#define DRIVES_FS_SUPPORTS_REPARSE_POINTS       0x00000080
+#define DRIVES_FS_SUPPORTS_REMOTE_STORAGE       0x00000100
+#define DRIVES_FS_RETURNS_CLEANUP_RESULT_INFO   0x00000200
+#define DRIVES_FS_SUPPORTS_POSIX_UNLINK_RENAME  0x00000400
+#define DRIVES_FS_VOLUME_IS_COMPRESSED          0x00008000
+#define DRIVES_FS_SUPPORTS_OBJECT_IDS           0x00010000
+#define DRIVES_FS_SUPPORTS_ENCRYPTION           0x00020000
+#define DRIVES_FS_NAMED_STREAMS                 0x00040000
+#define DRIVES_FS_READ_ONLY_VOLUME              0x00080000
+#define DRIVES_FS_SEQUENTIAL_WRITE_ONCE         0x00100000
+#define DRIVES_FS_SUPPORTS_TRANSACTIONS         0x00200000
+#define DRIVES_FS_SUPPORTS_HARD_LINKS           0x00400000
+#define DRIVES_FS_SUPPORTS_EXTENDED_ATTRIBUTES  0x00800000
+#define DRIVES_FS_SUPPORTS_OPEN_BY_FILE_ID      0x01000000
+#define DRIVES_FS_SUPPORTS_USN_JOURNAL          0x02000000
+#define DRIVES_FS_SUPPORTS_INTEGRITY_STREAMS    0x04000000
+#define DRIVES_FS_SUPPORTS_BLOCK_REFCOUNTING    0x08000000
+#define DRIVES_FS_SUPPORTS_SPARSE_VDL           0x10000000
+#define DRIVES_FS_DAX_VOLUME                    0x20000000
+#define DRIVES_FS_SUPPORTS_GHOSTING             0x40000000
+
+typedef struct DrivesVolume {
+    uint32_t   fields;                             // DRIVES_FIELD_* bits that were queried
+
+    wchar_t    driveLetter;                        // 'A' to 'Z', or 0 if the volume has none
+    wchar_t    root[DRIVES_MAX_STRING];            // Root path, for example "X:\" or "/home"
+
+    DrivesType type;
+
+    // Windows: volume GUID, as in "\\?\Volume{GUID}\". Linux: file system UUID. Empty if none.
+    wchar_t    volumeId[DRIVES_MAX_STRING];
+
+    // Windows: target of a `subst` drive. Linux: the source directory of a bind mount.
+    wchar_t    substituteFor[DRIVES_MAX_STRING];
+
+    // Remote location of a network drive or network file system mount.
+    wchar_t    networkMapping[DRIVES_MAX_STRING];
+
+    int        volumeInfoValid;                    // Nonzero if the following volume fields are set
+    wchar_t    label[DRIVES_MAX_STRING];
+    uint32_t   serialNumber;
+    uint32_t   maxComponentLength;                 // Maximum length of a path component
+    uint32_t   fileSystemFlags;                    // DRIVES_FS_* flags
+    wchar_t    fileSystem[DRIVES_MAX_STRING];      // File system name, for example "NTFS" or "ext4"
+
+    uint32_t   sectorsPerCluster;                  // Capacity fields are zero if unavailable
+    uint32_t   bytesPerSector;
+    uint64_t   clustersFree;
+    uint64_t   clustersTotal;
+    int64_t    bytesTotal;
+    int64_t    bytesFree;                          // Bytes available to the caller
+} DrivesVolume;
+
+// A mount point, and the volume mounted there.
+typedef struct DrivesMountPoint {
+    wchar_t  path[DRIVES_MAX_STRING];    // Mount point, for example "X:\", "C:\mnt\data\" or "/home"
+    wchar_t  volume[DRIVES_MAX_STRING];  // The volume mounted there, as a volume for drives_query()
+    uint64_t device;                     // Linux: device number of the mounted file system. Windows: 0.
+
+    // Linux: the rest of the mount table entry, from which drives_mount_point_query() probes the
+    // volume. Empty on Windows.
+    wchar_t  source[DRIVES_MAX_STRING];          // Mount source, for example "/dev/sda1"
+    wchar_t  fileSystem[DRIVES_MAX_STRING];      // File system type, for example "ext4"
+    wchar_t  fileSystemRoot[DRIVES_MAX_STRING];  // Directory of the file system mounted there ("/"
+                                                 // unless a bind mount)
+
+    // Nonzero if the mount table entry was too long for the fields above (Linux paths may be far
+    // longer than DRIVES_MAX_STRING), which are then truncated. Such mount points can't be queried.
+    int      truncated;
+} DrivesMountPoint;
+
+// Enumerate all volumes (Windows: all drive letters; Linux: all mounted file systems with
+// storage), filling in the fields selected by the field mask. On return, *count holds the number of
+// volumes present. If that exceeds the capacity, the first `capacity` volumes are filled in and
+// DRIVES_ERROR_INSUFFICIENT_BUFFER is returned, with *count the capacity needed (this may slightly
+// overestimate the number of volumes).
+//
+// None of the query functions allocates memory, so callers that reuse their
+// volume arrays can probe repeatedly with no heap allocation.
+DrivesStatus drives_enumerate (uint32_t fields, DrivesVolume* volumes, size_t capacity, size_t* count);
+
+// Query a single volume, specified by drive letter ("X", "X:" or "X:\"), by any path on the volume,
+// or by volume ID (Windows: "{GUID}" or "\\?\Volume{GUID}\"; Linux: UUID or source device).
+DrivesStatus drives_query (const wchar_t* volume, uint32_t fields, DrivesVolume* result);
+
+// Enumerate all mount points (Windows: drive roots and folder mount points; Linux: every mount,
+// including bind mounts and file systems without storage), in mount order. Where one mount hides
+// another at the same mount point, the later mount comes later. On return, *count holds the number
+// of mount points. If that exceeds the capacity, the first `capacity` mount points are filled in and
+// DRIVES_ERROR_INSUFFICIENT_BUFFER is returned.
+DrivesStatus drives_mount_points (DrivesMountPoint* mounts, size_t capacity, size_t* count);
+
+// Query the volume mounted at a mount point returned by drives_mount_points() (pid zero) or
+// drives_namespace_mount_points() (the same pid). Unlike drives_query(), this doesn't read the mount
+// table again, so callers that probe every mount point take time linear in the number of mounts.
+// Truncated mount points give DRIVES_ERROR_NOT_FOUND. Windows: pid must be zero, and the mount
+// point's volume is queried as by drives_query().
+DrivesStatus drives_mount_point_query (
+    int pid, const DrivesMountPoint* mount, uint32_t fields, DrivesVolume* result);
+
+// Linux only: as drives_mount_points() and drives_query(), but for the mount namespace of the given
+// process. Its mount table is read from /proc/<pid>/mountinfo, and its file systems are probed
+// through /proc/<pid>/root, which requires permission to inspect the process. Volumes are specified
+// as for drives_query(), except that paths are taken as written, without following symbolic links.
+// Other platforms return DRIVES_ERROR_UNSUPPORTED.
+DrivesStatus drives_namespace_mount_points (int pid, DrivesMountPoint* mounts, size_t capacity, size_t* count);
+DrivesStatus drives_namespace_query (int pid, const wchar_t* volume, uint32_t fields, DrivesVolume* result);
+
+// Returns the display name of a volume type, for example "Fixed" or "CD-ROM".
+const wchar_t* drives_type_name (DrivesType type);
+
+// Returns the library version string.
+const wchar_t* drives_version (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+//==================================================================================================
+//
+//  libdrives internal helpers, shared by the platform backends.
+//
+//==================================================================================================
+
+#ifndef LIBDRIVES_INTERNAL_H
+#define LIBDRIVES_INTERNAL_H
+
+#include "drives.h"
+
+#include <string.h>
+
+template <size_t N>
+void CopyString (wchar_t (&destination)[N], const wchar_t* source) {
+    // Copy a null-terminated string into a fixed-size field, truncating it if necessary.
+
+    size_t i = 0;
+    for (;  i < N - 1 && source[i];  ++i)
+        destination[i] = source[i];
+    destination[i] = 0;
+}
+
+inline void ResetVolume (DrivesVolume& volume, uint32_t fields) {
+    // Clear all volume fields, and record the fields that will be queried.
+
+    memset(&volume, 0, sizeof volume);
+    volume.fields = fields & DRIVES_FIELD_ALL;
+}
+
+#endif
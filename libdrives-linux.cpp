@@ -0,0 +1,821 @@
+//==================================================================================================
+//
+//  libdrives Linux backend
+//
+//  Volumes are the mounted file systems listed in /proc/self/mountinfo that have storage (pseudo
+//  file systems such as proc or sysfs report no blocks, and are skipped by enumeration). The mount
+//  namespaces of other processes are read from /proc/<pid>/mountinfo, and probed through
+//  /proc/<pid>/root.
+//
+//  Probing allocates only on a thread's first call: the mount table and the /dev/disk/by-*
+//  directories are parsed in place, into working storage that each thread keeps for its later calls.
+//
+//==================================================================================================
+
+#include "drives.h"
+#include "libdrives-internal.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+namespace {
+
+//======================================================================================================================
+
+template <size_t N>
+bool CopyNarrowString (wchar_t (&destination)[N], const char* source) {
+    // Copy a UTF-8 string into a fixed-size field, truncating it if necessary. Invalid bytes are
+    // copied through as single characters. Returns false if the string was truncated.
+
+    size_t out = 0;
+    size_t i   = 0;
+    while (source[i] && out < N - 1) {
+        auto c = static_cast<unsigned char>(source[i]);
+        uint32_t codePoint = c;
+        int extra = (c >= 0xf0) ? 3 : (c >= 0xe0) ? 2 : (c >= 0xc0) ? 1 : 0;
+
+        for (int j = 1;  j <= extra;  ++j) {
+            if (!source[i + j])
+                extra = 0;
+        }
+
+        if (extra) {
+            codePoint = c & (0x3f >> extra);
+            for (int j = 1;  j <= extra;  ++j)
+                codePoint = (codePoint << 6) | (source[i + j] & 0x3f);
+        }
+
+        destination[out++] = static_cast<wchar_t>(codePoint);
+        i += 1 + extra;
+    }
+
+    destination[out] = 0;
+    return !source[i];
+}
+
+template <size_t N>
+bool NarrowString (char (&destination)[N], const wchar_t* source) {
+    // Write the UTF-8 encoding of a wide string. Returns false if it does not fit.
+
+    size_t out = 0;
+    for (;  *source;  ++source) {
+        const auto c = static_cast<uint32_t>(*source);
+        const size_t length = (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+
+        if (out + length >= N)
+            return false;
+
+        if (length == 1) {
+            destination[out++] = static_cast<char>(c);
+        } else if (length == 2) {
+            destination[out++] = static_cast<char>(0xc0 | (c >> 6));
+            destination[out++] = static_cast<char>(0x80 | (c & 0x3f));
+        } else if (length == 3) {
+            destination[out++] = static_cast<char>(0xe0 | (c >> 12));
+            destination[out++] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            destination[out++] = static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            destination[out++] = static_cast<char>(0xf0 | (c >> 18));
+            destination[out++] = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            destination[out++] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            destination[out++] = static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+
+    destination[out] = 0;
+    return true;
+}
+
+int HexDigit (char c) {
+    return ('0' <= c && c <= '9') ? (c - '0')
+         : ('a' <= c && c <= 'f') ? (c - 'a' + 10)
+         : ('A' <= c && c <= 'F') ? (c - 'A' + 10)
+         : -1;
+}
+
+//======================================================================================================================
+
+struct Mount {
+    // A single entry of /proc/self/mountinfo, with escapes removed.
+
+    char device[32];            // Device number, "major:minor"
+    char root[PATH_MAX];        // Directory of the file system that is mounted (not "/" for bind mounts)
+    char mountPoint[PATH_MAX];
+    char fileSystem[64];        // File system type, for example "ext4"
+    char source[PATH_MAX];      // Mount source, for example "/dev/sda1" or "server:/export"
+};
+
+template <size_t N>
+void MountInfoUnescape (char (&destination)[N], const char* field) {
+    // Mountinfo fields escape space, tab, newline and backslash as three-digit octal ("\040").
+    // Values longer than the destination are truncated.
+
+    size_t out = 0;
+    for (;  *field && out < N - 1;  ++field) {
+        if (field[0] == '\\' && '0' <= field[1] && field[1] <= '3'
+            && '0' <= field[2] && field[2] <= '7' && '0' <= field[3] && field[3] <= '7') {
+            destination[out++] = static_cast<char>(((field[1] - '0') << 6) | ((field[2] - '0') << 3) | (field[3] - '0'));
+            field += 3;
+        } else {
+            destination[out++] = *field;
+        }
+    }
+    destination[out] = 0;
+}
+
+char* NextField (char*& cursor) {
+    // Returns the next space-separated field of a line, null-terminated in place, or null at the end
+    // of the line.
+
+    while (*cursor == ' ')
+        ++cursor;
+
+    if (!*cursor)
+        return nullptr;
+
+    auto field = cursor;
+    while (*cursor && *cursor != ' ')
+        ++cursor;
+
+    if (*cursor)
+        *cursor++ = 0;
+
+    return field;
+}
+
+class MountTable {
+    // Reads the mounts of a mount namespace from /proc/<pid>/mountinfo, one at a time and in mount
+    // order, through a fixed-size buffer. Lines too long for the buffer are skipped.
+
+    int    file;
+    char   buffer[16 * 1024];
+    size_t start {0};  // Start of unread data in the buffer
+    size_t end {0};    // End of unread data in the buffer
+
+  public:
+
+    MountTable (int pid = 0) : file{-1} {
+        // Reads the mount namespace of the given process, or of the current process if zero.
+
+        char path[32];
+        if (pid)
+            snprintf(path, sizeof path, "/proc/%d/mountinfo", pid);
+        else
+            snprintf(path, sizeof path, "/proc/self/mountinfo");
+
+        file = open(path, O_RDONLY | O_CLOEXEC);
+    }
+
+    ~MountTable() {
+        if (file >= 0)
+            close(file);
+    }
+
+    bool IsOpen() const { return file >= 0; }
+
+    bool Next (Mount& mount) {
+        // Reads the next mount. Returns false at the end of the table.
+
+        char* line;
+        while (NextLine(line)) {
+            // Format: id parentId major:minor root mountPoint options [optional...] - type source superOptions
+
+            char* fields[6];
+            size_t count = 0;
+            while (count < size(fields) && nullptr != (fields[count] = NextField(line)))
+                ++count;
+
+            if (count < size(fields))
+                continue;
+
+            char* separator;
+            while (nullptr != (separator = NextField(line)) && 0 != strcmp(separator, "-"))
+                continue;
+
+            char* fileSystem = separator ? NextField(line) : nullptr;
+            char* source     = fileSystem ? NextField(line) : nullptr;
+
+            if (!source)
+                continue;
+
+            MountInfoUnescape(mount.device,     fields[2]);
+            MountInfoUnescape(mount.root,       fields[3]);
+            MountInfoUnescape(mount.mountPoint, fields[4]);
+            MountInfoUnescape(mount.fileSystem, fileSystem);
+            MountInfoUnescape(mount.source,     source);
+            return true;
+        }
+
+        return false;
+    }
+
+  private:
+
+    bool NextLine (char*& line) {
+        // Sets the line to the next line of the table, null-terminated in place in the buffer. Returns
+        // false at the end of the table.
+
+        bool skipping = false;  // True while discarding the rest of an overlong line
+
+        while (true) {
+            auto newline = static_cast<char*>(memchr(buffer + start, '\n', end - start));
+
+            if (newline) {
+                *newline = 0;
+                line  = buffer + start;
+                start = newline - buffer + 1;
+
+                if (!skipping)
+                    return true;
+
+                skipping = false;
+                continue;
+            }
+
+            memmove(buffer, buffer + start, end - start);
+            end  -= start;
+            start = 0;
+
+            if (end == sizeof buffer) {
+                skipping = true;
+                end = 0;
+            }
+
+            const auto count = read(file, buffer + end, sizeof buffer - end);
+
+            if (count <= 0) {
+                // A final line with no newline.
+                if (end == 0 || skipping)
+                    return false;
+                buffer[end] = 0;
+                line  = buffer;
+                start = end;
+                return true;
+            }
+
+            end += count;
+        }
+    }
+};
+
+//======================================================================================================================
+
+bool IsOneOf (const char* value, const char* const list[]) {
+    for (;  *list;  ++list)
+        if (0 == strcmp(value, *list))
+            return true;
+    return false;
+}
+
+const char* const remoteFileSystems[] = {
+    "nfs", "nfs4", "cifs", "smb3", "smbfs", "ncpfs", "afs", "9p", "ceph", "glusterfs", "lustre",
+    "fuse.sshfs", "fuse.glusterfs", "fuse.s3fs", "fuse.rclone", nullptr
+};
+const char* const ramFileSystems[]  = { "tmpfs", "ramfs", nullptr };
+const char* const discFileSystems[] = { "iso9660", "udf", nullptr };
+const char* const fatFileSystems[]  = { "vfat", "msdos", "exfat", nullptr };
+
+bool IsRemovable (const char* device) {
+    // Returns true if the block device is removable. Partitions take the flag of their disk.
+
+    for (auto format : { "/sys/dev/block/%s/removable", "/sys/dev/block/%s/../removable" }) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof path, format, device);
+
+        const int file = open(path, O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            continue;
+
+        char flag = 0;
+        const auto count = read(file, &flag, 1);
+        close(file);
+
+        if (count == 1)
+            return flag != '0';
+    }
+
+    return false;
+}
+
+DrivesType MountType (const Mount& mount) {
+    if (IsOneOf(mount.fileSystem, remoteFileSystems))
+        return DRIVES_TYPE_REMOTE;
+    if (IsOneOf(mount.fileSystem, ramFileSystems))
+        return DRIVES_TYPE_RAMDISK;
+    if (IsOneOf(mount.fileSystem, discFileSystems))
+        return DRIVES_TYPE_CDROM;
+    if (0 == strncmp(mount.source, "/dev/", 5))
+        return IsRemovable(mount.device) ? DRIVES_TYPE_REMOVABLE : DRIVES_TYPE_FIXED;
+    return DRIVES_TYPE_UNKNOWN;
+}
+
+//======================================================================================================================
+
+template <size_t N>
+void UdevUnescape (char (&destination)[N], const char* name) {
+    // The /dev/disk/by-* link names escape unsafe characters as hexadecimal ("\x20").
+
+    size_t out = 0;
+    for (;  *name && out < N - 1;  ++name) {
+        if (name[0] == '\\' && name[1] == 'x' && HexDigit(name[2]) >= 0 && HexDigit(name[3]) >= 0) {
+            destination[out++] = static_cast<char>((HexDigit(name[2]) << 4) | HexDigit(name[3]));
+            name += 3;
+        } else {
+            destination[out++] = *name;
+        }
+    }
+    destination[out] = 0;
+}
+
+//======================================================================================================================
+
+class DeviceNames {
+    // Names of block devices from one of the /dev/disk/by-* directories (for example, file system
+    // UUIDs from /dev/disk/by-uuid), keyed by device number. The directory is read on first use into
+    // a fixed-size table. If it holds more names than the table does, devices missing from the table
+    // are looked up by reading the directory again.
+
+    struct Entry {
+        dev_t device;
+        char  name[256];
+    };
+
+    const char* directory;
+    bool        loaded {false};
+    bool        overflow {false};  // True if the directory has names beyond the table's capacity
+    size_t      count {0};
+    Entry       entries[64];
+    Entry       found;             // The last name found beyond the table
+
+  public:
+
+    DeviceNames (const char* _directory) : directory{_directory} {}
+
+    void Reset() {
+        // Forget the names read, so the next lookup reads the directory again.
+
+        loaded   = false;
+        overflow = false;
+        count    = 0;
+    }
+
+    const char* Find (const char* source) {
+        // Returns the name for the given device, or null if it has none.
+
+        if (0 != strncmp(source, "/dev/", 5))
+            return nullptr;
+
+        if (!loaded)
+            Load();
+
+        struct stat info;
+        if (0 != stat(source, &info) || !S_ISBLK(info.st_mode))
+            return nullptr;
+
+        for (size_t i = 0;  i < count;  ++i)
+            if (entries[i].device == info.st_rdev)
+                return entries[i].name;
+
+        if (!overflow)
+            return nullptr;
+
+        bool isFound = false;
+        ReadDirectory([&](dev_t device, const char* name) {
+            if (device != info.st_rdev)
+                return true;
+            found.device = device;
+            UdevUnescape(found.name, name);
+            isFound = true;
+            return false;
+        });
+
+        return isFound ? found.name : nullptr;
+    }
+
+  private:
+
+    void Load() {
+        loaded = true;
+
+        ReadDirectory([this](dev_t device, const char* name) {
+            if (count == size(entries)) {
+                overflow = true;
+                return false;
+            }
+            entries[count].device = device;
+            UdevUnescape(entries[count].name, name);
+            ++count;
+            return true;
+        });
+    }
+
+    template <typename Visitor>
+    void ReadDirectory (Visitor&& visit) {
+        // Call visit(device, name) for each block device link of the directory, until it returns
+        // false. Entries are read with getdents64(), which (unlike opendir()) needs no heap buffer.
+
+        const int entryDirectory = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (entryDirectory < 0)
+            return;
+
+        alignas(dirent64) char buffer[4096];
+        long length;
+        bool reading = true;
+
+        while (reading && 0 < (length = syscall(SYS_getdents64, entryDirectory, buffer, sizeof buffer))) {
+            for (long offset = 0;  reading && offset < length; ) {
+                const auto entry = reinterpret_cast<const dirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+
+                struct stat info;
+                if (entry->d_name[0] == '.' || 0 != fstatat(entryDirectory, entry->d_name, &info, 0)
+                    || !S_ISBLK(info.st_mode))
+                    continue;
+
+                reading = visit(info.st_rdev, entry->d_name);
+            }
+        }
+
+        close(entryDirectory);
+    }
+};
+
+//======================================================================================================================
+
+struct Scratch {
+    // Working storage for a call, too large for the stack. Each thread keeps its own, from its first
+    // call on, so later calls neither allocate nor use much stack.
+
+    Mount       mount, idMatch, pathMatch;
+    DeviceNames uuids  {"/dev/disk/by-uuid"};
+    DeviceNames labels {"/dev/disk/by-label"};
+
+    // The mount table as read by drives_enumerate(): each mount's fields as null-terminated strings,
+    // and a hash table of mount points, each with the index of the last mount there.
+
+    struct MountStrings { size_t device, root, mountPoint, fileSystem, source; };
+
+    string               strings;
+    vector<MountStrings> mounts;
+    vector<size_t>       lastMounts;   // Open addressing: mount index + 1, or 0 for an empty slot
+};
+
+Scratch& ThreadScratch () {
+    // Returns the calling thread's working storage, with the device names from any earlier call
+    // forgotten, since devices may have come and gone since.
+
+    thread_local unique_ptr<Scratch> scratch;
+    if (!scratch)
+        scratch.reset(new Scratch);
+
+    scratch->uuids.Reset();
+    scratch->labels.Reset();
+    return *scratch;
+}
+
+//======================================================================================================================
+
+void ProbeMount (
+    const Mount& mount, const struct statvfs& stats, uint32_t fields, DeviceNames& uuids, DeviceNames& labels,
+    DrivesVolume& volume
+) {
+    // Fill in the requested fields for the given mount, whose file system statistics have already
+    // been read.
+
+    ResetVolume(volume, fields);
+    CopyNarrowString(volume.root, mount.mountPoint);
+
+    if (fields & DRIVES_FIELD_TYPE)
+        volume.type = MountType(mount);
+
+    if (fields & DRIVES_FIELD_VOLUME_ID) {
+        if (auto uuid = uuids.Find(mount.source))
+            CopyNarrowString(volume.volumeId, uuid);
+    }
+
+    if (fields & DRIVES_FIELD_MAPPING) {
+        if (0 != strcmp(mount.root, "/"))
+            CopyNarrowString(volume.substituteFor, mount.root);
+        if (IsOneOf(mount.fileSystem, remoteFileSystems))
+            CopyNarrowString(volume.networkMapping, mount.source);
+    }
+
+    if (fields & DRIVES_FIELD_VOLUME_INFO) {
+        volume.volumeInfoValid    = 1;
+        volume.serialNumber       = static_cast<uint32_t>(stats.f_fsid);
+        volume.maxComponentLength = static_cast<uint32_t>(stats.f_namemax);
+        CopyNarrowString(volume.fileSystem, mount.fileSystem);
+
+        if (auto label = labels.Find(mount.source))
+            CopyNarrowString(volume.label, label);
+
+        // Report the flags that follow from the file system type and mount options.
+        if (!IsOneOf(mount.fileSystem, fatFileSystems))
+            volume.fileSystemFlags |= DRIVES_FS_CASE_SENSITIVE_SEARCH | DRIVES_FS_SUPPORTS_HARD_LINKS;
+        if (0 != strcmp(mount.fileSystem, "msdos"))
+            volume.fileSystemFlags |= DRIVES_FS_CASE_PRESERVED_NAMES;
+        if (stats.f_flag & ST_RDONLY)
+            volume.fileSystemFlags |= DRIVES_FS_READ_ONLY_VOLUME;
+    }
+
+    if (fields & DRIVES_FIELD_CAPACITY) {
+        volume.sectorsPerCluster = 1;
+        volume.bytesPerSector    = static_cast<uint32_t>(stats.f_frsize);
+        volume.clustersFree      = stats.f_bavail;
+        volume.clustersTotal     = stats.f_blocks;
+        volume.bytesTotal        = static_cast<int64_t>(stats.f_frsize * stats.f_blocks);
+        volume.bytesFree         = static_cast<int64_t>(stats.f_frsize * stats.f_bavail);
+    }
+}
+
+uint64_t MountDevice (const Mount& mount) {
+    // Returns the device number of the mounted file system, from its "major:minor" form.
+
+    unsigned major = 0, minor = 0;
+    sscanf(mount.device, "%u:%u", &major, &minor);
+    return makedev(major, minor);
+}
+
+bool PathUnderMount (const char* path, const char* mountPoint) {
+    // Returns true if the canonical path lies on or under the mount point.
+
+    const auto length = strlen(mountPoint);
+
+    if (0 != strncmp(path, mountPoint, length))
+        return false;
+
+    return 0 == strcmp(mountPoint, "/") || path[length] == 0 || path[length] == '/';
+}
+
+DrivesStatus ProbeMountPoint (
+    int pid, const Mount& mount, uint32_t fields, DeviceNames& uuids, DeviceNames& labels, DrivesVolume& result
+) {
+    // Probe the given mount of the mount namespace of the given process (zero for the current
+    // process). Another process's mounts are reached through its root directory.
+
+    char mountPath [PATH_MAX + 32];
+    if (pid)
+        snprintf(mountPath, sizeof mountPath, "/proc/%d/root%s", pid, mount.mountPoint);
+    else
+        snprintf(mountPath, sizeof mountPath, "%s", mount.mountPoint);
+
+    struct statvfs stats;
+    if (0 != statvfs(mountPath, &stats))
+        return DRIVES_ERROR_NOT_FOUND;
+
+    ProbeMount(mount, stats, fields, uuids, labels, result);
+    return DRIVES_OK;
+}
+
+//======================================================================================================================
+
+DrivesStatus QueryMount (
+    int pid, const char* spec, const char* path, uint32_t fields, DrivesVolume* result
+) {
+    // Query the volume with the given ID or mount source (spec), or else the volume holding the given
+    // canonical path (if not null), in the mount namespace of the given process (zero for the current
+    // process).
+
+    MountTable mounts {pid};
+    if (!mounts.IsOpen())
+        return DRIVES_ERROR_SYSTEM;
+
+    auto& scratch   = ThreadScratch();
+    auto& uuids     = scratch.uuids;
+    auto& labels    = scratch.labels;
+    auto& mount     = scratch.mount;
+    auto& idMatch   = scratch.idMatch;
+    auto& pathMatch = scratch.pathMatch;
+
+    bool foundId = false, foundPath = false;
+
+    while (mounts.Next(mount)) {
+        // Prefer a mount of the whole file system over bind mounts of its directories.
+
+        const auto uuid = uuids.Find(mount.source);
+        if ((0 == strcmp(mount.source, spec) || (uuid && 0 == strcmp(uuid, spec)))
+            && (!foundId || 0 != strcmp(idMatch.root, "/"))) {
+            idMatch = mount;
+            foundId = true;
+        }
+
+        // For paths, find the mount with the longest mount point containing it. Where one mount
+        // hides another at the same mount point, the later mount wins.
+
+        if (path && PathUnderMount(path, mount.mountPoint)
+            && (!foundPath || strlen(mount.mountPoint) >= strlen(pathMatch.mountPoint))) {
+            pathMatch = mount;
+            foundPath = true;
+        }
+    }
+
+    if (!(foundId || foundPath))
+        return DRIVES_ERROR_NOT_FOUND;
+
+    return ProbeMountPoint(pid, foundId ? idMatch : pathMatch, fields, uuids, labels, *result);
+}
+
+DrivesStatus ListMountPoints (int pid, DrivesMountPoint* mounts, size_t capacity, size_t* count) {
+    // List the mount points of the mount namespace of the given process (zero for the current
+    // process).
+
+    MountTable table {pid};
+    if (!table.IsOpen())
+        return DRIVES_ERROR_SYSTEM;
+
+    // Every mount is queried by its mount point, which names the topmost mount there.
+
+    auto&  mount = ThreadScratch().mount;
+    size_t found = 0;
+
+    while (table.Next(mount)) {
+        if (found < capacity) {
+            // Every field is copied (hence "|", not "||"), noting whether any was too long.
+
+            auto& entry = mounts[found];
+            CopyNarrowString(entry.volume, mount.mountPoint);
+            entry.device    = MountDevice(mount);
+            entry.truncated = !CopyNarrowString(entry.path, mount.mountPoint)
+                            | !CopyNarrowString(entry.source, mount.source)
+                            | !CopyNarrowString(entry.fileSystem, mount.fileSystem)
+                            | !CopyNarrowString(entry.fileSystemRoot, mount.root);
+        }
+        ++found;
+    }
+
+    *count = found;
+    return (found > capacity) ? DRIVES_ERROR_INSUFFICIENT_BUFFER : DRIVES_OK;
+}
+
+}  // namespace
+
+//======================================================================================================================
+
+DrivesStatus drives_enumerate (uint32_t fields, DrivesVolume* volumes, size_t capacity, size_t* count) {
+    if (!count || (capacity > 0 && !volumes))
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    MountTable table;
+    if (!table.IsOpen())
+        return DRIVES_ERROR_SYSTEM;
+
+    auto& scratch = ThreadScratch();
+    auto& mount   = scratch.mount;
+    auto& strings = scratch.strings;
+    auto& mounts  = scratch.mounts;
+
+    // Read the whole mount table first, since a mount hides any earlier mount at the same mount
+    // point, and only the last mount at each mount point is probed.
+
+    strings.clear();
+    mounts.clear();
+
+    auto append = [&](const char* field) {
+        const auto offset = strings.size();
+        strings.append(field, strlen(field) + 1);
+        return offset;
+    };
+
+    while (table.Next(mount)) {
+        Scratch::MountStrings entry;
+        entry.device     = append(mount.device);
+        entry.root       = append(mount.root);
+        entry.mountPoint = append(mount.mountPoint);
+        entry.fileSystem = append(mount.fileSystem);
+        entry.source     = append(mount.source);
+        mounts.push_back(entry);
+    }
+
+    auto& lastMounts = scratch.lastMounts;
+    size_t slots = 16;
+    while (slots < 2 * mounts.size())
+        slots *= 2;
+    lastMounts.assign(slots, 0);
+
+    auto findSlot = [&](const char* mountPoint) {
+        // Returns the hash table slot of the mount point, or the empty slot where it belongs.
+
+        uint64_t hash = 14695981039346656037u;   // FNV-1a
+        for (auto p = mountPoint;  *p;  ++p)
+            hash = (hash ^ static_cast<unsigned char>(*p)) * 1099511628211u;
+
+        auto slot = static_cast<size_t>(hash) & (slots - 1);
+        while (lastMounts[slot]
+               && 0 != strcmp(mountPoint, strings.data() + mounts[lastMounts[slot] - 1].mountPoint))
+            slot = (slot + 1) & (slots - 1);
+        return slot;
+    };
+
+    for (size_t i = 0;  i < mounts.size();  ++i)
+        lastMounts[findSlot(strings.data() + mounts[i].mountPoint)] = i + 1;
+
+    // Probe the visible mounts, in mount order.
+
+    size_t found = 0;
+
+    for (size_t i = 0;  i < mounts.size();  ++i) {
+        const auto& entry = mounts[i];
+        if (lastMounts[findSlot(strings.data() + entry.mountPoint)] != i + 1)
+            continue;
+
+        struct statvfs stats;
+        if (0 != statvfs(strings.data() + entry.mountPoint, &stats) || stats.f_blocks == 0)
+            continue;
+
+        if (found < capacity) {
+            strcpy(mount.device,     strings.data() + entry.device);
+            strcpy(mount.root,       strings.data() + entry.root);
+            strcpy(mount.mountPoint, strings.data() + entry.mountPoint);
+            strcpy(mount.fileSystem, strings.data() + entry.fileSystem);
+            strcpy(mount.source,     strings.data() + entry.source);
+            ProbeMount(mount, stats, fields, scratch.uuids, scratch.labels, volumes[found]);
+        }
+
+        ++found;
+    }
+
+    *count = found;
+    return (found > capacity) ? DRIVES_ERROR_INSUFFICIENT_BUFFER : DRIVES_OK;
+}
+
+//======================================================================================================================
+
+DrivesStatus drives_query (const wchar_t* volume, uint32_t fields, DrivesVolume* result) {
+    if (!volume || !*volume || !result)
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    char spec [PATH_MAX];
+    if (!NarrowString(spec, volume))
+        return DRIVES_ERROR_NOT_FOUND;
+
+    // The spec may be a volume ID (file system UUID) or mount source, or else a path.
+
+    char path [PATH_MAX];
+    return QueryMount(0, spec, realpath(spec, path), fields, result);
+}
+
+DrivesStatus drives_namespace_query (int pid, const wchar_t* volume, uint32_t fields, DrivesVolume* result) {
+    if (pid <= 0 || !volume || !*volume || !result)
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    char spec [PATH_MAX];
+    if (!NarrowString(spec, volume))
+        return DRIVES_ERROR_NOT_FOUND;
+
+    // Paths are in the other process's namespace, so can't be resolved here, and are taken as is.
+
+    return QueryMount(pid, spec, (spec[0] == '/') ? spec : nullptr, fields, result);
+}
+
+DrivesStatus drives_mount_point_query (int pid, const DrivesMountPoint* mount, uint32_t fields, DrivesVolume* result) {
+    if (pid < 0 || !mount || !result)
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    if (mount->truncated)
+        return DRIVES_ERROR_NOT_FOUND;
+
+    // Rebuild the mount table entry from the mount point, and probe it as found.
+
+    auto& scratch = ThreadScratch();
+    auto& entry   = scratch.mount;
+
+    if (!NarrowString(entry.mountPoint, mount->path) || !NarrowString(entry.root, mount->fileSystemRoot)
+        || !NarrowString(entry.source, mount->source) || !NarrowString(entry.fileSystem, mount->fileSystem))
+        return DRIVES_ERROR_NOT_FOUND;
+
+    snprintf(entry.device, sizeof entry.device, "%u:%u", major(mount->device), minor(mount->device));
+
+    return ProbeMountPoint(pid, entry, fields, scratch.uuids, scratch.labels, *result);
+}
+
+//======================================================================================================================
+
+DrivesStatus drives_mount_points (DrivesMountPoint* mounts, size_t capacity, size_t* count) {
+    if (!count || (capacity > 0 && !mounts))
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    return ListMountPoints(0, mounts, capacity, count);
+}
+
+DrivesStatus drives_namespace_mount_points (int pid, DrivesMountPoint* mounts, size_t capacity, size_t* count) {
+    if (pid <= 0 || !count || (capacity > 0 && !mounts))
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    return ListMountPoints(pid, mounts, capacity, count);
+}
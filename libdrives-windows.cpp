@@ -0,0 +1,361 @@
+//==================================================================================================
+//
+//  libdrives Windows backend
+//
+//  Volumes are the logical drives A: to Z:, plus any volume that is queried by path or GUID.
+//  Probing does not allocate: strings are written directly into the caller's DrivesVolume.
+//
+//==================================================================================================
+
+#define _WIN32_WINNT 0x501   // Windows XP or Greater
+#include <windows.h>
+
+#include "drives.h"
+#include "libdrives-internal.h"
+
+#include <wctype.h>
+
+using namespace std;
+
+
+namespace {
+
+//======================================================================================================================
+
+DrivesType VolumeType (UINT type) {
+    // Returns the volume type for GetDriveTypeW() values.
+
+    switch (type) {
+        case DRIVE_NO_ROOT_DIR:  return DRIVES_TYPE_NO_ROOT;
+        case DRIVE_REMOVABLE:    return DRIVES_TYPE_REMOVABLE;
+        case DRIVE_FIXED:        return DRIVES_TYPE_FIXED;
+        case DRIVE_REMOTE:       return DRIVES_TYPE_REMOTE;
+        case DRIVE_CDROM:        return DRIVES_TYPE_CDROM;
+        case DRIVE_RAMDISK:      return DRIVES_TYPE_RAMDISK;
+    }
+
+    return DRIVES_TYPE_UNKNOWN;
+}
+
+//======================================================================================================================
+
+void DriveSubstitution (wchar_t driveLetter, DrivesVolume& volume) {
+    // Gets the substitution for the given DOS drive. For example, by using the `subst` command.
+
+    WCHAR drive[] = L"_:";
+    const DWORD bufferSize = 4096;
+    WCHAR outBuffer[bufferSize];
+
+    drive[0] = driveLetter;
+
+    auto numChars = QueryDosDeviceW(drive, outBuffer, bufferSize);
+
+    // Substituted drives have a device name beginning with "\??\", followed by the full drive path.
+    // For example, if X: is a substitute for A:\users\yoda, then the device path would be
+    // "\??\A:\users\yoda".
+    if (numChars > 4 && outBuffer[0] == '\\' && outBuffer[1] == '?' && outBuffer[2] == '?' && outBuffer[3] == '\\') {
+        CopyString(volume.substituteFor, outBuffer + 4);
+    }
+}
+
+//======================================================================================================================
+
+void NetworkMap (wchar_t driveLetter, DrivesVolume& volume) {
+    // Get the network-mapped connection for the specified drive, if any.
+
+    WCHAR drive[] = L"_:";
+    drive[0] = driveLetter;
+
+    DWORD bufferSize = DRIVES_MAX_STRING;
+    auto result = WNetGetConnectionW(drive, volume.networkMapping, &bufferSize);
+
+    if (result == ERROR_MORE_DATA) {
+        // Longer than the field: fetch the full mapping into a larger stack buffer, and keep what fits.
+        wchar_t buffer [4096];
+        bufferSize = sizeof buffer / sizeof buffer[0];
+        result = WNetGetConnectionW(drive, buffer, &bufferSize);
+        if (result == NO_ERROR)
+            CopyString(volume.networkMapping, buffer);
+    }
+
+    if (result != NO_ERROR) {
+        // For all error results, leave the mapping empty. Possible errors include ERROR_BAD_DEVICE,
+        // ERROR_NOT_CONNECTED, ERROR_CONNECTION_UNAVAIL, ERROR_NO_NETWORK, ERROR_EXTENDED_ERROR,
+        // ERROR_NO_NET_OR_BAD_PATH.
+        volume.networkMapping[0] = 0;
+    }
+}
+
+//======================================================================================================================
+
+void ProbeVolume (const wchar_t* root, wchar_t driveLetter, uint32_t fields, DrivesVolume& volume) {
+    // Fill in the requested fields for the volume at the given root path. Drive substitutions and
+    // network mappings only apply to volumes with a drive letter.
+
+    ResetVolume(volume, fields);
+    volume.driveLetter = driveLetter;
+    CopyString(volume.root, root);
+
+    if (fields & DRIVES_FIELD_TYPE)
+        volume.type = VolumeType(GetDriveTypeW(root));
+
+    if (fields & DRIVES_FIELD_VOLUME_ID) {
+        wchar_t nameBuffer [MAX_PATH + 1];
+        if (GetVolumeNameForVolumeMountPointW(root, nameBuffer, MAX_PATH + 1)) {
+            // The standard volume name is of the form "\\?\Volume{GUID}\". Extract just the GUID.
+
+            auto guidStart = wcschr(nameBuffer, L'{');
+            auto guidEnd   = wcsrchr(nameBuffer, L'}');
+            if (guidStart && guidEnd > guidStart) {
+                *guidEnd = 0;
+                CopyString(volume.volumeId, guidStart + 1);
+            }
+        }
+    }
+
+    if ((fields & DRIVES_FIELD_MAPPING) && driveLetter) {
+        DriveSubstitution(driveLetter, volume);
+        NetworkMap(driveLetter, volume);
+    }
+
+    if (fields & DRIVES_FIELD_VOLUME_INFO) {
+        DWORD serialNumber, maxComponentLength, fileSysFlags;
+
+        volume.volumeInfoValid = 0 != GetVolumeInformationW(
+            root, volume.label, DRIVES_MAX_STRING, &serialNumber, &maxComponentLength, &fileSysFlags,
+            volume.fileSystem, DRIVES_MAX_STRING);
+
+        if (volume.volumeInfoValid) {
+            volume.serialNumber       = serialNumber;
+            volume.maxComponentLength = maxComponentLength;
+            volume.fileSystemFlags    = fileSysFlags;
+        } else {
+            volume.label[0] = 0;
+            volume.fileSystem[0] = 0;
+        }
+    }
+
+    if (fields & DRIVES_FIELD_CAPACITY) {
+        DWORD sectorsPerCluster, bytesPerSector, clustersFree, clustersTotal;
+
+        if (GetDiskFreeSpaceW(root, &sectorsPerCluster, &bytesPerSector, &clustersFree, &clustersTotal)) {
+            int64_t bytesPerCluster = bytesPerSector * int64_t(sectorsPerCluster);
+
+            volume.sectorsPerCluster = sectorsPerCluster;
+            volume.bytesPerSector    = bytesPerSector;
+            volume.clustersFree      = clustersFree;
+            volume.clustersTotal     = clustersTotal;
+            volume.bytesTotal        = bytesPerCluster * clustersTotal;
+            volume.bytesFree         = bytesPerCluster * clustersFree;
+        }
+    }
+}
+
+//======================================================================================================================
+
+wchar_t DriveLetterSpec (const wchar_t* spec) {
+    // Returns the uppercase drive letter for the forms "X", "X:" and "X:\", or zero otherwise.
+
+    const bool driveLetterInRange =  ((L'A' <= spec[0]) && (spec[0] <= L'Z'))
+                                  || ((L'a' <= spec[0]) && (spec[0] <= L'z'));
+    if (!driveLetterInRange)
+        return 0;
+
+    if (spec[1] == 0 || (spec[1] == L':' && (spec[2] == 0 || (spec[2] == L'\\' && spec[3] == 0))))
+        return towupper(spec[0]);
+
+    return 0;
+}
+
+bool VolumeGuidPath (const wchar_t* spec, wchar_t (&path)[MAX_PATH + 1]) {
+    // If the spec is a volume GUID, with or without braces, or the full volume name
+    // "\\?\Volume{GUID}\", writes the full volume name to the path and returns true.
+
+    const wchar_t prefix[] = L"\\\\?\\Volume{";
+    const auto prefixLength = wcslen(prefix);
+
+    if (0 == wcsncmp(spec, prefix, prefixLength))
+        spec += prefixLength;
+    else if (spec[0] == L'{')
+        ++spec;
+
+    // A GUID has the form XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX.
+    for (int i = 0;  i < 36;  ++i) {
+        const bool dash = (i == 8 || i == 13 || i == 18 || i == 23);
+        if (dash ? (spec[i] != L'-') : !iswxdigit(spec[i]))
+            return false;
+    }
+
+    const auto tail = spec + 36;
+    if (*tail != 0 && wcscmp(tail, L"}") != 0 && wcscmp(tail, L"}\\") != 0)
+        return false;
+
+    wcscpy(path, prefix);
+    wcsncat(path, spec, 36);
+    wcscat(path, L"}\\");
+    return true;
+}
+
+wchar_t VolumeDriveLetter (const wchar_t* volumeName) {
+    // Returns the first drive letter at which the named volume is mounted, or zero if none.
+
+    wchar_t paths [4 * (MAX_PATH + 1)];
+    DWORD   length;
+
+    if (!GetVolumePathNamesForVolumeNameW(volumeName, paths, sizeof paths / sizeof paths[0], &length))
+        return 0;
+
+    // The result is a list of null-terminated paths, terminated by an empty path.
+    for (auto path = paths;  *path;  path += wcslen(path) + 1) {
+        if (auto driveLetter = DriveLetterSpec(path))
+            return driveLetter;
+    }
+
+    return 0;
+}
+
+}  // namespace
+
+//======================================================================================================================
+
+DrivesStatus drives_enumerate (uint32_t fields, DrivesVolume* volumes, size_t capacity, size_t* count) {
+    if (!count || (capacity > 0 && !volumes))
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    const auto logicalDrives = GetLogicalDrives();
+    if (logicalDrives == 0)
+        return DRIVES_ERROR_SYSTEM;
+
+    size_t found = 0;
+    for (auto driveLetter = L'A';  driveLetter <= L'Z';  ++driveLetter) {
+        if (!(logicalDrives & (1 << (driveLetter - L'A'))))
+            continue;
+
+        if (found < capacity) {
+            wchar_t root[] = L"_:\\";
+            root[0] = driveLetter;
+            ProbeVolume(root, driveLetter, fields, volumes[found]);
+        }
+
+        ++found;
+    }
+
+    *count = found;
+    return (found > capacity) ? DRIVES_ERROR_INSUFFICIENT_BUFFER : DRIVES_OK;
+}
+
+//======================================================================================================================
+
+DrivesStatus drives_query (const wchar_t* volume, uint32_t fields, DrivesVolume* result) {
+    if (!volume || !*volume || !result)
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    wchar_t root [MAX_PATH + 1];
+    wchar_t driveLetter = DriveLetterSpec(volume);
+
+    if (driveLetter) {
+        if (!(GetLogicalDrives() & (1 << (driveLetter - L'A'))))
+            return DRIVES_ERROR_NOT_FOUND;
+    } else if (VolumeGuidPath(volume, root)) {
+        // Report volumes that have a drive letter by that letter, to include any mapping.
+        driveLetter = VolumeDriveLetter(root);
+        if (!driveLetter && GetDriveTypeW(root) == DRIVE_NO_ROOT_DIR)
+            return DRIVES_ERROR_NOT_FOUND;
+    } else {
+        // Any other path: find the root of the volume that holds it.
+        if (!GetVolumePathNameW(volume, root, MAX_PATH + 1))
+            return DRIVES_ERROR_NOT_FOUND;
+        driveLetter = DriveLetterSpec(root);
+    }
+
+    if (driveLetter) {
+        root[0] = driveLetter;
+        root[1] = L':';
+        root[2] = L'\\';
+        root[3] = 0;
+    }
+
+    ProbeVolume(root, driveLetter, fields, *result);
+    return DRIVES_OK;
+}
+
+//======================================================================================================================
+
+DrivesStatus drives_mount_points (DrivesMountPoint* mounts, size_t capacity, size_t* count) {
+    if (!count || (capacity > 0 && !mounts))
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    size_t found = 0;
+    DWORD  volumeLetters = 0;  // Drive letters that are volume mount points
+
+    auto add = [&](const wchar_t* path, const wchar_t* volume) {
+        if (found < capacity) {
+            auto& entry = mounts[found];
+            memset(&entry, 0, sizeof entry);
+            CopyString(entry.path, path);
+            CopyString(entry.volume, volume);
+        }
+        ++found;
+    };
+
+    // Every path of every volume: drive roots and folder mount points.
+
+    wchar_t volumeName [MAX_PATH + 1];
+    auto    volumes = FindFirstVolumeW(volumeName, MAX_PATH + 1);
+
+    if (volumes != INVALID_HANDLE_VALUE) {
+        do {
+            wchar_t paths [8 * (MAX_PATH + 1)];
+            DWORD   length;
+
+            if (!GetVolumePathNamesForVolumeNameW(volumeName, paths, sizeof paths / sizeof paths[0], &length))
+                continue;
+
+            for (auto path = paths;  *path;  path += wcslen(path) + 1) {
+                if (auto driveLetter = DriveLetterSpec(path))
+                    volumeLetters |= 1 << (driveLetter - L'A');
+                add(path, volumeName);
+            }
+        } while (FindNextVolumeW(volumes, volumeName, MAX_PATH + 1));
+
+        FindVolumeClose(volumes);
+    }
+
+    // Drive letters that are not volume mount points: network drives and drive substitutions.
+
+    const auto logicalDrives = GetLogicalDrives();
+
+    for (auto driveLetter = L'A';  driveLetter <= L'Z';  ++driveLetter) {
+        if (!(logicalDrives & ~volumeLetters & (1 << (driveLetter - L'A'))))
+            continue;
+
+        wchar_t root[] = L"_:\\";
+        root[0] = driveLetter;
+        add(root, root);
+    }
+
+    *count = found;
+    return (found > capacity) ? DRIVES_ERROR_INSUFFICIENT_BUFFER : DRIVES_OK;
+}
+
+DrivesStatus drives_mount_point_query (int pid, const DrivesMountPoint* mount, uint32_t fields, DrivesVolume* result) {
+    if (pid < 0 || !mount)
+        return DRIVES_ERROR_INVALID_ARGUMENT;
+
+    // Windows has no mount namespaces, and queries by volume name read no mount table.
+    if (pid)
+        return DRIVES_ERROR_UNSUPPORTED;
+
+    return drives_query(mount->volume, fields, result);
+}
+
+//======================================================================================================================
+
+DrivesStatus drives_namespace_mount_points (int, DrivesMountPoint*, size_t, size_t*) {
+    // Windows has no mount namespaces.
+    return DRIVES_ERROR_UNSUPPORTED;
+}
+
+DrivesStatus drives_namespace_query (int, const wchar_t*, uint32_t, DrivesVolume*) {
+    return DRIVES_ERROR_UNSUPPORTED;
+}
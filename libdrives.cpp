@@ -0,0 +1,28 @@
+//==================================================================================================
+//
+//  libdrives
+//
+//  Platform-independent parts of the libdrives API. See drives.h for the API, and
+//  libdrives-windows.cpp or libdrives-linux.cpp for the platform backends.
+//
+//==================================================================================================
+
+#include "drives.h"
+
+const wchar_t* drives_type_name (DrivesType type) {
+    switch (type) {
+        case DRIVES_TYPE_NO_ROOT:    return L"No root";
+        case DRIVES_TYPE_REMOVABLE:  return L"Removable";
+        case DRIVES_TYPE_FIXED:      return L"Fixed";
+        case DRIVES_TYPE_REMOTE:     return L"Remote";
+        case DRIVES_TYPE_CDROM:      return L"CD-ROM";
+        case DRIVES_TYPE_RAMDISK:    return L"RAM Disk";
+        case DRIVES_TYPE_UNKNOWN:    break;
+    }
+
+    return L"Unknown";
+}
+
+const wchar_t* drives_version () {
+    return L"libdrives v3.1.0";
+}
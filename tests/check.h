@@ -0,0 +1,34 @@
+//==================================================================================================
+//
+//  Test checks, shared by the drives tests
+//
+//  Each failed CHECK() is reported on stderr and counted; a test program exits with a nonzero code
+//  if any check failed. Tests that can't run here (for example, those that need root) exit with
+//  testSkipped, which ctest reports as skipped.
+//
+//==================================================================================================
+
+#ifndef DRIVES_TEST_CHECK_H
+#define DRIVES_TEST_CHECK_H
+
+#include <stdio.h>
+
+const int testSkipped = 77;
+
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    ((condition) ? (void)0 \
+                 : (void)(++TestFailures(), fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition)))
+
+inline int TestResult() {
+    // Returns the exit code of the test program.
+    if (TestFailures())
+        fprintf(stderr, "%d check(s) failed\n", TestFailures());
+    return TestFailures() ? 1 : 0;
+}
+
+#endif
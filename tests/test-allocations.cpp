@@ -0,0 +1,161 @@
+//==================================================================================================
+//
+//  test-allocations
+//
+//  Checks that a refresh cycle makes no heap allocations once the buffers have grown: collecting
+//  all volumes through libdrives, and rendering them as human, JSON and Prometheus output. The
+//  global operator new and operator delete are replaced with versions that count allocations.
+//
+//==================================================================================================
+
+#include "../drives-info.h"
+#include "check.h"
+
+#include <atomic>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+const char nullDevice[] = "NUL";
+#else
+const char nullDevice[] = "/dev/null";
+#endif
+
+atomic<size_t> allocations {0};   // Calls of operator new
+
+void* CountedAllocation (size_t size, size_t alignment = 0) {
+    ++allocations;
+
+    if (size == 0)
+        size = 1;
+
+    void* memory = nullptr;
+#if defined(_WIN32)
+    memory = alignment ? _aligned_malloc(size, alignment) : malloc(size);
+#else
+    if (alignment)
+        memory = (0 == posix_memalign(&memory, max(alignment, sizeof(void*)), size)) ? memory : nullptr;
+    else
+        memory = malloc(size);
+#endif
+
+    return memory;
+}
+
+void CountedFree (void* memory, bool aligned = false) {
+#if defined(_WIN32)
+    if (aligned) {
+        _aligned_free(memory);
+        return;
+    }
+#else
+    (void) aligned;
+#endif
+    free(memory);
+}
+
+void* operator new (size_t size) {
+    if (auto memory = CountedAllocation(size))
+        return memory;
+    throw bad_alloc();
+}
+
+void* operator new[] (size_t size) {
+    if (auto memory = CountedAllocation(size))
+        return memory;
+    throw bad_alloc();
+}
+
+void* operator new (size_t size, align_val_t alignment) {
+    if (auto memory = CountedAllocation(size, static_cast<size_t>(alignment)))
+        return memory;
+    throw bad_alloc();
+}
+
+void* operator new[] (size_t size, align_val_t alignment) {
+    if (auto memory = CountedAllocation(size, static_cast<size_t>(alignment)))
+        return memory;
+    throw bad_alloc();
+}
+
+void* operator new (size_t size, const nothrow_t&) noexcept { return CountedAllocation(size); }
+void* operator new[] (size_t size, const nothrow_t&) noexcept { return CountedAllocation(size); }
+
+void operator delete (void* memory) noexcept { CountedFree(memory); }
+void operator delete[] (void* memory) noexcept { CountedFree(memory); }
+void operator delete (void* memory, size_t) noexcept { CountedFree(memory); }
+void operator delete[] (void* memory, size_t) noexcept { CountedFree(memory); }
+void operator delete (void* memory, align_val_t) noexcept { CountedFree(memory, true); }
+void operator delete[] (void* memory, align_val_t) noexcept { CountedFree(memory, true); }
+void operator delete (void* memory, size_t, align_val_t) noexcept { CountedFree(memory, true); }
+void operator delete[] (void* memory, size_t, align_val_t) noexcept { CountedFree(memory, true); }
+void operator delete (void* memory, const nothrow_t&) noexcept { CountedFree(memory); }
+void operator delete[] (void* memory, const nothrow_t&) noexcept { CountedFree(memory); }
+
+
+struct Refresh {
+    // One refresh cycle, with the buffers that are kept from one cycle to the next.
+
+    CommandOptions    options;
+    DriveCollector    collector;
+    vector<DriveInfo> drives;
+    vector<DriveRow>  rows;
+    MetricsBuffer     metrics {64 * 1024};
+
+    size_t Run (bool verbose) {
+        // Collect and render the drives. Returns the number of drives.
+
+        options.printVerbose = verbose;
+
+        CHECK(DRIVES_OK == collector.Collect(drives));
+
+        PrintResultsHuman(options, drives);
+        PrintResultsJSON(drives);
+
+        rows.clear();
+        for (const auto& drive : drives)
+            rows.emplace_back(nullptr, &drive);
+
+        metrics.Clear();
+        RenderPrometheus(metrics, rows);
+        fwrite(metrics.Text().data(), 1, metrics.Text().length(), stdout);
+        fflush(stdout);
+
+        return drives.size();
+    }
+};
+
+int main () {
+    // Set up output as the program's main() does. The output itself isn't checked.
+
+#if !defined(_WIN32)
+    setlocale(LC_ALL, "");
+    if (0 != strcmp(nl_langinfo(CODESET), "UTF-8"))
+        setlocale(LC_CTYPE, "C.UTF-8");
+#endif
+
+    if (!freopen(nullDevice, "w", stdout)) {
+        fprintf(stderr, "Unable to discard output\n");
+        return 1;
+    }
+
+    Refresh refresh;
+
+    // The first cycles grow the buffers (in verbose mode too, which prints more). That they allocate
+    // shows that the counting operator new is in use.
+
+    refresh.Run(false);
+    refresh.Run(true);
+    CHECK(allocations > 0);
+
+    for (const bool verbose : { false, true }) {
+        allocations = 0;
+        const auto drives = refresh.Run(verbose);
+        const size_t counted = allocations;
+
+        fprintf(stderr, "%s refresh of %zu drives: %zu allocations\n", verbose ? "Verbose" : "Plain", drives, counted);
+        CHECK(counted == 0);
+    }
+
+    return TestResult();
+}
@@ -0,0 +1,135 @@
+//==================================================================================================
+//
+//  test-cached
+//
+//  Tests the --cached scan's mincore(2) fallback, as used on kernels without cachestat(2), which is
+//  forced here. Since Linux 5.2, mincore() reports no resident pages for files the caller neither
+//  owns nor can write, so an unprivileged scan must count those as unmeasured rather than as not
+//  cached. The scan runs as root and, in a child process, as user nobody (65534), over a root-owned
+//  0644 file and a file owned by nobody, both in the page cache. A measured file must not be left
+//  mapped, which would keep it pinned. Needs root, and is skipped without it.
+//
+//==================================================================================================
+
+#include "../drives-cached.h"
+#include "check.h"
+
+#include <sys/wait.h>
+
+#include <fstream>
+
+const uid_t    nobody   = 65534;
+const uint64_t fileSize = 256 * 1024;
+
+
+bool WriteFile (const string& path, uid_t owner) {
+    // Write a file, which leaves its pages in the page cache, owned by the given user.
+
+    const auto file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0)
+        return false;
+
+    vector<char> data (fileSize, 'x');
+    const bool ok = static_cast<ssize_t>(data.size()) == write(file, data.data(), data.size())
+                 && 0 == fchown(file, owner, owner);
+
+    close(file);
+    return ok;
+}
+
+bool Mapped (const string& path) {
+    // Returns true if the file is mapped into this process.
+
+    ifstream maps {"/proc/self/maps"};
+    string line;
+    while (getline(maps, line)) {
+        if (line.size() >= path.size() && 0 == line.compare(line.size() - path.size(), path.size(), path))
+            return true;
+    }
+    return false;
+}
+
+void TestWindowRecovery (const string& path) {
+    // A failed mapping leaves the scanner able to map the next file, and no file stays mapped.
+
+    PageResidency residency;
+    uint64_t cached;
+
+    const auto writeOnly = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    CHECK(!residency.CachedBytes(writeOnly, fileSize, cached));
+    close(writeOnly);
+
+    const auto file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    CHECK(residency.CachedBytes(file, fileSize, cached));
+    CHECK(cached == fileSize);
+    close(file);
+
+    CHECK(!Mapped(path));
+}
+
+int ScanAsNobody (const string& directory) {
+    // Scan as user nobody, who can measure only its own file. Returns the test result.
+
+    if (0 != setgid(nobody) || 0 != setuid(nobody)) {
+        perror("setuid");
+        return 1;
+    }
+
+    CacheScan scan {0};
+    CHECK(scan.Run(directory));
+
+    const auto& root = scan.Directories()[0];
+    CHECK(scan.Unreadable() == 0);
+    CHECK(scan.Unmeasured() == 1);
+    CHECK(root.unmeasured == fileSize);
+    CHECK(root.inFiles == fileSize);
+    CHECK(root.cached == fileSize);
+
+    return TestResult();
+}
+
+int main () {
+    if (geteuid() != 0) {
+        printf("Skipped: needs root\n");
+        return testSkipped;
+    }
+
+    cachestatMissing = true;
+
+    char directory[] = "/tmp/drives-test-XXXXXX";
+    if (!mkdtemp(directory) || 0 != chmod(directory, 0755)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const auto rootFile   = string(directory) + "/root-owned";
+    const auto nobodyFile = string(directory) + "/nobody-owned";
+    CHECK(WriteFile(rootFile, 0) && WriteFile(nobodyFile, nobody));
+
+    TestWindowRecovery(rootFile);
+
+    // As root, both files are measured.
+
+    CacheScan scan {0};
+    CHECK(scan.Run(directory));
+    CHECK(scan.Unmeasured() == 0);
+    CHECK(scan.Directories()[0].inFiles == 2 * fileSize);
+    CHECK(scan.Directories()[0].cached == 2 * fileSize);
+
+    // As nobody, in a child process, the root-owned file is unmeasured.
+
+    fflush(stdout);
+    const pid_t child = fork();
+    if (child == 0)
+        _exit(ScanAsNobody(directory));
+
+    int status;
+    CHECK(child == waitpid(child, &status, 0));
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    unlink(rootFile.c_str());
+    unlink(nobodyFile.c_str());
+    rmdir(directory);
+
+    return TestResult();
+}
@@ -0,0 +1,251 @@
+//==================================================================================================
+//
+//  test-check
+//
+//  Benchmarks --check with thousands of rules against tens of thousands of simulated mounts, and
+//  checks every result against a direct evaluation of all rules: the status, and the first rule in
+//  the file with that status. The rules mix indexed text conditions on one and two fields, text-only
+//  rules, one- and two-threshold groups, text and numeric != conditions, and rules with two text !=
+//  conditions, which are evaluated in full. Some volumes have no capacity information, so that no
+//  numeric condition holds for them. The compiled rules must check the volumes several times faster
+//  than the direct evaluation.
+//
+//==================================================================================================
+
+#include "../drives-check.h"
+#include "check.h"
+
+const size_t ruleCount   = 3000;
+const size_t volumeCount = 30000;
+const int    fsCount     = 40;
+const int    labelCount  = 2000;
+const double minSpeedup  = 6;   // Of the compiled rules over the direct evaluation
+
+
+uint32_t Random () {
+    // A fixed pseudo-random sequence, so that runs are repeatable.
+    static uint32_t state = 12345;
+    state = state * 1664525 + 1013904223;
+    return state >> 8;
+}
+
+struct TestCondition {
+    CheckField field;
+    CheckOp    op;
+    wstring    text;
+    double     number;
+};
+
+struct TestRule {
+    vector<TestCondition> conditions;
+    CheckStatus           status;
+};
+
+bool Holds (const TestRule& rule, const DriveInfo& drive) {
+    // Evaluate a rule directly. Comparisons with an unknown (NaN) value are all false.
+
+    for (const auto& condition : rule.conditions) {
+        bool holds;
+        if (static_cast<size_t>(condition.field) < checkTextFieldCount) {
+            holds = (condition.text == drive.CheckText(condition.field)) == (condition.op == CheckOp::Equal);
+        } else {
+            const auto value = drive.CheckNumber(condition.field);
+            switch (condition.op) {
+                case CheckOp::Less:         holds = value <  condition.number;  break;
+                case CheckOp::LessEqual:    holds = value <= condition.number;  break;
+                case CheckOp::Greater:      holds = value >  condition.number;  break;
+                case CheckOp::GreaterEqual: holds = value >= condition.number;  break;
+                case CheckOp::Equal:        holds = value == condition.number;  break;
+                default:                    holds = !isnan(value) && value != condition.number;  break;
+            }
+        }
+
+        if (!holds)
+            return false;
+    }
+
+    return true;
+}
+
+wstring MountPoint (uint32_t n) { return L"/mnt/volume-" + to_wstring(n % volumeCount); }
+wstring FileSystem (uint32_t n) { return L"fs" + to_wstring(n % fsCount); }
+wstring Label (uint32_t n)      { return L"label " + to_wstring(n % labelCount); }
+wstring TypeName (uint32_t n)   { return drives_type_name(static_cast<DrivesType>(n % 7)); }
+
+vector<DriveInfo> TestVolumes () {
+    vector<DriveInfo> drives;
+    drives.reserve(volumeCount);
+
+    for (size_t i = 0;  i < volumeCount;  ++i) {
+        DrivesVolume volume;
+        memset(&volume, 0, sizeof volume);
+
+        volume.fields          = DRIVES_FIELD_ALL;
+        volume.type            = static_cast<DrivesType>(Random() % 7);
+        volume.volumeInfoValid = 1;
+        wcscpy(volume.root, MountPoint(static_cast<uint32_t>(i)).c_str());
+        wcscpy(volume.fileSystem, FileSystem(Random()).c_str());
+        wcscpy(volume.label, Label(Random()).c_str());
+
+        // One in twenty volumes has no capacity information.
+
+        if (Random() % 20) {
+            volume.sectorsPerCluster = 8;
+            volume.bytesPerSector    = 512;
+            volume.clustersTotal     = 1 + Random() % (1 << 22);
+            volume.clustersFree      = Random() % (volume.clustersTotal + 1);
+            volume.bytesTotal        = static_cast<int64_t>(volume.clustersTotal * 4096);
+            volume.bytesFree         = static_cast<int64_t>(volume.clustersFree * 4096);
+        }
+
+        drives.emplace_back(volume);
+    }
+
+    return drives;
+}
+
+vector<TestRule> TestRules (const string& path) {
+    // Generate the rules, and write them to the given rules file.
+
+    const wchar_t* const opNames[] = { L"<", L"<=", L">", L">=", L"==", L"!=" };
+
+    vector<TestRule> rules (ruleCount);
+    wofstream file {path};
+
+    for (auto& rule : rules) {
+        rule.status = (Random() % 3) ? CheckStatus::Warning : CheckStatus::Critical;
+
+        const auto percent = static_cast<double>(Random() % 100);
+        const auto bytes   = static_cast<double>(Random() % 16) * 1024 * 1024 * 1024;
+
+        switch (Random() % 10) {
+            case 0:
+                rule.conditions = { { CheckField::FileSystem, CheckOp::Equal, FileSystem(Random()), 0 },
+                                    { CheckField::PercentFree, CheckOp::Less, L"", percent } };
+                break;
+            case 1:
+                rule.conditions = { { CheckField::DriveType, CheckOp::Equal, TypeName(Random()), 0 },
+                                    { CheckField::Label, CheckOp::Equal, Label(Random()), 0 },
+                                    { CheckField::FreeBytes, CheckOp::LessEqual, L"", bytes } };
+                break;
+            case 2:
+                rule.conditions = { { CheckField::PercentFree, CheckOp::Greater, L"", percent },
+                                    { CheckField::CapacityBytes, CheckOp::Less, L"", bytes / 64 } };
+                break;
+            case 3:
+                rule.conditions = { { CheckField::FileSystem, CheckOp::NotEqual, FileSystem(Random()), 0 },
+                                    { CheckField::PercentFree, CheckOp::NotEqual, L"", percent },
+                                    { CheckField::CapacityBytes, CheckOp::Less, L"", bytes / 1024 } };
+                break;
+            case 4:
+                rule.conditions = { { CheckField::Label, CheckOp::Equal, Label(Random()), 0 },
+                                    { CheckField::FileSystem, CheckOp::Equal, FileSystem(Random()), 0 } };
+                break;
+            case 5:
+                // Holds for all volumes with this label, except those with no capacity information.
+                rule.conditions = { { CheckField::Label, CheckOp::Equal, Label(Random()), 0 },
+                                    { CheckField::PercentFree, CheckOp::NotEqual, L"", -1 } };
+                break;
+            case 6:
+                rule.conditions = { { CheckField::FileSystem, CheckOp::NotEqual, FileSystem(Random()), 0 },
+                                    { CheckField::DriveType, CheckOp::Equal, TypeName(Random()), 0 },
+                                    { CheckField::CapacityBytes, CheckOp::Less, L"", bytes / 1024 } };
+                break;
+            case 7:
+                rule.conditions = { { CheckField::Label, CheckOp::Equal, Label(Random()), 0 },
+                                    { CheckField::FileSystem, CheckOp::NotEqual, FileSystem(Random()), 0 },
+                                    { CheckField::DriveType, CheckOp::NotEqual, TypeName(Random()), 0 } };
+                break;
+            case 8:
+                rule.conditions = { { CheckField::MountPoint, CheckOp::Equal, MountPoint(Random()), 0 } };
+                break;
+            default:
+                rule.conditions = { { CheckField::CapacityBytes, CheckOp::GreaterEqual, L"", bytes },
+                                    { CheckField::PercentFree, CheckOp::LessEqual, L"", percent / 100 } };
+                break;
+        }
+
+        for (size_t i = 0;  i < rule.conditions.size();  ++i) {
+            const auto& condition = rule.conditions[i];
+            const auto  name = find_if(begin(checkFieldNames), end(checkFieldNames),
+                [&](const auto& entry) { return entry.field == condition.field; })->name;
+
+            file << (i ? L" and " : L"") << name << L' ' << opNames[static_cast<int>(condition.op)] << L' ';
+            if (static_cast<size_t>(condition.field) < checkTextFieldCount)
+                file << L'"' << condition.text << L'"';
+            else
+                file << setprecision(17) << condition.number;
+        }
+
+        file << ((rule.status == CheckStatus::Warning) ? L" => warning\n" : L" => critical\n");
+    }
+
+    return rules;
+}
+
+int main () {
+    const char path[] = "test-check.rules";   // In the working directory: under ctest, the build directory
+
+    const auto drives    = TestVolumes();
+    const auto testRules = TestRules(path);
+
+    CommandOptions options;
+    options.checkRulesPath = FromUTF8(path);
+
+    CheckRules rules;
+    const bool loaded = rules.Load(options);
+    remove(path);
+
+    CHECK(loaded);
+    if (!loaded)
+        return TestResult();
+
+    // Check all volumes with the compiled rules, and then directly.
+
+    vector<CheckStatus> statuses (drives.size());
+    vector<int>         lines (drives.size());
+
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0;  i < drives.size();  ++i) {
+        const CheckRule* failed;
+        statuses[i] = rules.Check(drives[i], failed);
+        lines[i]    = failed ? failed->line : 0;
+    }
+    const auto compiled = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // The status must be the worst of the rules that hold, and the reported rule the first of those
+    // with that status.
+
+    size_t mismatches = 0, failing = 0;
+
+    start = chrono::steady_clock::now();
+    for (size_t i = 0;  i < drives.size();  ++i) {
+        auto status = CheckStatus::OK;
+        int  line   = 0;
+
+        for (size_t rule = 0;  rule < testRules.size();  ++rule) {
+            if (testRules[rule].status > status && Holds(testRules[rule], drives[i])) {
+                status = testRules[rule].status;
+                line   = static_cast<int>(rule + 1);
+            }
+        }
+
+        failing += status != CheckStatus::OK;
+        if (status != statuses[i] || line != lines[i]) {
+            if (++mismatches <= 5) {
+                fprintf(stderr, "Volume %zu: expected status %d (line %d), got %d (line %d)\n",
+                        i, static_cast<int>(status), line, static_cast<int>(statuses[i]), lines[i]);
+            }
+        }
+    }
+    const auto direct = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    CHECK(mismatches == 0);
+    CHECK(failing > 0 && failing < drives.size());
+    CHECK(compiled * minSpeedup < direct);
+
+    printf("Checked %zu volumes against %zu rules: compiled %.3f s, direct %.3f s; %zu failing\n",
+           drives.size(), testRules.size(), compiled, direct, failing);
+
+    return TestResult();
+}
@@ -0,0 +1,98 @@
+//==================================================================================================
+//
+//  test-device-names
+//
+//  Tests the Linux backend's lookup of device names from a /dev/disk/by-* style directory, including
+//  directories with more names than its table holds. The directories are built from symbolic links
+//  to two of the machine's block devices.
+//
+//==================================================================================================
+
+#include "../libdrives-linux.cpp"
+#include "check.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+vector<string> BlockDevices () {
+    // Returns the paths of up to two block devices of distinct device numbers.
+
+    vector<string> devices;
+    vector<dev_t>  numbers;
+
+    if (auto dev = opendir("/dev")) {
+        while (auto entry = readdir(dev)) {
+            const auto path = string("/dev/") + entry->d_name;
+            struct stat info;
+            if (devices.size() < 2 && 0 == stat(path.c_str(), &info) && S_ISBLK(info.st_mode)
+                && find(numbers.begin(), numbers.end(), info.st_rdev) == numbers.end()) {
+                devices.push_back(path);
+                numbers.push_back(info.st_rdev);
+            }
+        }
+        closedir(dev);
+    }
+
+    return devices;
+}
+
+void TestDirectory (const string& directory, const vector<string>& devices, int fillerCount) {
+    // Link fillerCount names to the first device, and one escaped name to the second, midway. (On
+    // tmpfs, directories list in creation order or its reverse, so the midway name is beyond the
+    // table's capacity when there are enough fillers.)
+
+    for (int i = 0;  i < fillerCount;  ++i) {
+        if (i == fillerCount / 2) {
+            const auto link = directory + "/second\\x20device";
+            CHECK(0 == symlink(devices[1].c_str(), link.c_str()));
+        }
+
+        const auto link = directory + "/filler-" + to_string(i);
+        CHECK(0 == symlink(devices[0].c_str(), link.c_str()));
+    }
+
+    DeviceNames names {directory.c_str()};
+
+    auto name = names.Find(devices[1].c_str());
+    CHECK(name && 0 == strcmp(name, "second device"));
+
+    name = names.Find(devices[0].c_str());
+    CHECK(name && 0 == strncmp(name, "filler-", 7));
+
+    CHECK(nullptr == names.Find("server:/export"));
+    CHECK(nullptr == names.Find("/dev/no-such-device"));
+
+    // Look up the second device again, after the first.
+    name = names.Find(devices[1].c_str());
+    CHECK(name && 0 == strcmp(name, "second device"));
+}
+
+int main () {
+    const auto devices = BlockDevices();
+    if (devices.size() < 2) {
+        printf("Skipped: needs two block devices\n");
+        return testSkipped;
+    }
+
+    for (const int fillerCount : { 3, 300 }) {
+        char directory[] = "/dev/shm/drives-test-XXXXXX";
+        if (!mkdtemp(directory) && !mkdtemp(strcpy(directory, "/tmp/drives-test-XXXXXX"))) {
+            perror("mkdtemp");
+            return 1;
+        }
+
+        TestDirectory(directory, devices, fillerCount);
+
+        const auto command = string("rm -rf ") + directory;
+        if (0 != system(command.c_str()))
+            return 1;
+    }
+
+    return TestResult();
+}
@@ -0,0 +1,252 @@
+//==================================================================================================
+//
+//  test-fleet
+//
+//  Runs a simulated fleet on the loopback address: one `drives --agent` process answers promptly on
+//  a range of ports, and another answers on a second range only after more than the query timeout.
+//  A `drives --hosts` query of both ranges (plus a port with no agent and a malformed address) must
+//  report the prompt hosts, time out the slow ones, and finish within about one timeout.
+//
+//  Usage: test-fleet <path of drives executable>
+//
+//==================================================================================================
+
+#include "check.h"
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #include <windows.h>
+    #include <process.h>
+#else
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <signal.h>
+    #include <spawn.h>
+    #include <sys/socket.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#if defined(_WIN32)
+    using Process = intptr_t;   // Process handle, as returned by _spawnv()
+
+    #define getpid _getpid
+    #define popen  _popen
+    #define pclose _pclose
+#else
+    using Process = pid_t;
+
+    extern char** environ;
+#endif
+
+const int fastHosts  = 8;
+const int slowHosts  = 4;
+const int timeoutMs  = 1000;
+const int slowDelay  = 3000;   // Reply delay of the slow agent, beyond the timeout
+
+const char errorsPath[] = "test-fleet.errors";   // In the working directory: under ctest, the build directory
+
+
+Process Spawn (const vector<string>& arguments) {
+    // Start a process with the given arguments. Returns its process ID (or handle), or -1 on failure.
+
+    vector<char*> argv;
+    for (const auto& argument : arguments)
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+
+#if defined(_WIN32)
+    return _spawnv(_P_NOWAIT, argv[0], argv.data());
+#else
+    pid_t pid;
+    return (0 == posix_spawn(&pid, argv[0], nullptr, nullptr, argv.data(), environ)) ? pid : -1;
+#endif
+}
+
+bool Exited (Process process) {
+    // Returns true if the process has exited.
+
+#if defined(_WIN32)
+    return WAIT_OBJECT_0 == WaitForSingleObject(reinterpret_cast<HANDLE>(process), 0);
+#else
+    int status;
+    return process == waitpid(process, &status, WNOHANG);
+#endif
+}
+
+void Stop (Process process) {
+    // Stop the process, and wait for it to exit.
+
+#if defined(_WIN32)
+    TerminateProcess(reinterpret_cast<HANDLE>(process), 1);
+    WaitForSingleObject(reinterpret_cast<HANDLE>(process), INFINITE);
+    CloseHandle(reinterpret_cast<HANDLE>(process));
+#else
+    kill(process, SIGTERM);
+    waitpid(process, nullptr, 0);
+#endif
+}
+
+bool Accepting (int port) {
+    // Returns true if something accepts connections on the loopback port.
+
+    const auto socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address {};
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const bool accepting = 0 == connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof address);
+#if defined(_WIN32)
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+    return accepting;
+}
+
+bool StartAgents (const string& drives, int basePort, vector<Process>& agents) {
+    // Start the prompt agent on ports basePort onward, and the slow agent on the ports after it.
+    // Returns true once both are accepting connections on all their ports.
+
+    const auto fastRange = to_string(basePort) + "-" + to_string(basePort + fastHosts - 1);
+    const auto slowRange = to_string(basePort + fastHosts) + "-" + to_string(basePort + fastHosts + slowHosts - 1);
+
+    agents.push_back(Spawn({drives, "--agent", "127.0.0.1:" + fastRange}));
+    agents.push_back(Spawn({drives, "--agent", "127.0.0.1:" + slowRange, "--agent-delay", to_string(slowDelay)}));
+
+    for (int attempt = 0;  attempt < 100;  ++attempt) {
+        for (auto agent : agents) {
+            if (agent == -1 || Exited(agent))
+                return false;   // The agent could not listen (for example, because a port is taken).
+        }
+
+        bool accepting = true;
+        for (int port = basePort;  accepting && port < basePort + fastHosts + slowHosts;  ++port)
+            accepting = Accepting(port);
+
+        if (accepting)
+            return true;
+
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+
+    return false;
+}
+
+void StopAgents (vector<Process>& agents) {
+    for (auto agent : agents) {
+        if (agent != -1)
+            Stop(agent);
+    }
+    agents.clear();
+}
+
+string ReadFile (const string& path) {
+    ifstream file {path};
+    stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+int main (int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: test-fleet <drives executable>\n");
+        return 1;
+    }
+
+#if defined(_WIN32)
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    const string drives = argv[1];
+
+    // Find a free range of ports for the agents.
+
+    vector<Process> agents;
+    int basePort = 0;
+
+    for (int attempt = 0;  attempt < 5 && !basePort;  ++attempt) {
+        const int port = 20000 + static_cast<int>((getpid() * 7 + attempt * 997) % 40000);
+        if (StartAgents(drives, port, agents))
+            basePort = port;
+        else
+            StopAgents(agents);
+    }
+
+    if (!basePort) {
+        printf("Skipped: unable to start agents on the loopback address\n");
+        return testSkipped;
+    }
+
+    const int refusedPort = basePort + fastHosts + slowHosts;
+
+    string hosts = "[::1";  // Malformed
+    for (int port = basePort;  port <= refusedPort;  ++port)
+        hosts += ",127.0.0.1:" + to_string(port);
+
+    auto command = "\"" + drives + "\" --json --timeout " + to_string(timeoutMs) + " --hosts \"" + hosts + "\" 2>"
+                 + errorsPath;
+#if defined(_WIN32)
+    command = "\"" + command + "\"";   // cmd.exe strips the outer quotes
+#endif
+
+    const auto start = chrono::steady_clock::now();
+
+    string output;
+    auto query = popen(command.c_str(), "r");
+    char buffer[4096];
+    size_t count;
+    while (0 < (count = fread(buffer, 1, sizeof buffer, query)))
+        output.append(buffer, count);
+    const int status = pclose(query);
+
+    const auto elapsedMs = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+    StopAgents(agents);
+
+    const auto errorText = ReadFile(errorsPath);
+    remove(errorsPath);
+
+    // Failed hosts make the query exit with status 1, after all hosts are reported.
+
+#if defined(_WIN32)
+    CHECK(status == 1);
+#else
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+#endif
+
+    for (int port = basePort;  port < refusedPort;  ++port) {
+        const auto host   = "127.0.0.1:" + to_string(port);
+        const bool isFast = port < basePort + fastHosts;
+
+        CHECK(isFast == (output.find("\"host\": \"" + host + "\"") != string::npos));
+        CHECK(isFast != (errorText.find(host + ": timed out.") != string::npos));
+    }
+
+    CHECK(errorText.find("127.0.0.1:" + to_string(refusedPort) + ": connection refused.") != string::npos);
+    CHECK(errorText.find("[::1: invalid host address.") != string::npos);
+
+    // All hosts are queried at once, so the query takes about one timeout, not one per slow host.
+
+    CHECK(elapsedMs >= timeoutMs);
+    CHECK(elapsedMs < timeoutMs + slowDelay / 2);
+
+    printf("Queried %d hosts in %lld ms\n", fastHosts + slowHosts + 2, static_cast<long long>(elapsedMs));
+
+    if (TestFailures())
+        fprintf(stderr, "Output:\n%s\nErrors:\n%s\n", output.c_str(), errorText.c_str());
+
+    return TestResult();
+}
@@ -0,0 +1,171 @@
+//==================================================================================================
+//
+//  test-frag
+//
+//  Tests the --frag scan on a loop-mounted ext4 file system with 4 KiB blocks, made in a private
+//  mount namespace. Files are written whole, flushed so that each one's blocks are allocated in one
+//  run, and then fragmented by punching holes, which gives known extent counts:
+//
+//    - every-other   2 MiB, every other block punched: 256 extents
+//    - every-fourth  2 MiB, every fourth block punched: 128 extents
+//    - contiguous    1 MiB, untouched: 1 extent
+//    - small         64 KiB, every other block punched: 8 extents, but too small to be listed among
+//                    the most fragmented files
+//
+//  The totals and the order of the most fragmented files must match. Needs root and mkfs.ext4, and is
+//  skipped without them.
+//
+//==================================================================================================
+
+#include "../drives-frag.h"
+#include "check.h"
+
+#include <linux/falloc.h>
+#include <sched.h>
+#include <sys/mount.h>
+
+const off_t blockSize = 4096;
+
+struct TestFile {
+    const char* name;
+    int         blocks;     // Size in blocks
+    int         punchEvery; // Punch the last block of every so many, or 0 for none
+    uint64_t    extents;    // Extents expected
+};
+
+const TestFile testFiles[] = {
+    { "every-other",  512, 2, 256 },
+    { "every-fourth", 512, 4, 128 },
+    { "contiguous",   256, 0, 1 },
+    { "small",        16,  2, 8 },
+};
+
+
+bool WriteFile (const string& path, const TestFile& test) {
+    // Write the file, and flush it so that its blocks are allocated, in one run.
+
+    const auto file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0)
+        return false;
+
+    vector<char> data (static_cast<size_t>(test.blocks * blockSize), 'x');
+    const bool ok = static_cast<ssize_t>(data.size()) == write(file, data.data(), data.size()) && 0 == fsync(file);
+
+    close(file);
+    return ok;
+}
+
+bool PunchHoles (const string& path, const TestFile& test) {
+    // Punch out the file's holes, keeping its size.
+
+    const auto file = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (file < 0)
+        return false;
+
+    bool ok = true;
+    for (int block = test.punchEvery - 1;  ok && test.punchEvery && block < test.blocks;  block += test.punchEvery)
+        ok = 0 == fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, block * blockSize, blockSize);
+
+    ok = ok && 0 == fsync(file);
+    close(file);
+    return ok;
+}
+
+bool MountExt4 (const string& image, const string& directory) {
+    // Make an ext4 file system in the image file, and loop-mount it at the directory in a private
+    // mount namespace. Returns false if that can't be done here.
+
+    if (0 != unshare(CLONE_NEWNS) || 0 != mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr))
+        return false;
+
+    const auto command = "truncate -s 32M '" + image + "' && mkfs.ext4 -q -F -b 4096 '" + image
+                       + "' 2>/dev/null && mount -o loop '" + image + "' '" + directory + "' 2>/dev/null";
+    return 0 == system(command.c_str());
+}
+
+void TestScan (const string& directory) {
+    // Write all files before punching any holes, which the allocator would otherwise fill.
+
+    for (const auto& test : testFiles)
+        CHECK(WriteFile(directory + "/" + test.name, test));
+
+    uint64_t files = 0, fragmented = 0, extents = 0;
+    for (const auto& test : testFiles) {
+        CHECK(PunchHoles(directory + "/" + test.name, test));
+        files      += 1;
+        fragmented += test.extents > 1;
+        extents    += test.extents;
+    }
+
+    // All files are counted, with their extents.
+
+    FragScan scan {10};
+    CHECK(scan.Run(directory));
+    CHECK(!scan.Unsupported());
+
+    const auto& totals = scan.Totals();
+    CHECK(totals.unreadable == 0);
+    CHECK(totals.files == files);
+    CHECK(totals.fragmented == fragmented);
+    CHECK(totals.extents == extents);
+
+    // The most fragmented files are the two fragmented ones of 1 MiB or more, most extents first.
+
+    const auto worst = scan.MostFragmented();
+    CHECK(worst.size() == 2);
+
+    for (size_t i = 0;  i < worst.size() && i < 2;  ++i) {
+        const auto& test = testFiles[i];
+        CHECK(worst[i].path == directory + "/" + test.name);
+        CHECK(worst[i].extents == test.extents);
+        CHECK(worst[i].size == static_cast<uint64_t>(test.blocks * blockSize));
+    }
+
+    // A scan for the single most fragmented file finds only that one.
+
+    FragScan topScan {1};
+    CHECK(topScan.Run(directory));
+    const auto top = topScan.MostFragmented();
+    CHECK(top.size() == 1 && top[0].extents == testFiles[0].extents);
+
+    if (TestFailures()) {
+        for (const auto& file : worst)
+            fprintf(stderr, "%s: %llu extents\n", file.path.c_str(), static_cast<unsigned long long>(file.extents));
+        fprintf(stderr, "Totals: %llu files, %llu fragmented, %llu extents\n",
+                static_cast<unsigned long long>(totals.files), static_cast<unsigned long long>(totals.fragmented),
+                static_cast<unsigned long long>(totals.extents));
+    }
+}
+
+int main () {
+    if (geteuid() != 0) {
+        printf("Skipped: needs root\n");
+        return testSkipped;
+    }
+
+    char base[] = "/tmp/drives-test-XXXXXX";
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const auto image     = string(base) + "/ext4.img";
+    const auto directory = string(base) + "/mnt";
+    CHECK(0 == mkdir(directory.c_str(), 0755));
+
+    const bool mounted = MountExt4(image, directory);
+    if (mounted) {
+        TestScan(directory);
+        CHECK(0 == umount(directory.c_str()));
+    }
+
+    const auto cleanup = string("rm -rf ") + base;
+    CHECK(0 == system(cleanup.c_str()));
+
+    if (!mounted) {
+        printf("Skipped: unable to make and loop-mount an ext4 file system\n");
+        return testSkipped;
+    }
+
+    return TestResult();
+}
@@ -0,0 +1,253 @@
+//==================================================================================================
+//
+//  test-history
+//
+//  Benchmarks the history store with a million samples (5,000 runs of 200 volumes, a minute apart):
+//  appending the runs, decoding the whole store, and a thousand one-hour range queries, each checked
+//  against the values recorded. A span that starts exactly at the time of an index record must
+//  include that run's samples. Finally, several processes append to one store at once, and no run
+//  may be lost.
+//
+//==================================================================================================
+
+#include "../drives-history.h"
+#include "check.h"
+
+#include <set>
+#include <sys/wait.h>
+
+const size_t  volumeCount = 200;
+const size_t  runCount    = 5000;
+const size_t  queryCount  = 1000;
+const int64_t startTime   = 1'790'000'000'000;   // ms since the epoch, in 2026
+const int64_t runInterval = 60'000;
+const int64_t totalBytes  = int64_t{1} << 40;
+
+const int    appenderCount   = 4;     // Processes appending at once
+const size_t appenderRuns    = 250;   // Runs appended by each
+const size_t appenderVolumes = 2;
+
+
+int64_t RunTime (size_t run) { return startTime + static_cast<int64_t>(run) * runInterval; }
+
+int64_t FreeBytes (size_t volume, size_t run) {
+    // The free space recorded for a volume in a run: mostly small changes, with the odd large one.
+    const auto hash = (volume * 2654435761u) ^ (run * 40503u);
+    return totalBytes / 2 + static_cast<int64_t>(hash % 1'000'000) * ((run % 97) ? 1 : 4096);
+}
+
+vector<DriveInfo> RunDrives (size_t run, size_t count) {
+    // Returns the volumes as probed in the given run.
+
+    vector<DriveInfo> drives;
+
+    for (size_t i = 0;  i < count;  ++i) {
+        DrivesVolume volume;
+        memset(&volume, 0, sizeof volume);
+
+        volume.fields            = DRIVES_FIELD_ALL;
+        volume.type              = DRIVES_TYPE_FIXED;
+        volume.volumeInfoValid   = 1;
+        volume.sectorsPerCluster = 8;
+        volume.bytesPerSector    = 512;
+        volume.clustersTotal     = static_cast<uint64_t>(totalBytes / 4096);
+        volume.bytesTotal        = totalBytes;
+        volume.bytesFree         = FreeBytes(i, run);
+        swprintf(volume.root, DRIVES_MAX_STRING, L"/mnt/volume-%zu", i);
+        swprintf(volume.volumeId, DRIVES_MAX_STRING, L"uuid-%zu", i);
+
+        drives.emplace_back(volume);
+    }
+
+    return drives;
+}
+
+size_t Query (HistoryStore& store, int64_t from, int64_t to, size_t& wrong) {
+    // Decode the samples in the span, as --history does, counting those with values other than
+    // those recorded. Returns the number of samples.
+
+    size_t samples = 0;
+
+    store.Decode(store.StartBefore(from), to, [&](size_t volume, int64_t time, int64_t total, int64_t free) {
+        if (time < from || time > to)
+            return;
+        ++samples;
+
+        const auto run = static_cast<size_t>((time - startTime) / runInterval);
+        if (time != RunTime(run) || total != totalBytes || free != FreeBytes(volume, run))
+            ++wrong;
+    });
+
+    return samples;
+}
+
+vector<int64_t> IndexTimes (const NativePath& path, uint64_t lastIndex) {
+    // Returns the times of the store's index records, following their chain back from the last.
+
+    vector<int64_t> times;
+    MappedFile      file;
+    StoreRecord     record;
+
+    CHECK(file.Open(path));
+
+    for (auto offset = lastIndex;  offset && ReadRecordAt(file, offset, record) && record.type == 'I';  ) {
+        PayloadReader reader {record.payload, record.length};
+        times.push_back(static_cast<int64_t>(reader.Varint()));
+        offset = reader.Varint();
+    }
+
+    return times;
+}
+
+double Seconds (chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void TestMillionSamples (const NativePath& path) {
+    // Append the runs, one store update each, as drives --record does.
+
+    auto start = chrono::steady_clock::now();
+    for (size_t run = 0;  run < runCount;  ++run) {
+        wstring error;
+        if (!HistoryStore().Append(path, RunDrives(run, volumeCount), RunTime(run), error)) {
+            fprintf(stderr, "Run %zu: %ls\n", run, error.c_str());
+            CHECK(false);
+            return;
+        }
+    }
+    const auto appendSeconds = Seconds(start);
+
+    HistoryStore store;
+    wstring      error;
+    CHECK(store.Open(path, error));
+    CHECK(store.ValidEnd() == store.Size());
+
+    // Decode the whole store.
+
+    size_t wrong = 0;
+    start = chrono::steady_clock::now();
+    const auto samples = Query(store, INT64_MIN, INT64_MAX, wrong);
+    const auto decodeSeconds = Seconds(start);
+
+    CHECK(samples == volumeCount * runCount);
+    CHECK(wrong == 0);
+    CHECK(store.Volumes().size() == volumeCount);
+
+    // Query one-hour spans (of 61 runs, both ends included) across the store.
+
+    size_t badSpans = 0;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0;  i < queryCount;  ++i) {
+        const auto first = (i * 7919) % (runCount - 60);
+        if (Query(store, RunTime(first), RunTime(first + 60), wrong) != 61 * volumeCount)
+            ++badSpans;
+    }
+    const auto querySeconds = Seconds(start);
+
+    CHECK(badSpans == 0);
+    CHECK(wrong == 0);
+
+    // A span that starts at an index record's time includes that run, whose state the index holds.
+
+    const auto indexTimes = IndexTimes(path, store.LastIndex());
+    CHECK(indexTimes.size() > 10);
+
+    size_t badIndexSpans = 0;
+    for (const auto time : indexTimes) {
+        if (Query(store, time, time, wrong) != volumeCount || Query(store, time, time + runInterval, wrong)
+            != 2 * volumeCount) {
+            if (++badIndexSpans <= 5)
+                fprintf(stderr, "Span from index record at %lld: samples missing\n", static_cast<long long>(time));
+        }
+    }
+
+    CHECK(badIndexSpans == 0);
+    CHECK(wrong == 0);
+
+    printf("%zu samples in %llu bytes (%.1f bytes each)\n", samples,
+           static_cast<unsigned long long>(store.Size()), static_cast<double>(store.Size()) / samples);
+    printf("Appended %zu runs in %.3f s (%.0f runs/s)\n", runCount, appendSeconds, runCount / appendSeconds);
+    printf("Decoded all samples in %.3f s (%.0f samples/s)\n", decodeSeconds, samples / decodeSeconds);
+    printf("Queried %zu one-hour spans in %.3f s (%.3f ms each), %zu from index records\n",
+           queryCount, querySeconds, querySeconds * 1000 / queryCount, indexTimes.size());
+}
+
+int AppendRuns (const NativePath& path, int appender) {
+    // Append this process's runs, interleaved in time with the other appenders'. Returns the exit
+    // code of the process.
+
+    for (size_t i = 0;  i < appenderRuns;  ++i) {
+        const auto run = i * appenderCount + static_cast<size_t>(appender);
+        wstring error;
+        if (!HistoryStore().Append(path, RunDrives(run, appenderVolumes), RunTime(run), error)) {
+            fprintf(stderr, "Appender %d, run %zu: %ls\n", appender, run, error.c_str());
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void TestConcurrentAppends (const NativePath& path) {
+    fflush(stdout);
+
+    vector<pid_t> children;
+    for (int appender = 0;  appender < appenderCount;  ++appender) {
+        const pid_t child = fork();
+        if (child == 0)
+            _exit(AppendRuns(path, appender));
+        children.push_back(child);
+    }
+
+    for (const auto child : children) {
+        int status;
+        CHECK(child == waitpid(child, &status, 0));
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    // Each run must be in the store once, with its values, and each volume numbered once.
+
+    HistoryStore store;
+    wstring      error;
+    CHECK(store.Open(path, error));
+    CHECK(store.ValidEnd() == store.Size());
+
+    set<int64_t> times;
+    size_t samples = 0, wrong = 0;
+
+    store.Decode(historyHeaderSize, INT64_MAX, [&](size_t volume, int64_t time, int64_t, int64_t free) {
+        const auto run = static_cast<size_t>((time - startTime) / runInterval);
+        ++samples;
+        times.insert(time);
+        if (free != FreeBytes(volume, run))
+            ++wrong;
+    });
+
+    CHECK(store.Volumes().size() == appenderVolumes);
+    CHECK(times.size() == appenderCount * appenderRuns);
+    CHECK(samples == appenderCount * appenderRuns * appenderVolumes);
+    CHECK(wrong == 0);
+
+    printf("%d processes appended %zu runs at once: %zu runs in the store\n",
+           appenderCount, appenderCount * appenderRuns, times.size());
+}
+
+int main () {
+    char directory[] = "/tmp/drives-test-XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const auto storePath      = string(directory) + "/store";
+    const auto concurrentPath = string(directory) + "/concurrent";
+
+    TestMillionSamples(storePath);
+    TestConcurrentAppends(concurrentPath);
+
+    unlink(storePath.c_str());
+    unlink(concurrentPath.c_str());
+    rmdir(directory);
+
+    return TestResult();
+}
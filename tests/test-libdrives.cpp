@@ -0,0 +1,137 @@
+//==================================================================================================
+//
+//  test-libdrives
+//
+//  Smoke test of the libdrives API against the volumes of the machine it runs on: enumeration,
+//  single-volume queries, mount points, and argument checking.
+//
+//==================================================================================================
+
+#include "drives.h"
+#include "check.h"
+
+#include <string.h>
+#include <wchar.h>
+
+#include <vector>
+
+using namespace std;
+
+
+void TestEnumerate (vector<DrivesVolume>& volumes) {
+    // Enumerate into a too-small array, and then into one of the reported size.
+
+    size_t count = 0;
+    auto status = drives_enumerate(DRIVES_FIELD_ALL, nullptr, 0, &count);
+    CHECK(status == DRIVES_OK || status == DRIVES_ERROR_INSUFFICIENT_BUFFER);
+    CHECK(status == DRIVES_OK || count > 0);
+
+    volumes.resize(count);
+    status = drives_enumerate(DRIVES_FIELD_ALL, volumes.data(), volumes.size(), &count);
+    CHECK(status == DRIVES_OK);
+    CHECK(count <= volumes.size());
+    volumes.resize(count);
+
+    for (const auto& volume : volumes) {
+        CHECK(volume.fields == DRIVES_FIELD_ALL);
+        CHECK(volume.root[0] != 0);
+        CHECK(volume.volumeInfoValid);
+        CHECK(volume.bytesTotal >= volume.bytesFree);
+#if !defined(_WIN32)
+        CHECK(volume.clustersTotal > 0);  // File systems with no storage are skipped
+#endif
+    }
+
+    // A mount hides earlier mounts at the same mount point, so each root is reported once.
+
+    for (size_t i = 0;  i < volumes.size();  ++i) {
+        for (auto later = i + 1;  later < volumes.size();  ++later)
+            CHECK(0 != wcscmp(volumes[i].root, volumes[later].root));
+    }
+}
+
+void TestQuery (const vector<DrivesVolume>& volumes) {
+    // Each enumerated volume can be queried by its root, and only the selected fields are filled in.
+
+    for (const auto& volume : volumes) {
+        DrivesVolume result;
+        CHECK(DRIVES_OK == drives_query(volume.root, DRIVES_FIELD_TYPE, &result));
+        CHECK(0 == wcscmp(result.root, volume.root));
+        CHECK(result.fields == DRIVES_FIELD_TYPE);
+        CHECK(result.type == volume.type);
+        CHECK(result.clustersTotal == 0);
+        CHECK(!result.volumeInfoValid);
+
+        if (volume.volumeId[0]) {
+            CHECK(DRIVES_OK == drives_query(volume.volumeId, DRIVES_FIELD_ALL, &result));
+            CHECK(0 == wcscmp(result.volumeId, volume.volumeId));
+        }
+    }
+
+    DrivesVolume result;
+    CHECK(DRIVES_ERROR_INVALID_ARGUMENT == drives_query(nullptr, DRIVES_FIELD_ALL, &result));
+    CHECK(DRIVES_ERROR_INVALID_ARGUMENT == drives_query(L"", DRIVES_FIELD_ALL, &result));
+    CHECK(DRIVES_ERROR_INVALID_ARGUMENT == drives_query(L"/", DRIVES_FIELD_ALL, nullptr));
+    CHECK(DRIVES_ERROR_NOT_FOUND == drives_query(L"00000000-no-such-volume", DRIVES_FIELD_ALL, &result));
+}
+
+void TestMountPoints (const vector<DrivesVolume>& volumes) {
+    // Every enumerated volume is the last mount at its mount point, and probing a mount point gives
+    // the same volume as querying it.
+
+    size_t count = 0;
+    vector<DrivesMountPoint> mounts;
+    DrivesStatus status;
+
+    while (DRIVES_ERROR_INSUFFICIENT_BUFFER == (status = drives_mount_points(mounts.data(), mounts.size(), &count)))
+        mounts.resize(count);
+
+    CHECK(status == DRIVES_OK);
+    mounts.resize(count);
+
+    for (const auto& volume : volumes) {
+        const DrivesMountPoint* last = nullptr;
+        for (const auto& mount : mounts) {
+            if (0 == wcscmp(mount.path, volume.root))
+                last = &mount;
+        }
+        CHECK(last && 0 == wcscmp(last->fileSystem, volume.fileSystem));
+    }
+
+    for (size_t i = 0;  i < mounts.size();  ++i) {
+        // Skip mounts that a later mount hides.
+
+        bool hidden = false;
+        for (auto later = i + 1;  later < mounts.size();  ++later)
+            hidden = hidden || 0 == wcscmp(mounts[i].path, mounts[later].path);
+
+        DrivesVolume probed, queried;
+        if (hidden || DRIVES_OK != drives_query(mounts[i].volume, DRIVES_FIELD_ALL, &queried))
+            continue;
+
+        CHECK(DRIVES_OK == drives_mount_point_query(0, &mounts[i], DRIVES_FIELD_ALL, &probed));
+        CHECK(0 == wcscmp(probed.root, queried.root));
+        CHECK(0 == wcscmp(probed.fileSystem, queried.fileSystem));
+        CHECK(0 == wcscmp(probed.volumeId, queried.volumeId));
+        CHECK(probed.type == queried.type);
+        CHECK(probed.clustersTotal == queried.clustersTotal);
+    }
+
+    DrivesVolume result;
+    CHECK(DRIVES_ERROR_INVALID_ARGUMENT == drives_mount_points(nullptr, 1, &count));
+    CHECK(DRIVES_ERROR_INVALID_ARGUMENT == drives_mount_point_query(0, nullptr, DRIVES_FIELD_ALL, &result));
+}
+
+int main () {
+    CHECK(drives_version() != nullptr);
+    CHECK(0 == wcscmp(drives_type_name(DRIVES_TYPE_FIXED), L"Fixed"));
+    CHECK(0 == wcscmp(drives_type_name(static_cast<DrivesType>(99)), L"Unknown"));
+
+    vector<DrivesVolume> volumes;
+    TestEnumerate(volumes);
+    TestQuery(volumes);
+    TestMountPoints(volumes);
+
+    printf("%zu volumes checked\n", volumes.size());
+    return TestResult();
+}
@@ -0,0 +1,137 @@
+//==================================================================================================
+//
+//  test-namespaces
+//
+//  Tests --all-namespaces against a private mount namespace made with unshare(2). A child process
+//  mounts two file systems, one over the other, in a namespace of its own, binds the top one to a
+//  second mount point, and mounts a third file system at a path too long for the mount point table.
+//  Only the top mount of the pair must be reported, as seen in the child's namespace alone at both
+//  of its mount points, and the long mount point must be left out. Needs root, and is skipped
+//  without it.
+//
+//==================================================================================================
+
+#include "../drives-namespaces.h"
+#include "check.h"
+
+#include <sched.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+
+const char hiddenSize[] = "size=3m";
+const char topSize[]    = "size=5m";
+const int  hiddenBytes  = 3 << 20;
+const int  topBytes     = 5 << 20;
+
+
+int RunChild (
+    const string& directory, const string& bindDirectory, const string& longDirectory, int ready, int done
+) {
+    // In a new mount namespace, mount over the directory twice, bind the top mount to the second
+    // directory, and mount over the long directory. Then report ready, and wait until told to exit.
+
+    char status = 1;
+
+    if (0 == unshare(CLONE_NEWNS) && 0 == mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr)
+        && 0 == mount("drives-hidden", directory.c_str(), "tmpfs", 0, hiddenSize)
+        && 0 == mount("drives-top", directory.c_str(), "tmpfs", 0, topSize)
+        && 0 == mount(directory.c_str(), bindDirectory.c_str(), nullptr, MS_BIND, nullptr)
+        && 0 == mount("drives-long", longDirectory.c_str(), "tmpfs", 0, topSize)) {
+        status = 0;
+    }
+
+    if (1 != write(ready, &status, 1) || status)
+        return 1;
+
+    while (0 < read(done, &status, 1)) {}
+    return 0;
+}
+
+int main () {
+    if (geteuid() != 0) {
+        printf("Skipped: needs root\n");
+        return testSkipped;
+    }
+
+    char base[] = "/tmp/drives-test-XXXXXX";
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const string directory     = string(base) + "/private";
+    const string bindDirectory = string(base) + "/bound";
+    string longDirectory   = base;
+    for (const char c : { 'a', 'b', 'c' })
+        longDirectory += "/" + string(100, c);
+
+    const auto command = "mkdir -p '" + directory + "' '" + bindDirectory + "' '" + longDirectory + "'";
+    CHECK(0 == system(command.c_str()));
+
+    int ready[2], done[2];
+    CHECK(0 == pipe(ready) && 0 == pipe(done));
+
+    const pid_t child = fork();
+    if (child == 0) {
+        close(ready[0]);
+        close(done[1]);
+        _exit(RunChild(directory, bindDirectory, longDirectory, ready[1], done[0]));
+    }
+
+    close(ready[1]);
+    close(done[0]);
+
+    char status = 1;
+    if (1 != read(ready[0], &status, 1) || status) {
+        waitpid(child, nullptr, 0);
+        const auto cleanup = string("rm -rf ") + base;
+        CHECK(0 == system(cleanup.c_str()));
+        printf("Skipped: unable to mount in a new namespace\n");
+        return testSkipped;
+    }
+
+    // Report all namespaces while the child's mounts exist.
+
+    CommandOptions options;
+    options.format = OutputFormat::JSON;
+
+    wstringstream out;
+    const auto saved = wcout.rdbuf(out.rdbuf());
+    const auto result = RunAllNamespaces(options);
+    wcout.rdbuf(saved);
+
+    close(done[1]);
+    waitpid(child, nullptr, 0);
+
+    const auto cleanup = string("rm -rf ") + base;
+    CHECK(0 == system(cleanup.c_str()));
+
+    CHECK(result == 0);
+
+    // The directory is seen in one namespace only, the child's, at both its mount points, with only
+    // the top mount's capacity.
+
+    const auto output = out.str();
+    const auto view   = output.find(L"\"mountPoints\": [\"" + FromUTF8(directory) + L"\", \""
+                                    + FromUTF8(bindDirectory) + L"\"], \"pids\": [" + to_wstring(child) + L"]");
+    CHECK(view != wstring::npos);
+
+    if (view != wstring::npos) {
+        const auto start = output.rfind(L"\n  {\n", view);
+        const auto end   = output.find(L"\n  }", view);
+        const auto entry = output.substr(start, end - start);
+
+        CHECK(entry.find(L"\"capacityBytes\": " + to_wstring(topBytes) + L",") != wstring::npos);
+        CHECK(entry.find(L"{ \"id\": ") == entry.rfind(L"{ \"id\": "));   // A single namespace
+    }
+
+    // The hidden mount is not reported, nor is the long mount point, which is too long to list.
+
+    CHECK(output.find(L"\"capacityBytes\": " + to_wstring(hiddenBytes) + L",") == wstring::npos);
+    CHECK(output.find(L"/" + wstring(100, L'a') + L"/") == wstring::npos);
+
+    if (TestFailures())
+        fprintf(stderr, "Output:\n%ls\n", output.c_str());
+
+    return TestResult();
+}
@@ -0,0 +1,95 @@
+//==================================================================================================
+//
+//  test-options
+//
+//  Parses command lines, and checks the mode chosen by the mode options, and that each option is
+//  accepted only with the modes that use it: a second mode option, an option that applies only to
+//  other modes (as --agent-delay without --agent), a volume or the prometheus format where the mode
+//  doesn't support it must all be rejected. The rejected command lines print their errors.
+//
+//==================================================================================================
+
+#include "../drives-options.h"
+#include "check.h"
+
+#include <initializer_list>
+
+
+bool Parse (initializer_list<const wchar_t*> arguments, CommandOptions& options) {
+    // Parse the arguments, after the program name, into the options. Returns false on error.
+
+    vector<wstring> tokens {L"drives"};
+    tokens.insert(tokens.end(), arguments.begin(), arguments.end());
+
+    vector<wchar_t*> tokenPointers;
+    for (auto& token : tokens)
+        tokenPointers.push_back(&token[0]);
+    tokenPointers.push_back(nullptr);
+
+    return options.parseArguments(static_cast<int>(tokens.size()), tokenPointers.data());
+}
+
+bool Accepts (initializer_list<const wchar_t*> arguments, Mode mode) {
+    // Returns true if the arguments are accepted, and select the given mode.
+    CommandOptions options;
+    return Parse(arguments, options) && options.mode == mode;
+}
+
+bool Rejects (initializer_list<const wchar_t*> arguments) {
+    CommandOptions options;
+    return !Parse(arguments, options);
+}
+
+int main () {
+    // Modes, alone and with the options they allow.
+
+    CHECK(Accepts({}, Mode::Report));
+    CHECK(Accepts({L"--json", L"/"}, Mode::Report));
+    CHECK(Accepts({L"--record", L"store"}, Mode::Report));
+    CHECK(Accepts({L"--refresh-loop", L"--interval", L"5"}, Mode::RefreshLoop));
+    CHECK(Accepts({L"--textfile", L"out.prom", L"--refresh-loop", L"--interval=5"}, Mode::Textfile));
+    CHECK(Accepts({L"--hosts", L"a,b", L"--timeout", L"100", L"/"}, Mode::Hosts));
+    CHECK(Accepts({L"--agent", L"7000", L"--agent-delay", L"10", L"--refresh-loop"}, Mode::Agent));
+    CHECK(Accepts({L"--which", L"/a", L"/b"}, Mode::Which));
+    CHECK(Accepts({L"--check", L"rules", L"--record", L"store", L"/"}, Mode::Check));
+    CHECK(Accepts({L"--history", L"store", L"--from", L"7d", L"--to", L"1d", L"--json"}, Mode::History));
+    CHECK(Accepts({L"--frag", L"/", L"--top", L"3"}, Mode::Frag));
+#if !defined(_WIN32)
+    CHECK(Accepts({L"--all-namespaces", L"--verbose"}, Mode::AllNamespaces));
+    CHECK(Accepts({L"--cached", L"/", L"--depth", L"2"}, Mode::Cached));
+#endif
+
+    CommandOptions which;
+    CHECK(Parse({L"--which", L"/a", L"/b"}, which) && which.whichPaths.size() == 2 && which.singleVolume.empty());
+
+    // Only one mode option.
+
+    CHECK(Rejects({L"--hosts", L"a", L"--agent", L"7000"}));
+    CHECK(Rejects({L"--which", L"--frag", L"/"}));
+    CHECK(Rejects({L"--check", L"rules", L"--history", L"store"}));
+    CHECK(Rejects({L"--textfile", L"out.prom", L"--cached", L"/"}));
+
+    // Options of other modes, or of none.
+
+    CHECK(Rejects({L"--agent-delay", L"10"}));
+    CHECK(Rejects({L"--timeout", L"100"}));
+    CHECK(Rejects({L"--hosts", L"a", L"--agent-delay", L"10"}));
+    CHECK(Rejects({L"--agent", L"7000", L"--timeout", L"100"}));
+    CHECK(Rejects({L"--agent", L"7000", L"--interval", L"5"}));
+    CHECK(Rejects({L"--hosts", L"a", L"--refresh-loop"}));
+    CHECK(Rejects({L"--history", L"store", L"--record", L"store"}));
+    CHECK(Rejects({L"--frag", L"/", L"--depth", L"2"}));
+    CHECK(Rejects({L"--top", L"3"}));
+    CHECK(Rejects({L"--from", L"7d"}));
+    CHECK(Rejects({L"--interval", L"5"}));
+
+    // Volumes and formats.
+
+    CHECK(Rejects({L"--agent", L"7000", L"/"}));
+    CHECK(Rejects({L"--frag", L"/", L"/"}));
+    CHECK(Rejects({L"/", L"/home"}));
+    CHECK(Rejects({L"--which", L"--format", L"prometheus"}));
+    CHECK(Rejects({L"--check", L"rules", L"--format=prometheus"}));
+
+    return TestResult();
+}
@@ -0,0 +1,164 @@
+//==================================================================================================
+//
+//  test-prometheus
+//
+//  Renders a fixed set of drives in Prometheus text exposition format, and compares the result with
+//  the expected output checked in as golden/prometheus.prom. Label values include double quotes,
+//  backslashes, newlines and non-ASCII text, which must be escaped or encoded as the format requires.
+//  The textfile collector's output must add drives_up, which is 0 when the volume list can't be read.
+//
+//  Usage: test-prometheus <golden file> [--update]
+//
+//  With --update, the golden file is rewritten with the current output instead.
+//
+//==================================================================================================
+
+#include "../drives-info.h"
+#include "../drives-textfile.h"
+#include "check.h"
+
+#include <cstring>
+#include <fstream>
+
+DrivesVolume Volume (
+    wchar_t driveLetter, const wchar_t* root, DrivesType type, const wchar_t* fileSystem, const wchar_t* label
+) {
+    // Returns a volume with the given identity, and with no other fields set.
+
+    DrivesVolume volume;
+    memset(&volume, 0, sizeof volume);
+
+    volume.fields          = DRIVES_FIELD_ALL;
+    volume.driveLetter     = driveLetter;
+    volume.type            = type;
+    volume.volumeInfoValid = 1;
+    wcscpy(volume.root, root);
+    wcscpy(volume.fileSystem, fileSystem);
+    wcscpy(volume.label, label);
+
+    return volume;
+}
+
+void SetCapacity (DrivesVolume& volume, uint64_t clustersTotal, uint64_t clustersFree) {
+    volume.sectorsPerCluster = 8;
+    volume.bytesPerSector    = 512;
+    volume.clustersTotal     = clustersTotal;
+    volume.clustersFree      = clustersFree;
+    volume.bytesTotal        = static_cast<int64_t>(clustersTotal * 4096);
+    volume.bytesFree         = static_cast<int64_t>(clustersFree * 4096);
+}
+
+vector<DriveInfo> TestDrives () {
+    vector<DriveInfo> drives;
+
+    // A Windows system drive, whose volume ID is full of backslashes.
+
+    auto volume = Volume(L'C', L"C:\\", DRIVES_TYPE_FIXED, L"NTFS", L"Windows");
+    wcscpy(volume.volumeId, L"\\\\?\\Volume{3f1c2a4e-0000-4000-8000-00aa00bb00cc}\\");
+    volume.serialNumber    = 0x1234abcd;
+    volume.fileSystemFlags = DRIVES_FS_CASE_SENSITIVE_SEARCH | DRIVES_FS_CASE_PRESERVED_NAMES
+                           | DRIVES_FS_UNICODE_ON_DISK | DRIVES_FS_PERSISTENT_ACLS | DRIVES_FS_NAMED_STREAMS;
+    SetCapacity(volume, 62500000, 15625000);
+    drives.emplace_back(volume);
+
+    // A bind mount whose mount point, source directory and label need escaping.
+
+    volume = Volume(0, L"/mnt/odd \"dir\"", DRIVES_TYPE_FIXED, L"ext4", L"back\\slash\nnew line");
+    wcscpy(volume.volumeId, L"0b5e5d4c-3f21-4a7e-9c11-6f2d8e3a9b70");
+    wcscpy(volume.substituteFor, L"/srv/a\\b \"c\"");
+    volume.serialNumber    = 0xfeed0042;
+    volume.fileSystemFlags = DRIVES_FS_CASE_SENSITIVE_SEARCH | DRIVES_FS_CASE_PRESERVED_NAMES
+                           | DRIVES_FS_SUPPORTS_HARD_LINKS;
+    SetCapacity(volume, 1000, 333);
+    drives.emplace_back(volume);
+
+    // A network file system with a non-ASCII label.
+
+    volume = Volume(0, L"/net/donn\u00e9es", DRIVES_TYPE_REMOTE, L"nfs4", L"Donn\u00e9es \u2192 archive");
+    wcscpy(volume.networkMapping, L"server:/export/donn\u00e9es");
+    volume.serialNumber = 0x00010002;
+    SetCapacity(volume, 2000000, 0);
+    drives.emplace_back(volume);
+
+    // A volume with neither capacity nor volume information, which has only an info sample.
+
+    volume = Volume(L'Z', L"Z:\\", DRIVES_TYPE_NO_ROOT, L"", L"");
+    volume.volumeInfoValid = 0;
+    drives.emplace_back(volume);
+
+    return drives;
+}
+
+int main (int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: test-prometheus <golden file> [--update]\n");
+        return 1;
+    }
+
+    const auto drives = TestDrives();
+
+    // The local drives, and then the first two as reported by remote hosts, one of whose names needs
+    // escaping.
+
+    const wstring plainHost   = L"db-01:7250";
+    const wstring strangeHost = L"host \"quoted\"\\path\nline";
+
+    vector<DriveRow> rows;
+    for (const auto& drive : drives)
+        rows.emplace_back(nullptr, &drive);
+    rows.emplace_back(&plainHost, &drives[0]);
+    rows.emplace_back(&strangeHost, &drives[1]);
+
+    MetricsBuffer metrics {4096};
+    RenderPrometheus(metrics, rows);
+    const auto& actual = metrics.Text();
+
+    if (argc > 2 && 0 == strcmp(argv[2], "--update")) {
+        ofstream golden {argv[1], ios::binary};
+        golden << actual;
+        return golden ? 0 : 1;
+    }
+
+    ifstream golden {argv[1], ios::binary};
+    if (!golden) {
+        fprintf(stderr, "Unable to read %s\n", argv[1]);
+        return 1;
+    }
+
+    stringstream expected;
+    expected << golden.rdbuf();
+
+    CHECK(actual == expected.str());
+
+    if (actual != expected.str()) {
+        // Report the first line that differs.
+
+        const auto& wanted = expected.str();
+        size_t line = 1, start = 0, i = 0;
+        for (;  i < actual.length() && i < wanted.length() && actual[i] == wanted[i];  ++i) {
+            if (actual[i] == '\n') {
+                ++line;
+                start = i + 1;
+            }
+        }
+
+        auto lineAt = [start](const string& text) { return text.substr(start, text.find('\n', start) - start); };
+        fprintf(stderr, "Line %zu differs.\nExpected: %s\nActual:   %s\n",
+                line, lineAt(wanted).c_str(), lineAt(actual).c_str());
+    }
+
+    // The textfile collector's output is the same, followed by drives_up.
+
+    const string up = "# TYPE drives_up gauge\ndrives_up 1\n";
+    MetricsBuffer textfile {4096};
+
+    RenderTextfile(textfile, DRIVES_OK, rows);
+    CHECK(textfile.Text().compare(0, actual.length(), actual) == 0);
+    CHECK(textfile.Text().compare(textfile.Text().length() - up.length(), up.length(), up) == 0);
+
+    RenderTextfile(textfile, DRIVES_ERROR_SYSTEM, {});
+    CHECK(textfile.Text().find("\ndrives_up 0\n") != string::npos);
+    CHECK(textfile.Text().find("drives_volume_info{") == string::npos);
+
+    return TestResult();
+}
@@ -0,0 +1,237 @@
+//==================================================================================================
+//
+//  test-refresh
+//
+//  Runs the background refresh cache against simulated volumes with scripted probe latencies: one
+//  whose free space changes on every probe, one that never changes, and one whose probes the test
+//  holds until it releases them. Snapshots must never wait on a probe, changing volumes must be
+//  probed more often than stable or slow ones, and destroying the cache must stop all its threads.
+//  Waiting for the first probes must return once every volume has been probed, and snapshots must
+//  report a volume list that can't be read.
+//
+//  The checks hold however slowly the machine runs the test: they compare probe counts with each
+//  other, rather than with counts expected at given times.
+//
+//==================================================================================================
+
+#include "../drives-refresh.h"
+#include "check.h"
+
+#include <atomic>
+#include <functional>
+
+struct FakeVolume {
+    const wchar_t* root;
+    int            latencyMs;   // Time each probe takes, at least
+    bool           changing;    // True if the free space changes on every probe
+    atomic<int>    probes;      // Number of probes started
+    atomic<int>    finished;    // Number of probes finished
+    atomic<bool>   held;        // While true, probes wait to finish
+};
+
+FakeVolume fakeVolumes[] = {
+    { L"/fake/changing", 1,   true,  {0}, {0}, {false} },
+    { L"/fake/stable",   1,   false, {0}, {0}, {false} },
+    { L"/fake/slow",     400, false, {0}, {0}, {false} },
+};
+
+enum { changingVolume, stableVolume, slowVolume };
+
+void ResetFakes () {
+    for (auto& fake : fakeVolumes) {
+        fake.probes   = 0;
+        fake.finished = 0;
+        fake.held     = false;
+    }
+}
+
+
+DrivesStatus FakeProbe (const wchar_t* root, uint32_t fields, DrivesVolume* result) {
+    for (auto& fake : fakeVolumes) {
+        if (0 != wcscmp(root, fake.root))
+            continue;
+
+        const int probe = ++fake.probes;
+        this_thread::sleep_for(chrono::milliseconds(fake.latencyMs));
+        while (fake.held)
+            this_thread::sleep_for(chrono::milliseconds(1));
+
+        memset(result, 0, sizeof *result);
+        wcscpy(result->root, fake.root);
+        wcscpy(result->fileSystem, L"fakefs");
+        result->fields          = fields;
+        result->type            = DRIVES_TYPE_FIXED;
+        result->volumeInfoValid = 1;
+        result->bytesTotal      = 1 << 30;
+        result->bytesFree       = fake.changing ? probe * 4096 : 1 << 29;
+        ++fake.finished;
+        return DRIVES_OK;
+    }
+
+    return DRIVES_ERROR_NOT_FOUND;
+}
+
+DrivesStatus FakeEnumerate (uint32_t, DrivesVolume* volumes, size_t capacity, size_t* count) {
+    *count = sizeof fakeVolumes / sizeof fakeVolumes[0];
+    if (capacity < *count)
+        return DRIVES_ERROR_INSUFFICIENT_BUFFER;
+
+    for (size_t i = 0;  i < *count;  ++i) {
+        memset(&volumes[i], 0, sizeof volumes[i]);
+        wcscpy(volumes[i].root, fakeVolumes[i].root);
+    }
+
+    return DRIVES_OK;
+}
+
+DrivesStatus FailingEnumerate (uint32_t, DrivesVolume*, size_t, size_t*) {
+    return DRIVES_ERROR_SYSTEM;
+}
+
+bool Contains (const vector<DriveInfo>& drives, int volume) {
+    for (const auto& drive : drives) {
+        if (drive.Matches(fakeVolumes[volume].root))
+            return true;
+    }
+    return false;
+}
+
+bool WaitFor (const function<bool()>& condition) {
+    // Wait for the condition to hold, for up to a minute. Returns true if it holds.
+
+    for (int i = 0;  i < 60'000;  ++i) {
+        if (condition())
+            return true;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return condition();
+}
+
+void TestSchedule () {
+    // Let the cache run for 3.5 seconds, taking snapshots along the way.
+
+    ResetFakes();
+    fakeVolumes[slowVolume].held = true;
+
+    vector<DriveInfo> drives;
+    auto cache = make_unique<VolumeCache>(L"", FakeProbe, FakeEnumerate);
+
+    const auto start = Clock::now();
+    cache->Start();
+
+    // While the slow volume's probe is held, the fast ones become available: snapshots don't wait
+    // for it.
+
+    CHECK(WaitFor([&] {
+        cache->Snapshot(drives);
+        return Contains(drives, changingVolume) && Contains(drives, stableVolume);
+    }));
+    CHECK(fakeVolumes[slowVolume].probes == 1);
+    CHECK(!Contains(drives, slowVolume));
+
+    this_thread::sleep_until(start + chrono::milliseconds(400));
+    fakeVolumes[slowVolume].held = false;
+
+    this_thread::sleep_until(start + chrono::milliseconds(3500));
+    cache->Snapshot(drives);
+    CHECK(drives.size() == 3);
+
+    // Groups are probed at once, and again after one second. From then on, the changing group stays
+    // at the shortest interval, and the stable one backs off. The slow volume waits at least 20 times
+    // its latency (8 s), so is not probed again.
+
+    const int changing = fakeVolumes[changingVolume].probes;
+    const int stable   = fakeVolumes[stableVolume].probes;
+    const int slow     = fakeVolumes[slowVolume].probes;
+
+    printf("Probes in 3.5 s: changing %d, stable %d, slow %d\n", changing, stable, slow);
+    CHECK(changing > stable);
+    CHECK(stable >= slow);
+    CHECK(slow == 1);
+
+    // Destroying the cache stops its threads, and no probes follow.
+
+    cache.reset();
+    for (auto& fake : fakeVolumes)
+        CHECK(fake.finished == fake.probes);
+
+    this_thread::sleep_for(chrono::milliseconds(1500));
+    CHECK(fakeVolumes[changingVolume].probes == changing);
+    CHECK(fakeVolumes[stableVolume].probes == stable);
+    CHECK(fakeVolumes[slowVolume].probes == slow);
+}
+
+void TestStopDuringProbe () {
+    // Destroy a cache while the slow volume's probe is held. This waits for that probe to finish,
+    // but starts no more.
+
+    ResetFakes();
+    fakeVolumes[slowVolume].held = true;
+
+    auto cache = make_unique<VolumeCache>(L"", FakeProbe, FakeEnumerate);
+    cache->Start();
+    CHECK(WaitFor([] { return fakeVolumes[slowVolume].probes == 1; }));
+
+    thread releaser {[] {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        fakeVolumes[slowVolume].held = false;
+    }};
+
+    cache.reset();
+    CHECK(fakeVolumes[slowVolume].finished == 1);
+    releaser.join();
+
+    CHECK(fakeVolumes[slowVolume].probes == 1);
+}
+
+void TestSingleVolume () {
+    // A cache of a single volume probes only that volume, through the replaceable prober.
+
+    ResetFakes();
+
+    vector<DriveInfo> drives;
+    VolumeCache cache {fakeVolumes[stableVolume].root, FakeProbe, FakeEnumerate};
+    cache.Start();
+    CHECK(cache.WaitForFirstProbes(chrono::seconds(10)));
+
+    cache.Snapshot(drives);
+    CHECK(drives.size() == 1 && Contains(drives, stableVolume));
+    CHECK(fakeVolumes[changingVolume].probes == 0);
+    CHECK(fakeVolumes[slowVolume].probes == 0);
+}
+
+void TestFirstProbes () {
+    // Waiting for the first probes returns once every volume, the slow one included, has been
+    // probed, so the first snapshot is complete. A cache whose volume list can't be read, or whose
+    // single volume is not present, reports that from its snapshots.
+
+    ResetFakes();
+
+    vector<DriveInfo> drives;
+
+    VolumeCache cache {L"", FakeProbe, FakeEnumerate};
+    cache.Start();
+    CHECK(cache.WaitForFirstProbes(chrono::seconds(10)));
+    CHECK(DRIVES_OK == cache.Snapshot(drives));
+    CHECK(drives.size() == 3);
+
+    VolumeCache failing {L"", FakeProbe, FailingEnumerate};
+    failing.Start();
+    CHECK(failing.WaitForFirstProbes(chrono::seconds(10)));
+    CHECK(DRIVES_ERROR_SYSTEM == failing.Snapshot(drives));
+    CHECK(drives.empty());
+
+    VolumeCache missing {L"/fake/missing", FakeProbe, FakeEnumerate};
+    missing.Start();
+    CHECK(missing.WaitForFirstProbes(chrono::seconds(10)));
+    CHECK(DRIVES_ERROR_NOT_FOUND == missing.Snapshot(drives));
+    CHECK(drives.empty());
+}
+
+int main () {
+    TestSchedule();
+    TestStopDuringProbe();
+    TestSingleVolume();
+    TestFirstProbes();
+    return TestResult();
+}
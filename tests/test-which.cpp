@@ -0,0 +1,244 @@
+//==================================================================================================
+//
+//  test-which
+//
+//  Tests the resolution of paths to volumes, as by --which:
+//
+//    - Resolves a million paths under the machine's mount points, checking each against a direct
+//      search of the mount table, and reports the rate.
+//    - Mounts a file system at a path too long for the mount point table, in a private mount
+//      namespace, and checks that paths below it are left unresolved. Mounts two file systems at
+//      one mount point, and checks that paths there resolve to the later one, and that the hidden
+//      one is not probed. This part needs root, and is skipped without it.
+//    - Checks the JSON output of paths that need escaping.
+//
+//==================================================================================================
+
+#include "../drives-which.h"
+#include "check.h"
+
+#if !defined(_WIN32)
+#include <sched.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#endif
+
+const size_t pathCount = 1'000'000;
+
+
+vector<DrivesMountPoint> MountPoints () {
+    vector<DrivesMountPoint> mounts;
+    size_t count = 0;
+
+    while (DRIVES_ERROR_INSUFFICIENT_BUFFER == drives_mount_points(mounts.data(), mounts.size(), &count))
+        mounts.resize(count);
+
+    mounts.resize(count);
+    return mounts;
+}
+
+bool IsBelow (const wstring& path, const wchar_t* directory) {
+    // Returns true if the absolute, normalized path is the directory or below it.
+
+    const auto length = wcslen(directory);
+    if (0 != ComparePathComponents(wstring_view{path}.substr(0, length), wstring_view{directory, length}))
+        return false;
+
+    return path.length() == length || IsPathSeparator(path[length]) || IsPathSeparator(directory[length - 1]);
+}
+
+void TestMillionPaths () {
+    // Generate paths at and below each mount point, some with "." and ".." components, and check
+    // each resolves to the deepest (and, of equal ones, the last) mount point that holds it.
+
+    PathResolver resolver;
+    CHECK(DRIVES_OK == resolver.Build());
+
+    vector<const DrivesMountPoint*> queryable;
+    const auto mounts = MountPoints();
+    for (const auto& mount : mounts) {
+        DrivesVolume volume;
+        if (DRIVES_OK == drives_mount_point_query(0, &mount, 0, &volume))
+            queryable.push_back(&mount);
+    }
+
+    if (queryable.empty()) {
+        printf("No queryable mount points\n");
+        return;
+    }
+
+    vector<wstring> paths;
+    vector<wstring> expected;   // Expected mount point of each path
+    paths.reserve(pathCount);
+    expected.reserve(pathCount);
+
+    for (size_t i = 0;  i < pathCount;  ++i) {
+        const auto& mount = *queryable[i % queryable.size()];
+        wstring base = mount.path;
+        if (!IsPathSeparator(base.back()))
+            base += pathSeparator;
+
+        // Each path is given with its normalized form, which is checked against the mount points.
+
+        const wstring sep {pathSeparator};
+        const wstring child = L"dir" + to_wstring(i % 97) + sep + L"file" + to_wstring(i);
+        wstring path, normalized;
+
+        switch (i % 4) {
+            case 0:  path = base;                                     normalized = mount.path;   break;
+            case 1:  path = base + child;                             normalized = path;         break;
+            case 2:  path = base + L"x" + sep + L".." + sep + child;  normalized = base + child;  break;
+            default: path = base + L"." + sep + child;                normalized = base + child;  break;
+        }
+
+        const DrivesMountPoint* best = nullptr;
+        for (auto candidate : queryable) {
+            if (IsBelow(normalized, candidate->path) && (!best || wcslen(candidate->path) >= wcslen(best->path)))
+                best = candidate;
+        }
+
+        paths.push_back(move(path));
+        expected.push_back(best->path);
+    }
+
+    // Time the resolution alone, and then check the results.
+
+    vector<const DriveInfo*> results(pathCount);
+
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0;  i < pathCount;  ++i)
+        results[i] = resolver.Resolve(paths[i]);
+    const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t mismatches = 0;
+    for (size_t i = 0;  i < pathCount;  ++i) {
+        if (!results[i] || expected[i] != results[i]->RootPath()) {
+            if (++mismatches <= 5) {
+                fprintf(stderr, "%ls: expected %ls, got %ls\n",
+                        paths[i].c_str(), expected[i].c_str(), results[i] ? results[i]->RootPath() : L"none");
+            }
+        }
+    }
+
+    CHECK(mismatches == 0);
+
+    printf("Resolved %zu paths under %zu mount points in %.3f s (%.0f paths/s)\n",
+           pathCount, queryable.size(), elapsed, pathCount / elapsed);
+}
+
+void TestPrivateMounts () {
+#if defined(_WIN32)
+    printf("Long mount point: skipped, Linux only\n");
+#else
+    // Work in a private mount namespace, so that the mount is seen by no other process, and goes
+    // away with this one.
+
+    if (0 != unshare(CLONE_NEWNS) || 0 != mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr)) {
+        printf("Long mount point: skipped, needs root\n");
+        return;
+    }
+
+    char base[] = "/tmp/drives-test-XXXXXX";
+    if (!mkdtemp(base)) {
+        perror("mkdtemp");
+        CHECK(false);
+        return;
+    }
+
+    string directory = base;
+    for (const char c : { 'a', 'b', 'c' }) {
+        directory += "/" + string(100, c);
+        CHECK(0 == mkdir(directory.c_str(), 0700));
+    }
+
+    CHECK(0 == mount("drives-test", directory.c_str(), "tmpfs", 0, "size=1m"));
+
+    // A mount point with a 2 MiB tmpfs mounted over a ramfs. Probing the ramfs's mount table entry
+    // would report the tmpfs's capacity as a ramfs.
+
+    const auto stacked = string(base) + "/stacked";
+    CHECK(0 == mkdir(stacked.c_str(), 0700));
+    CHECK(0 == mount("drives-hidden", stacked.c_str(), "ramfs", 0, nullptr));
+    CHECK(0 == mount("drives-top", stacked.c_str(), "tmpfs", 0, "size=2m"));
+
+    bool listed = false;
+    for (const auto& mount : MountPoints()) {
+        if (mount.truncated && 0 == wcsncmp(mount.path, FromUTF8(base).c_str(), strlen(base))) {
+            DrivesVolume volume;
+            CHECK(DRIVES_ERROR_NOT_FOUND == drives_mount_point_query(0, &mount, DRIVES_FIELD_ALL, &volume));
+            listed = true;
+        }
+    }
+    CHECK(listed);
+
+    // Paths below the long mount point can't be resolved, but those beside it are on the file
+    // system that holds the base directory.
+
+    PathResolver resolver;
+    CHECK(DRIVES_OK == resolver.Build());
+
+    CHECK(nullptr == resolver.Resolve(FromUTF8(directory + "/file")));
+    CHECK(nullptr != resolver.Resolve(FromUTF8(string(base) + "/a-sibling")));
+    CHECK(nullptr != resolver.Resolve(FromUTF8(base)));
+
+    const auto top = resolver.Resolve(FromUTF8(stacked + "/file"));
+    CHECK(top && top->Matches(FromUTF8(stacked)) && top->BytesTotal() == 2 << 20);
+    CHECK(top && 0 == wcscmp(top->CheckText(CheckField::FileSystem), L"tmpfs"));
+
+    for (const auto& drive : resolver.Drives())
+        CHECK(0 != wcscmp(drive.CheckText(CheckField::FileSystem), L"ramfs"));
+
+    umount(stacked.c_str());
+    umount(stacked.c_str());
+    umount(directory.c_str());
+    const auto command = string("rm -rf ") + base;
+    CHECK(0 == system(command.c_str()));
+
+    printf("Long mount point: checked\n");
+#endif
+}
+
+void TestJSONEscapes () {
+    // Escape() must produce valid JSON string contents for any string.
+
+    wstringstream out;
+    out << Escape(L"plain") << L'|' << Escape(L"a\"b\\c") << L'|' << Escape(L"\b\f\n\r\t") << L'|'
+        << Escape(L"\x01\x1f\x7f") << L'|' << Escape(L"café");
+    CHECK(out.str() == L"plain|a\\\"b\\\\c|\\b\\f\\n\\r\\t|\\u0001\\u001f\x7f|café");
+
+    // The path of a --which result, and a volume's file system and ID, are escaped.
+
+    CommandOptions options;
+    options.format     = OutputFormat::JSON;
+    options.whichPaths = { L"/tmp/a\"b", L"no\tvolume" };
+
+    const auto saved = wcout.rdbuf(out.rdbuf());
+    out.str(L"");
+    RunWhich(options);
+    wcout.rdbuf(saved);
+
+    CHECK(out.str().find(L"\"path\": \"/tmp/a\\\"b\"") != wstring::npos);
+    CHECK(out.str().find(L"\"path\": \"no\\tvolume\"") != wstring::npos);
+
+    DrivesVolume volume;
+    memset(&volume, 0, sizeof volume);
+    volume.volumeInfoValid = 1;
+    wcscpy(volume.root, L"/mnt");
+    wcscpy(volume.fileSystem, L"fuse.\"odd\"");
+    wcscpy(volume.volumeId, L"id\\1");
+
+    out.str(L"");
+    wcout.rdbuf(out.rdbuf());
+    DriveInfo(volume).PrintJSONVolumeInformation(true);
+    wcout.rdbuf(saved);
+
+    CHECK(out.str().find(L"\"fileSystem\": \"fuse.\\\"odd\\\"\"") != wstring::npos);
+    CHECK(out.str().find(L"\"volumeName\": \"/dev/disk/by-uuid/id\\\\1\"") != wstring::npos);
+}
+
+int main () {
+    TestJSONEscapes();
+    TestMillionPaths();
+    TestPrivateMounts();
+    return TestResult();
+}